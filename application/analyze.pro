@@ -0,0 +1,17 @@
+QT      += core concurrent
+QT      -= gui
+
+TARGET   = pcboven-analyze
+TEMPLATE = app
+CONFIG  += console
+
+SOURCES += src/analyzemain.cpp \
+           src/runanalytics.cpp \
+           src/runrecording.cpp
+
+HEADERS += src/runanalytics.h \
+           src/runrecording.h
+
+DESTDIR     = build
+OBJECTS_DIR = build/analyze
+MOC_DIR     = build/analyze
@@ -0,0 +1,37 @@
+QT      += core network
+QT      -= gui
+
+TARGET   = pcboven-broker
+TEMPLATE = app
+CONFIG  += console link_pkgconfig
+PKGCONFIG += libusb-1.0
+
+SOURCES += src/brokermain.cpp \
+           src/brokerprotocol.cpp \
+           src/commandqueue.cpp \
+           src/kerneltransport.cpp \
+           src/metricsexporter.cpp \
+           src/mocktransport.cpp \
+           src/ovenbroker.cpp \
+           src/ovenmanager.cpp \
+           src/oventransport.cpp \
+           src/stateestimator.cpp \
+           src/usbtransport.cpp
+
+HEADERS += src/brokerprotocol.h \
+           src/commandqueue.h \
+           src/kerneltransport.h \
+           src/metricsexporter.h \
+           src/mocktransport.h \
+           src/ovenbroker.h \
+           src/ovenmanager.h \
+           src/oventransport.h \
+           src/stateestimator.h \
+           src/temperature.h \
+           src/usbtransport.h
+
+INCLUDEPATH = ../driver/src
+
+DESTDIR     = build
+OBJECTS_DIR = build/broker
+MOC_DIR     = build/broker
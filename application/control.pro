@@ -1,20 +1,61 @@
-QT      += core gui
+QT      += core gui network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 TARGET   = control
 TEMPLATE = app
+CONFIG  += link_pkgconfig c++14
+PKGCONFIG += libusb-1.0
 
 SOURCES += src/main.cpp \
+           src/autotuner.cpp \
+           src/brokerprotocol.cpp \
+           src/builtinprofiles.cpp \
+           src/commandqueue.cpp \
            src/controlpanel.cpp \
+           src/graphrenderer.cpp \
+           src/jobqueue.cpp \
+           src/kerneltransport.cpp \
+           src/metricsexporter.cpp \
+           src/mocktransport.cpp \
+           src/ovencapability.cpp \
            src/ovenmanager.cpp \
+           src/oventransport.cpp \
+           src/profilefeasibility.cpp \
+           src/profilelibrary.cpp \
            src/reflowprofile.cpp \
-           src/reflowgraphwidget.cpp
+           src/reflowgraphwidget.cpp \
+           src/runjournal.cpp \
+           src/runrecording.cpp \
+           src/sampleindex.cpp \
+           src/stateestimator.cpp \
+           src/thermalmodel.cpp \
+           src/usbtransport.cpp
 
-HEADERS += src/controlpanel.h \
+HEADERS += src/autotuner.h \
+           src/brokerprotocol.h \
+           src/builtinprofiles.h \
+           src/commandqueue.h \
+           src/controlpanel.h \
+           src/graphrenderer.h \
+           src/jobqueue.h \
+           src/kerneltransport.h \
+           src/metricsexporter.h \
+           src/mocktransport.h \
+           src/ovencapability.h \
            src/ovenmanager.h \
+           src/oventransport.h \
+           src/profilefeasibility.h \
+           src/profilelibrary.h \
            src/reflowprofile.h \
-           src/reflowgraphwidget.h
+           src/reflowgraphwidget.h \
+           src/runjournal.h \
+           src/runrecording.h \
+           src/sampleindex.h \
+           src/stateestimator.h \
+           src/temperature.h \
+           src/thermalmodel.h \
+           src/usbtransport.h
 
 FORMS   += ui/controlpanel.ui
 
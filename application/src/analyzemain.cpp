@@ -0,0 +1,126 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QtCore/qmath.h>
+#include <math.h>
+#include <stdio.h>
+#include "runanalytics.h"
+
+struct Summary {
+	const char *name;
+	double sum;
+	double sumSquares;
+	float minimum;
+	float maximum;
+};
+
+static void summarize(Summary *summary, float value)
+{
+	summary->sum += value;
+	summary->sumSquares += (double)value * value;
+	summary->minimum = qMin(summary->minimum, value);
+	summary->maximum = qMax(summary->maximum, value);
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+	a.setOrganizationName("PCBoven");
+	a.setApplicationName("control");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Computes reflow quality metrics from recorded runs, as CSV.");
+	parser.addHelpOption();
+	QCommandLineOption liquidusOption("liquidus", "Liquidus temperature of the solder (C).", "temperature", QString::number(RunAnalytics::DEFAULT_LIQUIDUS));
+	QCommandLineOption soakMinimumOption("soak-min", "Lower edge of the soak band (C).", "temperature", QString::number(RunAnalytics::DEFAULT_SOAK_MINIMUM));
+	QCommandLineOption soakMaximumOption("soak-max", "Upper edge of the soak band (C).", "temperature", QString::number(RunAnalytics::DEFAULT_SOAK_MAXIMUM));
+	QCommandLineOption rateWindowOption("rate-window", "Window over which ramp and cool rates are measured (s).", "seconds", QString::number(RunAnalytics::DEFAULT_RATE_WINDOW));
+	QCommandLineOption summaryOption("summary", "Append the mean, standard deviation and range of each metric.");
+	parser.addOption(liquidusOption);
+	parser.addOption(soakMinimumOption);
+	parser.addOption(soakMaximumOption);
+	parser.addOption(rateWindowOption);
+	parser.addOption(summaryOption);
+	parser.addPositionalArgument("runs", "Recorded runs or directories of runs (default: the application's run directory).", "[run|directory...]");
+	parser.process(a);
+
+	RunAnalytics::Settings settings = RunAnalytics::defaultSettings();
+	settings.liquidus = parser.value(liquidusOption).toFloat();
+	settings.soakMinimum = parser.value(soakMinimumOption).toFloat();
+	settings.soakMaximum = parser.value(soakMaximumOption).toFloat();
+	settings.rateWindow = parser.value(rateWindowOption).toFloat();
+
+	QStringList paths = parser.positionalArguments();
+	if (paths.isEmpty())
+		paths.append(RunRecording::defaultDirectory());
+
+	QStringList fileNames;
+	foreach (QString path, paths)
+		fileNames.append(RunAnalytics::findRuns(path));
+
+	QVector<RunAnalytics::Metrics> results = RunAnalytics::analyzeFiles(fileNames, settings);
+
+	Summary summaries[8] = {
+		{ "duration", 0, 0, INFINITY, -INFINITY },
+		{ "peak", 0, 0, INFINITY, -INFINITY },
+		{ "time_to_peak", 0, 0, INFINITY, -INFINITY },
+		{ "time_above_liquidus", 0, 0, INFINITY, -INFINITY },
+		{ "max_ramp_rate", 0, 0, INFINITY, -INFINITY },
+		{ "max_cool_rate", 0, 0, INFINITY, -INFINITY },
+		{ "soak", 0, 0, INFINITY, -INFINITY },
+		{ "rms_tracking_error", 0, 0, INFINITY, -INFINITY }
+	};
+	int valid = 0;
+
+	printf("file,title");
+	for (int i = 0; i < 8; i++)
+		printf(",%s", summaries[i].name);
+	printf("\n");
+
+	foreach (const RunAnalytics::Metrics &metrics, results) {
+		if (!metrics.valid) {
+			fprintf(stderr, "Could not analyze '%s'\n", metrics.fileName.toUtf8().data());
+			continue;
+		}
+
+		float values[8] = {
+			metrics.duration,
+			metrics.peakTemperature,
+			metrics.timeToPeak,
+			metrics.timeAboveLiquidus,
+			metrics.maxRampRate,
+			metrics.maxCoolRate,
+			metrics.soakDuration,
+			metrics.rmsTrackingError
+		};
+
+		// Titles are free text, so they are quoted
+		QString title = metrics.title;
+		title.replace('"', "\"\"");
+		printf("%s,\"%s\"", metrics.fileName.toUtf8().data(), title.toUtf8().data());
+		for (int i = 0; i < 8; i++) {
+			printf(",%.2f", values[i]);
+			summarize(&summaries[i], values[i]);
+		}
+		printf("\n");
+		valid++;
+	}
+
+	if (parser.isSet(summaryOption) && valid) {
+		const char *rows[4] = { "mean", "stddev", "min", "max" };
+		for (int row = 0; row < 4; row++) {
+			printf("# %s,", rows[row]);
+			for (int i = 0; i < 8; i++) {
+				double mean = summaries[i].sum / valid;
+				double variance = qMax(0.0, summaries[i].sumSquares / valid - mean * mean);
+				double value = row == 0 ? mean :
+				               row == 1 ? qSqrt(variance) :
+				               row == 2 ? summaries[i].minimum :
+				                          summaries[i].maximum;
+				printf(",%.2f", value);
+			}
+			printf("\n");
+		}
+	}
+
+	return valid == results.size() ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+#include <QtCore/qmath.h>
+#include "autotuner.h"
+
+Autotuner::Autotuner(OvenManager *ovenManager, QObject *parent) : QObject(parent)
+{
+	_ovenManager = ovenManager;
+	_rule = ZieglerNichols;
+	_running = false;
+	_relayOn = false;
+	_setpoint = 0;
+	_cycle = 0;
+	_maximum = 0;
+	_minimum = 0;
+
+	connect(_ovenManager, &OvenManager::readingsRead, this, &Autotuner::processReadings);
+}
+
+struct oven_gains Autotuner::computeGains(double amplitude, double period, TuningRule rule)
+{
+	struct oven_gains gains;
+	double relay = RELAY_DUTY / 2.0;
+	double kp, ti, td;
+
+	// Describing function of a relay with hysteresis
+	double effective = qSqrt(qMax(amplitude * amplitude - HYSTERESIS * HYSTERESIS, 0.01));
+	double ultimate = 4 * relay / (M_PI * effective);
+
+	switch (rule) {
+	case TyreusLuyben:
+		kp = ultimate / 2.2;
+		ti = 2.2 * period;
+		td = period / 6.3;
+		break;
+	case ZieglerNichols:
+	default:
+		kp = 0.6 * ultimate;
+		ti = period / 2;
+		td = period / 8;
+		break;
+	}
+
+	double scale = 1 << PCBOVEN_GAIN_SHIFT;
+	gains.proportional = qBound(0.0, kp * scale, 65535.0);
+	gains.integral = qBound(0.0, kp / ti * scale, 65535.0);
+	gains.derivative = qBound(0.0, kp * td * scale, 65535.0);
+	return gains;
+}
+
+bool Autotuner::isRunning()
+{
+	return _running;
+}
+
+void Autotuner::start(Temperature setpoint, TuningRule rule)
+{
+	_rule = rule;
+	_setpoint = setpoint;
+	_cycle = 0;
+	_amplitudes.clear();
+	_periods.clear();
+	_cycleStart = QTime();
+	_startTime.start();
+	_running = true;
+
+	_ovenManager->setFilamentsEnabled(true);
+	setRelay(true);
+	emit progress(0, SETTLING_CYCLES + MEASURED_CYCLES);
+}
+
+void Autotuner::stop()
+{
+	if (!_running)
+		return;
+
+	_running = false;
+	_ovenManager->setManualDuty(PCBOVEN_DUTY_AUTOMATIC);
+	_ovenManager->setFilamentsEnabled(false);
+}
+
+void Autotuner::processReadings(struct oven_state state, QTime timestamp)
+{
+	Temperature temperature = state.probe_temp;
+	Temperature hysteresis = HYSTERESIS * PCBOVEN_TEMP_ONE;
+
+	if (!_running)
+		return;
+
+	if (state.fault_open_circuit || state.fault_short_gnd || state.fault_short_vcc) {
+		stop();
+		emit failed("Thermocouple fault");
+		return;
+	}
+
+	if (_startTime.msecsTo(timestamp) > TIMEOUT_MINUTES * 60 * 1000) {
+		stop();
+		emit failed("The oven did not settle into an oscillation");
+		return;
+	}
+
+	_maximum = qMax(_maximum, temperature);
+	_minimum = qMin(_minimum, temperature);
+
+	if (_relayOn && temperature > _setpoint + hysteresis) {
+		setRelay(false);
+	} else if (!_relayOn && temperature < _setpoint - hysteresis) {
+		// An oscillation completes each time the heaters come back on
+		if (_cycleStart.isValid()) {
+			_cycle++;
+			if (_cycle > SETTLING_CYCLES) {
+				_amplitudes.append(temperatureToCelsius(_maximum - _minimum) / 2.0);
+				_periods.append(_cycleStart.msecsTo(timestamp) / 1000.0);
+			}
+			emit progress(_cycle, SETTLING_CYCLES + MEASURED_CYCLES);
+
+			if (_amplitudes.size() >= MEASURED_CYCLES) {
+				double amplitude = 0;
+				double period = 0;
+				for (int i = 0; i < _amplitudes.size(); i++) {
+					amplitude += _amplitudes[i] / _amplitudes.size();
+					period += _periods[i] / _periods.size();
+				}
+
+				struct oven_gains gains = computeGains(amplitude, period, _rule);
+				stop();
+				_ovenManager->setGains(gains);
+				emit finished(gains);
+				return;
+			}
+		}
+
+		_cycleStart = timestamp;
+		_maximum = _minimum = temperature;
+		setRelay(true);
+	}
+}
+
+void Autotuner::setRelay(bool on)
+{
+	_relayOn = on;
+	_ovenManager->setManualDuty(on ? RELAY_DUTY : 0);
+}
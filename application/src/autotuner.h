@@ -0,0 +1,61 @@
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include <QObject>
+#include <QTime>
+#include <QVector>
+#include "ovenmanager.h"
+#include "pcboven_protocol.h"
+
+// Relay feedback experiment: the heaters are switched fully on below the
+// setpoint and off above it, and the ultimate gain and period of the
+// resulting oscillation are turned into PID gains.
+class Autotuner : public QObject
+{
+	Q_OBJECT
+
+	public:
+		enum TuningRule {
+			ZieglerNichols,
+			TyreusLuyben
+		};
+
+		explicit Autotuner(OvenManager *ovenManager, QObject *parent = 0);
+
+		static const int RELAY_DUTY = 255;
+		static const int HYSTERESIS = 2;
+		static const int SETTLING_CYCLES = 2;
+		static const int MEASURED_CYCLES = 3;
+		static const int TIMEOUT_MINUTES = 120;
+
+		static struct oven_gains computeGains(double amplitude, double period, TuningRule rule);
+		bool isRunning();
+
+	signals:
+		void progress(int cycle, int cycles);
+		void finished(struct oven_gains gains);
+		void failed(QString reason);
+
+	public slots:
+		void start(Temperature setpoint, TuningRule rule);
+		void stop();
+		void processReadings(struct oven_state state, QTime timestamp);
+
+	private:
+		void setRelay(bool on);
+
+		OvenManager *_ovenManager;
+		TuningRule _rule;
+		bool _running;
+		bool _relayOn;
+		Temperature _setpoint;
+		QTime _startTime;
+		QTime _cycleStart;
+		int _cycle;
+		Temperature _maximum;
+		Temperature _minimum;
+		QVector<double> _amplitudes;
+		QVector<double> _periods;
+};
+
+#endif // AUTOTUNER_H
@@ -0,0 +1,49 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <iostream>
+#include "brokerprotocol.h"
+#include "metricsexporter.h"
+#include "ovenbroker.h"
+#include "ovenmanager.h"
+#include "oventransport.h"
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+	a.setOrganizationName("PCBoven");
+	a.setApplicationName("pcboven-broker");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Shares a PCBoven between local clients.");
+	parser.addHelpOption();
+	QCommandLineOption socketOption("socket", "Name of the broker socket.", "name", BrokerProtocol::DEFAULT_SOCKET);
+	QCommandLineOption metricsOption("metrics-port", "Serve OpenMetrics telemetry on localhost.", "port");
+	QCommandLineOption transportOption("transport", "How to reach the oven: " + OvenTransport::names().join(", ") + ".",
+	                                   "name", OvenTransport::DEFAULT_TRANSPORT);
+	parser.addOption(socketOption);
+	parser.addOption(metricsOption);
+	parser.addOption(transportOption);
+	parser.process(a);
+
+	OvenManager ovenManager;
+	OvenBroker broker(&ovenManager);
+
+	if (!broker.listen(parser.value(socketOption))) {
+		std::cerr << "Could not listen on '"
+		          << parser.value(socketOption).toUtf8().data()
+		          << "'"
+		          << std::endl;
+		return -1;
+	}
+
+	MetricsExporter metricsExporter(&ovenManager);
+	if (parser.isSet(metricsOption) && !metricsExporter.listen(parser.value(metricsOption).toUShort())) {
+		std::cerr << "Could not serve metrics on port "
+		          << parser.value(metricsOption).toUtf8().data()
+		          << std::endl;
+		return -1;
+	}
+
+	ovenManager.start(parser.value(transportOption));
+	return a.exec();
+}
@@ -0,0 +1,161 @@
+#include <QDataStream>
+#include "brokerprotocol.h"
+
+#define STATE_ENABLE        (1 << 0)
+#define STATE_SHORT_VCC     (1 << 1)
+#define STATE_SHORT_GND     (1 << 2)
+#define STATE_OPEN_CIRCUIT  (1 << 3)
+#define STATE_TOP_ON        (1 << 4)
+#define STATE_BOTTOM_ON     (1 << 5)
+#define STATE_MANUAL        (1 << 6)
+#define STATE_APPLIED       (1 << 7)
+
+const char *BrokerProtocol::DEFAULT_SOCKET = "pcboven-broker";
+
+QByteArray BrokerProtocol::frame(quint8 type, QByteArray payload)
+{
+	QByteArray data;
+	QDataStream out(&data, QIODevice::WriteOnly);
+	out.setByteOrder(QDataStream::LittleEndian);
+	out << (quint16)(payload.size() + 1) << type;
+	data.append(payload);
+	return data;
+}
+
+bool BrokerProtocol::unframe(QByteArray *buffer, quint8 *type, QByteArray *payload)
+{
+	if (buffer->size() < 3)
+		return false;
+
+	quint16 length = (quint8)buffer->at(0) | ((quint8)buffer->at(1) << 8);
+	if (buffer->size() < 2 + length)
+		return false;
+
+	*type = buffer->at(2);
+	*payload = buffer->mid(3, length - 1);
+	buffer->remove(0, 2 + length);
+	return true;
+}
+
+QByteArray BrokerProtocol::encodeState(struct oven_state state, struct oven_gains gains, QTime timestamp)
+{
+	QByteArray payload;
+	QDataStream out(&payload, QIODevice::WriteOnly);
+	quint8 flags = (state.enable_filaments   ? STATE_ENABLE       : 0) |
+	               (state.fault_short_vcc    ? STATE_SHORT_VCC    : 0) |
+	               (state.fault_short_gnd    ? STATE_SHORT_GND    : 0) |
+	               (state.fault_open_circuit ? STATE_OPEN_CIRCUIT : 0) |
+	               (state.filament_top_on    ? STATE_TOP_ON       : 0) |
+	               (state.filament_bottom_on ? STATE_BOTTOM_ON    : 0) |
+	               (state.manual_duty        ? STATE_MANUAL       : 0) |
+	               (state.applied_enable     ? STATE_APPLIED      : 0);
+
+	out.setByteOrder(QDataStream::LittleEndian);
+	out << (qint16)state.probe_temp
+	    << (qint16)state.internal_temp
+	    << (qint16)state.target_temp
+	    << (qint16)state.applied_target_temp
+	    << flags
+	    << (quint8)state.top_duty
+	    << (quint8)state.bottom_duty
+	    << (quint8)state.balance
+	    << (quint8)state.trip_reason
+	    << (quint8)state.failsafe
+	    << (quint8)state.cooling_duty
+	    << (quint8)state.manual_cooling
+	    << (quint16)gains.proportional
+	    << (quint16)gains.integral
+	    << (quint16)gains.derivative
+	    << (qint32)timestamp.msecsSinceStartOfDay();
+	return payload;
+}
+
+bool BrokerProtocol::decodeState(QByteArray payload, struct oven_state *state, struct oven_gains *gains, QTime *timestamp)
+{
+	QDataStream in(payload);
+	qint16 probe, internal, target, applied;
+	quint8 flags, top, bottom, balance, trip, failsafe, cooling, manualCooling;
+	quint16 p, i, d;
+	qint32 time;
+
+	in.setByteOrder(QDataStream::LittleEndian);
+	in >> probe >> internal >> target >> applied >> flags >> top >> bottom >> balance >> trip >> failsafe >> cooling >> manualCooling >> p >> i >> d >> time;
+	if (in.status() != QDataStream::Ok)
+		return false;
+
+	state->probe_temp         = probe;
+	state->internal_temp      = internal;
+	state->target_temp        = target;
+	state->applied_target_temp = applied;
+	state->enable_filaments   = flags & STATE_ENABLE;
+	state->fault_short_vcc    = flags & STATE_SHORT_VCC;
+	state->fault_short_gnd    = flags & STATE_SHORT_GND;
+	state->fault_open_circuit = flags & STATE_OPEN_CIRCUIT;
+	state->filament_top_on    = flags & STATE_TOP_ON;
+	state->filament_bottom_on = flags & STATE_BOTTOM_ON;
+	state->manual_duty        = flags & STATE_MANUAL;
+	state->applied_enable     = flags & STATE_APPLIED;
+	state->top_duty           = top;
+	state->bottom_duty        = bottom;
+	state->balance            = balance;
+	state->trip_reason        = trip;
+	state->failsafe           = failsafe;
+	state->cooling_duty       = cooling;
+	state->manual_cooling     = manualCooling;
+	gains->proportional       = p;
+	gains->integral           = i;
+	gains->derivative         = d;
+	*timestamp = QTime::fromMSecsSinceStartOfDay(time);
+	return true;
+}
+
+// A uint16 count, then each sample's uint32 device time and int16 probe
+QByteArray BrokerProtocol::encodeSamples(QVector<oven_sample> samples)
+{
+	QByteArray payload;
+	QDataStream out(&payload, QIODevice::WriteOnly);
+
+	out.setByteOrder(QDataStream::LittleEndian);
+	out << (quint16)samples.size();
+	foreach (const struct oven_sample &sample, samples)
+		out << (quint32)sample.time << (qint16)sample.probe_temp;
+	return payload;
+}
+
+bool BrokerProtocol::decodeSamples(QByteArray payload, QVector<oven_sample> *samples)
+{
+	QDataStream in(payload);
+	quint16 count;
+	quint32 time;
+	qint16 probe;
+
+	in.setByteOrder(QDataStream::LittleEndian);
+	in >> count;
+	samples->clear();
+	for (int i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+		struct oven_sample sample;
+		in >> time >> probe;
+		sample.time = time;
+		sample.probe_temp = probe;
+		samples->append(sample);
+	}
+	return in.status() == QDataStream::Ok;
+}
+
+QByteArray BrokerProtocol::encodeInt(qint32 value)
+{
+	QByteArray payload;
+	QDataStream out(&payload, QIODevice::WriteOnly);
+	out.setByteOrder(QDataStream::LittleEndian);
+	out << value;
+	return payload;
+}
+
+qint32 BrokerProtocol::decodeInt(QByteArray payload)
+{
+	QDataStream in(payload);
+	qint32 value = 0;
+	in.setByteOrder(QDataStream::LittleEndian);
+	in >> value;
+	return value;
+}
@@ -0,0 +1,47 @@
+#ifndef BROKERPROTOCOL_H
+#define BROKERPROTOCOL_H
+
+#include <QByteArray>
+#include <QTime>
+#include <QVector>
+#include <stdint.h>
+#include "pcboven_usb.h"
+
+// Frames on the broker's Unix domain socket are a little endian uint16
+// length (counting the type and payload), a uint8 message type and the
+// payload. All integers are little endian.
+class BrokerProtocol
+{
+	public:
+		enum MessageType {
+			// Broker to client
+			Connected = 0x01,     // no payload
+			Disconnected = 0x02,  // no payload
+			State = 0x03,         // see encodeState()
+			Error = 0x04,         // int32 errno
+			Control = 0x05,       // uint8 granted
+			Samples = 0x06,       // see encodeSamples(), sent before their State
+
+			// Client to broker
+			AcquireControl = 0x81,  // no payload
+			ReleaseControl = 0x82,  // no payload
+			Command = 0x83          // uint32 ioctl code, int32 value or the ioctl's struct
+		};
+
+		static const char *DEFAULT_SOCKET;
+		static const int MAX_FRAME = 0xFFFF;
+
+		static QByteArray frame(quint8 type, QByteArray payload = QByteArray());
+		static bool unframe(QByteArray *buffer, quint8 *type, QByteArray *payload);
+
+		static QByteArray encodeState(struct oven_state state, struct oven_gains gains, QTime timestamp);
+		static bool decodeState(QByteArray payload, struct oven_state *state, struct oven_gains *gains, QTime *timestamp);
+
+		static QByteArray encodeSamples(QVector<oven_sample> samples);
+		static bool decodeSamples(QByteArray payload, QVector<oven_sample> *samples);
+
+		static QByteArray encodeInt(qint32 value);
+		static qint32 decodeInt(QByteArray payload);
+};
+
+#endif // BROKERPROTOCOL_H
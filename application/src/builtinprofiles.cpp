@@ -0,0 +1,118 @@
+#include <QCryptographicHash>
+#include <QDataStream>
+#include "builtinprofiles.h"
+
+typedef ReflowProfile::Waypoint Waypoint;
+
+#define BALANCE 0.5
+
+// SAC305 (Sn96.5/Ag3.0/Cu0.5): liquidus 217C, 45-90s above it, 245C peak
+static constexpr Waypoint sac305[] = {
+	{ReflowProfile::Linear,   0,  25, 0, BALANCE},
+	{ReflowProfile::Linear,  90, 150, 0, BALANCE},
+	{ReflowProfile::Linear, 180, 200, 0, BALANCE},
+	{ReflowProfile::Cubic,  225, 245, 0, BALANCE},
+	{ReflowProfile::Linear, 235, 245, 0, BALANCE},
+	{ReflowProfile::Cubic,  255, 217, 0, BALANCE},
+	{ReflowProfile::Linear, 330,  50, 0, BALANCE},
+};
+
+// Sn63/Pb37: eutectic at 183C, 45-75s above it, 220C peak
+static constexpr Waypoint sn63pb37[] = {
+	{ReflowProfile::Linear,   0,  25, 0, BALANCE},
+	{ReflowProfile::Linear,  75, 150, 0, BALANCE},
+	{ReflowProfile::Linear, 165, 180, 0, BALANCE},
+	{ReflowProfile::Cubic,  200, 220, 0, BALANCE},
+	{ReflowProfile::Linear, 210, 220, 0, BALANCE},
+	{ReflowProfile::Cubic,  230, 183, 0, BALANCE},
+	{ReflowProfile::Linear, 300,  50, 0, BALANCE},
+};
+
+// Sn42/Bi58: eutectic at 138C, 30-60s above it, 170C peak
+static constexpr Waypoint sn42bi58[] = {
+	{ReflowProfile::Linear,   0,  25, 0, BALANCE},
+	{ReflowProfile::Linear,  60,  90, 0, BALANCE},
+	{ReflowProfile::Linear, 150, 130, 0, BALANCE},
+	{ReflowProfile::Cubic,  180, 165, 0, BALANCE},
+	{ReflowProfile::Linear, 190, 170, 0, BALANCE},
+	{ReflowProfile::Cubic,  205, 138, 0, BALANCE},
+	{ReflowProfile::Linear, 270,  40, 0, BALANCE},
+};
+
+template <int N>
+static constexpr bool is_valid(const Waypoint (&waypoints)[N])
+{
+	return ReflowProfile::validate(waypoints, N).violation == ReflowProfile::Valid;
+}
+
+static_assert(is_valid(sac305), "The SAC305 profile breaks the profile rules");
+static_assert(is_valid(sn63pb37), "The Sn63/Pb37 profile breaks the profile rules");
+static_assert(is_valid(sn42bi58), "The Sn42/Bi58 profile breaks the profile rules");
+
+// A cubic from one flat stretch to another is half as steep again as its
+// secant at the middle, so this climbs at 3.75C/s while the secant is 2.5C/s
+static constexpr Waypoint steep_cubic[] = {
+	{ReflowProfile::Linear,   0,  25, 0, BALANCE},
+	{ReflowProfile::Linear,  60,  25, 0, BALANCE},
+	{ReflowProfile::Cubic,  100, 125, 0, BALANCE},
+	{ReflowProfile::Linear, 160, 125, 0, BALANCE},
+};
+
+static_assert(ReflowProfile::validate(steep_cubic, 4).violation == ReflowProfile::HeatingRate &&
+              ReflowProfile::validate(steep_cubic, 4).waypoint == 2,
+              "The profile rules miss a cubic steeper than its secant");
+
+#define TABLE(waypoints) waypoints, sizeof(waypoints) / sizeof(waypoints[0])
+
+static const BuiltinProfiles::Profile catalogue[] = {
+	{"sac305", "SAC305 (lead-free)", TABLE(sac305)},
+	{"sn63pb37", "Sn63/Pb37 (leaded)", TABLE(sn63pb37)},
+	{"sn42bi58", "Sn42/Bi58 (low temperature)", TABLE(sn42bi58)},
+};
+
+const char BuiltinProfiles::PREFIX[] = "builtin:";
+
+int BuiltinProfiles::count()
+{
+	return sizeof(catalogue) / sizeof(catalogue[0]);
+}
+
+const BuiltinProfiles::Profile &BuiltinProfiles::at(int index)
+{
+	return catalogue[index];
+}
+
+const BuiltinProfiles::Profile *BuiltinProfiles::find(QString fileName)
+{
+	for (int i = 0; i < count(); i++) {
+		if (BuiltinProfiles::fileName(catalogue[i]) == fileName)
+			return &catalogue[i];
+	}
+	return 0;
+}
+
+QString BuiltinProfiles::fileName(const Profile &profile)
+{
+	return QString(PREFIX) + profile.name;
+}
+
+ReflowProfile BuiltinProfiles::create(const Profile &profile)
+{
+	QVector<Waypoint> waypoints(profile.count);
+	for (int i = 0; i < profile.count; i++)
+		waypoints[i] = profile.waypoints[i];
+	return ReflowProfile(profile.title, waypoints);
+}
+
+// Identifies the table a run used, as the file checksum does for loaded profiles
+QByteArray BuiltinProfiles::checksum(const Profile &profile)
+{
+	QByteArray table;
+	QDataStream out(&table, QIODevice::WriteOnly);
+	out << QByteArray(profile.name);
+	for (int i = 0; i < profile.count; i++) {
+		const Waypoint &step = profile.waypoints[i];
+		out << (qint32)step.segment << step.timestamp << step.temperature << step.tolerance << step.balance;
+	}
+	return QCryptographicHash::hash(table, QCryptographicHash::Sha1);
+}
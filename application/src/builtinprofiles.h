@@ -0,0 +1,34 @@
+#ifndef BUILTINPROFILES_H
+#define BUILTINPROFILES_H
+
+#include <QByteArray>
+#include <QString>
+#include "reflowprofile.h"
+
+/*
+ * Profiles for common alloys, compiled in as waypoint tables and checked
+ * against ReflowProfile::validate() at compile time, so they are available
+ * without a profile directory or any parsing. They appear in the profile
+ * library under PREFIX followed by their name.
+ */
+class BuiltinProfiles
+{
+	public:
+		struct Profile {
+			const char *name;
+			const char *title;
+			const ReflowProfile::Waypoint *waypoints;
+			int count;
+		};
+
+		static const char PREFIX[];
+
+		static int count();
+		static const Profile &at(int index);
+		static const Profile *find(QString fileName);
+		static QString fileName(const Profile &profile);
+		static ReflowProfile create(const Profile &profile);
+		static QByteArray checksum(const Profile &profile);
+};
+
+#endif // BUILTINPROFILES_H
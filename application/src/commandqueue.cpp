@@ -0,0 +1,196 @@
+#include <errno.h>
+#include <string.h>
+#include "brokerprotocol.h"
+#include "commandqueue.h"
+
+CommandQueue::CommandQueue(QObject *parent) : QObject(parent)
+{
+	_transport = NULL;
+	_brokerSocket = NULL;
+	_inFlightCancelled = false;
+	_busy = false;
+
+	CommandWorker *worker = new CommandWorker();
+	worker->moveToThread(&_thread);
+	connect(&_thread, &QThread::finished, worker, &QObject::deleteLater);
+	connect(this, &CommandQueue::dispatched, worker, &CommandWorker::execute);
+	connect(worker, &CommandWorker::executed, this, &CommandQueue::executed);
+	_thread.start();
+}
+
+CommandQueue::~CommandQueue()
+{
+	_thread.quit();
+	_thread.wait();
+}
+
+void CommandQueue::setTransport(OvenTransport *transport)
+{
+	_transport = transport;
+	_brokerSocket = NULL;
+}
+
+// Commands to a broker are plain socket writes, so they are sent from here
+void CommandQueue::setBroker(QLocalSocket *socket)
+{
+	_brokerSocket = socket;
+	_transport = NULL;
+}
+
+void CommandQueue::submit(unsigned long code, int value)
+{
+	Command command;
+	command.code = code;
+	command.data = QByteArray((const char *)&value, sizeof(value));
+	command.byReference = false;
+	enqueue(command);
+}
+
+void CommandQueue::submit(unsigned long code, const void *data, int size)
+{
+	Command command;
+	command.code = code;
+	command.data = QByteArray((const char *)data, size);
+	command.byReference = true;
+	enqueue(command);
+}
+
+void CommandQueue::enqueue(Command command)
+{
+	command.attempts = 0;
+	command.submitted.start();
+
+	// A newer command supersedes any of its kind that has not gone out yet
+	// or is still waiting for its echo
+	cancel(command.code);
+	_pending.append(command);
+	dispatchNext();
+}
+
+// Called with every reading. Tracked commands complete once the firmware
+// reports them applied, and are resent if it still has not after the timeout.
+void CommandQueue::acknowledge(struct oven_state state)
+{
+	for (int i = 0; i < _unconfirmed.size(); ) {
+		Command command = _unconfirmed[i];
+
+		if (isApplied(command, state)) {
+			_unconfirmed.removeAt(i);
+			emit completed(command.code, command.submitted.elapsed());
+		} else if (command.sent.hasExpired(ACK_TIMEOUT_MS)) {
+			_unconfirmed.removeAt(i);
+			if (command.attempts < MAX_ATTEMPTS) {
+				_pending.append(command);
+				dispatchNext();
+			} else {
+				emit failed(command.code, ETIMEDOUT);
+			}
+		} else {
+			i++;
+		}
+	}
+}
+
+// Drops the pending, in flight and unconfirmed commands of the same kind
+// without reporting them. One in flight still reaches the oven, but is not
+// tracked or resent once its ioctl returns.
+void CommandQueue::cancel(unsigned long code)
+{
+	unsigned long kind = kindOf(code);
+
+	if (_busy && kindOf(_inFlight.code) == kind)
+		_inFlightCancelled = true;
+
+	for (int i = _pending.size() - 1; i >= 0; i--) {
+		if (kindOf(_pending[i].code) == kind)
+			_pending.removeAt(i);
+	}
+	for (int i = _unconfirmed.size() - 1; i >= 0; i--) {
+		if (kindOf(_unconfirmed[i].code) == kind)
+			_unconfirmed.removeAt(i);
+	}
+}
+
+void CommandQueue::clear()
+{
+	_inFlightCancelled |= _busy;
+	_pending.clear();
+	_unconfirmed.clear();
+}
+
+void CommandQueue::dispatchNext()
+{
+	if (_busy || _pending.isEmpty())
+		return;
+
+	_inFlight = _pending.takeFirst();
+	_inFlight.attempts++;
+	_inFlight.sent.start();
+	_inFlightCancelled = false;
+	_busy = true;
+
+	if (_brokerSocket) {
+		QByteArray payload = BrokerProtocol::encodeInt(_inFlight.code);
+		payload.append(_inFlight.data);
+		_brokerSocket->write(BrokerProtocol::frame(BrokerProtocol::Command, payload));
+		executed(_inFlight.code, 0);
+	} else {
+		emit dispatched(_transport, _inFlight.code, _inFlight.data, _inFlight.byReference);
+	}
+}
+
+void CommandQueue::executed(unsigned long code, int error)
+{
+	Command command = _inFlight;
+	(void)code;
+
+	_busy = false;
+	if (error) {
+		emit failed(command.code, error);
+	} else if (_inFlightCancelled) {
+		// Superseded or cancelled while the ioctl ran, so never resent
+	} else if (isTracked(command.code)) {
+		_unconfirmed.append(command);
+	} else {
+		emit completed(command.code, command.submitted.elapsed());
+	}
+	dispatchNext();
+}
+
+unsigned long CommandQueue::kindOf(unsigned long code)
+{
+	if (code == PCBOVEN_DISABLE_FILAMENTS)
+		return PCBOVEN_ENABLE_FILAMENTS;
+	if (code == PCBOVEN_SET_DUTY)
+		return PCBOVEN_SET_ELEMENT_DUTY;
+	return code;
+}
+
+bool CommandQueue::isTracked(unsigned long code)
+{
+	return code == PCBOVEN_SET_TEMPERATURE ||
+	       code == PCBOVEN_ENABLE_FILAMENTS ||
+	       code == PCBOVEN_DISABLE_FILAMENTS;
+}
+
+bool CommandQueue::isApplied(const Command &command, struct oven_state state)
+{
+	int value;
+
+	switch (command.code) {
+	case PCBOVEN_SET_TEMPERATURE:
+		memcpy(&value, command.data.constData(), sizeof(value));
+		return state.applied_target_temp == value;
+	case PCBOVEN_ENABLE_FILAMENTS:
+		return state.applied_enable;
+	case PCBOVEN_DISABLE_FILAMENTS:
+		return !state.applied_enable;
+	default:
+		return true;
+	}
+}
+
+void CommandWorker::execute(OvenTransport *transport, unsigned long code, QByteArray data, bool byReference)
+{
+	emit executed(code, transport ? transport->execute(code, data, byReference) : ENODEV);
+}
@@ -0,0 +1,83 @@
+#ifndef COMMANDQUEUE_H
+#define COMMANDQUEUE_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QLocalSocket>
+#include <QObject>
+#include <QThread>
+#include "oventransport.h"
+
+// Sends the oven's commands in order, one at a time, through the transport
+// on a worker thread so a slow USB transfer never stalls the caller. A command
+// still waiting to be sent is replaced by a newer one of the same kind.
+// Target temperature and filament commands are then tracked until the
+// firmware echoes them in its telemetry, resent if the echo does not match
+// within ACK_TIMEOUT_MS and reported as failed after MAX_ATTEMPTS.
+class CommandQueue : public QObject
+{
+	Q_OBJECT
+
+	public:
+		explicit CommandQueue(QObject *parent = 0);
+		virtual ~CommandQueue();
+
+		static const int ACK_TIMEOUT_MS = 2500;
+		static const int MAX_ATTEMPTS = 3;
+
+		void setTransport(OvenTransport *transport);
+		void setBroker(QLocalSocket *socket);
+		void submit(unsigned long code, int value = 0);
+		void submit(unsigned long code, const void *data, int size);
+		void acknowledge(struct oven_state state);
+		void cancel(unsigned long code);
+		void clear();
+
+	signals:
+		void dispatched(OvenTransport *transport, unsigned long code, QByteArray data, bool byReference);
+		void completed(unsigned long code, int latency_ms);
+		void failed(unsigned long code, int error);
+
+	private slots:
+		void executed(unsigned long code, int error);
+
+	private:
+		struct Command {
+			unsigned long code;
+			QByteArray data;
+			bool byReference;
+			int attempts;
+			QElapsedTimer submitted;
+			QElapsedTimer sent;
+		};
+
+		static unsigned long kindOf(unsigned long code);
+		static bool isTracked(unsigned long code);
+		static bool isApplied(const Command &command, struct oven_state state);
+		void enqueue(Command command);
+		void dispatchNext();
+
+		QThread _thread;
+		OvenTransport *_transport;
+		QLocalSocket *_brokerSocket;
+		QList<Command> _pending;
+		QList<Command> _unconfirmed;
+		Command _inFlight;
+		bool _inFlightCancelled;
+		bool _busy;
+};
+
+// Runs the commands on the queue's thread
+class CommandWorker : public QObject
+{
+	Q_OBJECT
+
+	public slots:
+		void execute(OvenTransport *transport, unsigned long code, QByteArray data, bool byReference);
+
+	signals:
+		void executed(unsigned long code, int error);
+};
+
+#endif // COMMANDQUEUE_H
@@ -1,41 +1,102 @@
-#include <QFile>
+#include <QDateTime>
+#include <QDir>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QInputDialog>
 #include <QMessageBox>
+#include <QtCore/qmath.h>
 #include <errno.h>
 #include <iostream>
+#include "builtinprofiles.h"
 #include "controlpanel.h"
 #include "ui_controlpanel.h"
 
-ControlPanel::ControlPanel(QWidget *parent) : QMainWindow(parent), ui(new Ui::ControlPanel)
+ControlPanel::ControlPanel(QString profilePath, QString brokerName, QString transport, QWidget *parent) : QMainWindow(parent), ui(new Ui::ControlPanel)
 {
 	_ovenManager = new OvenManager(this);
 	connect(_ovenManager, &OvenManager::errorOccurred, this, &ControlPanel::handleError);
 	connect(_ovenManager, &OvenManager::connected, this, &ControlPanel::ovenConnected);
 	connect(_ovenManager, &OvenManager::disconnected, this, &ControlPanel::ovenDisconnected);
+	connect(_ovenManager, &OvenManager::tripped, this, &ControlPanel::ovenTripped, Qt::QueuedConnection);
+	connect(_ovenManager, &OvenManager::commandCompleted, this, &ControlPanel::commandCompleted);
 
+	_autotuner = new Autotuner(_ovenManager, this);
+	connect(_autotuner, &Autotuner::progress, this, &ControlPanel::autotuneProgress);
+	connect(_autotuner, &Autotuner::finished, this, &ControlPanel::autotuneFinished);
+	connect(_autotuner, &Autotuner::failed, this, &ControlPanel::autotuneFailed);
+
+	_metricsExporter = NULL;
+	_estimatedTemperature = 0;
+	_estimatedRate = 0;
+	_thermalModel = ThermalModel::load();
+	_capability = OvenCapability::load();
+	applyThermalModel();
+	connect(_ovenManager, &OvenManager::estimateUpdated, this, &ControlPanel::updateEstimate);
 	_reflowTimer = new QTimer(this);
 	_reflowTimer->setInterval(ControlPanel::REFLOW_CHECK_PERIOD_MS);
 	connect(_reflowTimer, &QTimer::timeout, this, &ControlPanel::checkProfile);
+	_resumeWindow = RESUME_WINDOW_MS;
+	_gapStart = 0;
+	_resumeTimer = new QTimer(this);
+	_resumeTimer->setSingleShot(true);
+	connect(_resumeTimer, &QTimer::timeout, this, &ControlPanel::resumeTimedOut);
+	_recoveryTimer = new QTimer(this);
+	_recoveryTimer->setSingleShot(true);
+	connect(_recoveryTimer, &QTimer::timeout, this, &ControlPanel::recoveryTimedOut);
+	_jobTimer = new QTimer(this);
+	_jobTimer->setInterval(REFLOW_CHECK_PERIOD_MS);
+	connect(_jobTimer, &QTimer::timeout, this, &ControlPanel::checkJobs);
 
 	ui->setupUi(this);
+	ui->reflowGraph->setThreadedRendering(true);
 	connectionStatus = new QLabel("Waiting for connection");
 	reflowStatus = new QLabel(QTime(0, 0).toString());
+	estimateStatus = new QLabel();
+	ui->statusBar->addPermanentWidget(estimateStatus);
 	ui->statusBar->addPermanentWidget(connectionStatus);
 	ui->statusBar->addPermanentWidget(reflowStatus);
 
-	QFile rawProfile(qApp->arguments().last());
-	if (rawProfile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-		_profile = ReflowProfile::parseFromJson(rawProfile.readAll());
-		rawProfile.close();
-		ui->reflowGraph->setTemperatureTargets(_profile.getProfile());
-	} else {
+	profileSelector = new QComboBox();
+	profileSelector->setSizeAdjustPolicy(QComboBox::AdjustToContents);
+	ui->mainToolBar->addSeparator();
+	ui->mainToolBar->addWidget(profileSelector);
+
+	_profileLibrary = new ProfileLibrary(REFLOW_STEP_PERIOD_MS, this);
+	connect(_profileLibrary, &ProfileLibrary::entriesChanged, this, &ControlPanel::refreshProfiles);
+	connect(_profileLibrary, &ProfileLibrary::profileChanged, this, &ControlPanel::reloadProfile);
+
+	// The argument is either a single profile or a directory of profiles;
+	// without one only the built-in profiles are offered
+	QFileInfo profileInfo(profilePath);
+	QString libraryPath = profileInfo.isDir() ? profileInfo.filePath() : profileInfo.path();
+	if (!profilePath.isEmpty() && !profileInfo.isDir())
+		_profileName = profileInfo.fileName();
+
+	if (!profilePath.isEmpty() && !_profileLibrary->open(libraryPath)) {
 		std::cerr << "Could not open '"
-		          << qApp->arguments().last().toUtf8().data()
+		          << profilePath.toUtf8().data()
 		          << "'"
 		          << std::endl;
 	}
-	_profile.interpolate(REFLOW_STEP_PERIOD_MS);
+	refreshProfiles();
+	if (profileSelector->currentIndex() >= 0)
+		selectProfile(profileSelector->currentIndex());
+	else if (profileSelector->count())
+		selectProfile(0);
+	connect(profileSelector, static_cast<void (QComboBox::*)(int)>(&QComboBox::activated), this, &ControlPanel::selectProfile);
 
-	_ovenManager->start();
+	// A run the last instance never finished is taken up again, or the oven
+	// is switched off, as soon as the oven is connected
+	if (_journal.recover(&_interruptedRun)) {
+		_recoveryTimer->start(RECOVERY_TIMEOUT_MS);
+		ui->statusBar->showMessage("Recovering an interrupted reflow");
+	}
+
+	// Without a broker the oven is reached through the given transport
+	if (brokerName.isEmpty())
+		_ovenManager->start(transport);
+	else
+		_ovenManager->startBroker(brokerName);
 }
 
 ControlPanel::~ControlPanel()
@@ -45,50 +106,332 @@ ControlPanel::~ControlPanel()
 
 void ControlPanel::on_actionStart_Reflow_triggered()
 {
-	_reflowStartTime.start();
+	if (_targets.isEmpty()) {
+		ui->statusBar->showMessage("No reflow profile selected");
+		return;
+	}
+
+	if (!_feasibility.isFeasible() &&
+	    QMessageBox::question(this, "Start reflow",
+	                          QString("The oven is not expected to follow this profile: %1.\n\nStart anyway?").arg(_feasibility.describe()),
+	                          QMessageBox::Yes | QMessageBox::No, QMessageBox::No) != QMessageBox::Yes)
+		return;
+
+	beginRun(0, QString());
+}
+
+// Starts a new run of the selected profile, offset ms into it
+void ControlPanel::beginRun(int offset, QString board)
+{
+	_reflowStartTime = QTime::currentTime().addMSecs(-offset);
+	_runId = QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss");
 	ui->reflowGraph->clearGraph();
+	_recording.clear();
+	_recording.setTitle(board.isEmpty() ? _profile.getTitle() : QString("%1 (board %2)").arg(_profile.getTitle(), board));
+	_segment = -1;
+	_holdExtension = 0;
+
+	RunJournal::Run run;
+	run.id = _runId;
+	run.directory = _profileLibrary->getDirectory();
+	run.profile = _profileName;
+	run.checksum = _profileLibrary->getEntry(_profileName).checksum;
+	run.started = RunJournal::now() - offset;
+	if (!_journal.begin(run))
+		std::cerr << "Could not start the run journal" << std::endl;
+
+	startReflow();
+}
+
+// Starts driving the oven from the point of the profile that the start time
+// and hold extension give, which is the beginning for a new run
+void ControlPanel::startReflow()
+{
 	ui->actionStart_Reflow->setEnabled(false);
 	ui->actionStop_Reflow->setEnabled(true);
+	ui->actionAutotune->setEnabled(false);
+	ui->actionRun_Job_Queue->setEnabled(false);
+	profileSelector->setEnabled(false);
 	_ovenManager->setFilamentsEnabled(true);
-
-
 	connect(_ovenManager, &OvenManager::readingsRead, this, &ControlPanel::logReadings);
 
-	_nextTarget = _profile.getProfile().constBegin();
+	_nextTarget = _targets.constBegin();
 	checkProfile();
 
 	_ovenManager->setTargetTemperature(_nextTarget.value());
-	ui->statusBar->showMessage(QString("Target temperature: %1C").arg(_nextTarget.value()));
+	_journal.step(_segment, _holdExtension, _nextTarget.value(), true);
+	ui->statusBar->showMessage(QString("Target temperature: %1C").arg(temperatureToCelsius(_nextTarget.value())));
 
 	_reflowTimer->start();
+	emit reflowStarted();
 }
 
 void ControlPanel::on_actionStop_Reflow_triggered()
 {
+	bool queued = _jobTimer->isActive();
+
+	_jobTimer->stop();
+	stopReflow();
+	if (queued) {
+		_ovenManager->setCooling(PCBOVEN_COOLING_AUTOMATIC);
+		ui->statusBar->showMessage(QString("Job queue stopped after %1 of %2 boards (%3 boards/h)")
+		                           .arg(_jobs.getCompleted())
+		                           .arg(_jobs.size())
+		                           .arg(_jobs.getBoardsPerHour(), 0, 'f', 1));
+	}
+}
+
+// Ends the run, or whatever else drives the oven. The controls stay locked
+// while a job queue runs.
+void ControlPanel::stopReflow()
+{
+	bool idle = !_jobTimer->isActive();
+
+	if (_reflowTimer->isActive() || _resumeTimer->isActive()) {
+		finishRecording();
+		_journal.end();
+		emit reflowFinished();
+	}
+	_autotuner->stop();
+
 	_reflowTimer->stop();
-	ui->actionStart_Reflow->setEnabled(true);
-	ui->actionStop_Reflow->setEnabled(false);
+	_resumeTimer->stop();
+	ui->actionStart_Reflow->setEnabled(idle);
+	ui->actionStop_Reflow->setEnabled(!idle);
+	ui->actionAutotune->setEnabled(idle);
+	ui->actionRun_Job_Queue->setEnabled(idle);
+	profileSelector->setEnabled(idle);
 	_ovenManager->setFilamentsEnabled(false);
 	disconnect(_ovenManager, &OvenManager::readingsRead, this, &ControlPanel::logReadings);
 
 	ui->statusBar->showMessage("Reflow stopped");
 }
 
+void ControlPanel::on_actionRun_Job_Queue_triggered()
+{
+	QString fileName = QFileDialog::getOpenFileName(this, "Run Job Queue", _profileLibrary->getDirectory(), "Job lists (*.txt);;All files (*)");
+	if (fileName.isEmpty())
+		return;
+
+	bool ok;
+	JobQueue jobs = JobQueue::load(fileName, &ok);
+	if (!ok) {
+		ui->statusBar->showMessage(QString("Could not load jobs from '%1'").arg(fileName));
+		return;
+	}
+
+	_jobs = jobs;
+	_jobs.start();
+	ui->actionStart_Reflow->setEnabled(false);
+	ui->actionStop_Reflow->setEnabled(true);
+	ui->actionAutotune->setEnabled(false);
+	ui->actionRun_Job_Queue->setEnabled(false);
+	profileSelector->setEnabled(false);
+	_jobTimer->start();
+	checkJobs();
+}
+
+void ControlPanel::on_actionAutotune_triggered()
+{
+	bool ok;
+	int setpoint = QInputDialog::getInt(this, "Autotune", "Tuning temperature (C):", 150, 50, 250, 1, &ok);
+	if (!ok)
+		return;
+
+	QStringList rules;
+	rules << "Ziegler-Nichols (fast)" << "Tyreus-Luyben (less overshoot)";
+	QString rule = QInputDialog::getItem(this, "Autotune", "Tuning rule:", rules, 1, false, &ok);
+	if (!ok)
+		return;
+
+	ui->actionStart_Reflow->setEnabled(false);
+	ui->actionStop_Reflow->setEnabled(true);
+	ui->actionAutotune->setEnabled(false);
+	ui->actionRun_Job_Queue->setEnabled(false);
+	profileSelector->setEnabled(false);
+
+	_autotuner->start(celsiusToTemperature(setpoint), rule == rules.first() ? Autotuner::ZieglerNichols : Autotuner::TyreusLuyben);
+}
+
+void ControlPanel::autotuneProgress(int cycle, int cycles)
+{
+	ui->statusBar->showMessage(QString("Autotuning: oscillation %1 of %2").arg(cycle).arg(cycles));
+}
+
+void ControlPanel::autotuneFinished(struct oven_gains gains)
+{
+	double scale = 1 << PCBOVEN_GAIN_SHIFT;
+
+	on_actionStop_Reflow_triggered();
+	ui->statusBar->showMessage("Autotune finished");
+	QMessageBox::information(this, "Autotune finished",
+	                         QString("Stored controller gains:\nP = %1\nI = %2\nD = %3")
+	                         .arg(gains.proportional / scale)
+	                         .arg(gains.integral / scale)
+	                         .arg(gains.derivative / scale));
+}
+
+void ControlPanel::autotuneFailed(QString reason)
+{
+	on_actionStop_Reflow_triggered();
+	ui->statusBar->showMessage("Autotune failed");
+	QMessageBox::warning(this, "Autotune failed", reason);
+}
+
 void ControlPanel::ovenConnected()
 {
+	if (_recoveryTimer->isActive()) {
+		recoverRun();
+		return;
+	}
+	if (_resumeTimer->isActive()) {
+		resumeReflow();
+		return;
+	}
+
 	ui->actionStart_Reflow->setEnabled(true);
 	ui->actionStop_Reflow->setEnabled(false);
+	ui->actionAutotune->setEnabled(true);
+	ui->actionRun_Job_Queue->setEnabled(true);
 	connectionStatus->setText("Connected");
+
+	// Now with the oven's own controller gains
+	checkFeasibility();
+}
+
+// The oven is only following a new target once it has echoed it back
+void ControlPanel::commandCompleted(unsigned long code, int latency_ms)
+{
+	if (code == PCBOVEN_SET_TEMPERATURE && _reflowTimer->isActive() && _nextTarget != _targets.constEnd())
+		ui->statusBar->showMessage(QString("Target temperature: %1C (applied after %2 ms)")
+		                           .arg(temperatureToCelsius(_nextTarget.value()))
+		                           .arg(latency_ms));
+}
+
+void ControlPanel::ovenTripped(int reason)
+{
+	QString message;
+
+	switch (reason) {
+	case PCBOVEN_TRIP_FAULT:
+		message = "The thermocouple reported a fault.";
+		break;
+	case PCBOVEN_TRIP_CEILING:
+		message = "The oven exceeded its temperature ceiling.";
+		break;
+	case PCBOVEN_TRIP_TIMEOUT:
+		message = "The driver stopped receiving commands from this application.";
+		break;
+	case PCBOVEN_TRIP_DEVICE:
+		message = "The oven controller's failsafe switched off: it stopped hearing from the host or the thermocouple kept faulting.";
+		break;
+	default:
+		message = QString("Unknown reason (%1).").arg(reason);
+		break;
+	}
+
+	ui->statusBar->showMessage("Filaments switched off by the driver: " + message);
+	if (ui->actionStop_Reflow->isEnabled()) {
+		on_actionStop_Reflow_triggered();
+		QMessageBox::critical(this, "Filaments switched off", message);
+	}
 }
 
+// A reflow survives the oven dropping off the bus for up to the resume
+// window; the profile clock keeps running meanwhile
 void ControlPanel::ovenDisconnected()
+{
+	if (_reflowTimer->isActive() && _resumeWindow > 0) {
+		_reflowTimer->stop();
+		_resumeTimer->start(_resumeWindow);
+		_gapStart = _reflowStartTime.msecsTo(QTime::currentTime()) / 1000.0f;
+		connectionStatus->setText("Disconnected");
+		ui->statusBar->showMessage(QString("Oven disconnected, resuming if it returns within %1 s").arg(_resumeWindow / 1000.0));
+		return;
+	}
+
+	abandonReflow();
+}
+
+void ControlPanel::resumeTimedOut()
+{
+	abandonReflow();
+	ui->statusBar->showMessage("Reflow stopped: the oven did not return");
+}
+
+void ControlPanel::abandonReflow()
 {
 	on_actionStop_Reflow_triggered();
 	ui->actionStart_Reflow->setEnabled(false);
 	ui->actionStop_Reflow->setEnabled(false);
+	ui->actionAutotune->setEnabled(false);
+	ui->actionRun_Job_Queue->setEnabled(false);
 	connectionStatus->setText("Disconnected");
 }
 
+// The oven came back from a dropout. Everything it was told has been
+// forgotten, so the filaments, balance and the target for the current point
+// of the profile are sent again.
+void ControlPanel::resumeReflow()
+{
+	_resumeTimer->stop();
+	float gapEnd = _reflowStartTime.msecsTo(QTime::currentTime()) / 1000.0f;
+	_recording.addGap(_gapStart, gapEnd);
+	_journal.gap(_gapStart, gapEnd);
+	connectionStatus->setText("Connected");
+
+	_ovenManager->setFilamentsEnabled(true);
+	_reflowTimer->start();
+	checkProfile();
+	if (!_reflowTimer->isActive())
+		return;
+
+	_ovenManager->setTargetTemperature(_nextTarget.value());
+	ui->statusBar->showMessage(QString("Oven reconnected, resumed at target temperature %1C").arg(temperatureToCelsius(_nextTarget.value())));
+}
+
+void ControlPanel::setResumeWindow(int ms)
+{
+	_resumeWindow = ms;
+}
+
+void ControlPanel::on_actionOverlay_Runs_triggered()
+{
+	QStringList fileNames = QFileDialog::getOpenFileNames(this, "Overlay Runs", RunRecording::defaultDirectory(), "Run recordings (*.csv)");
+
+	foreach (QString fileName, fileNames) {
+		bool ok;
+		RunRecording run = RunRecording::load(fileName, &ok);
+		if (!ok) {
+			ui->statusBar->showMessage(QString("Could not load '%1'").arg(fileName));
+			continue;
+		}
+		QString title = run.getTitle().isEmpty() ? QFileInfo(fileName).baseName() :
+		                                           QString("%1 (%2)").arg(run.getTitle(), QFileInfo(fileName).baseName());
+		ui->reflowGraph->addOverlay(title, run);
+	}
+}
+
+void ControlPanel::on_actionClear_Overlays_triggered()
+{
+	ui->reflowGraph->clearOverlays();
+}
+
+void ControlPanel::on_actionReset_Zoom_triggered()
+{
+	ui->reflowGraph->resetView();
+}
+
+bool ControlPanel::exportMetrics(quint16 port)
+{
+	if (!_metricsExporter) {
+		_metricsExporter = new MetricsExporter(_ovenManager, this);
+		connect(this, &ControlPanel::reflowStarted, _metricsExporter, &MetricsExporter::runStarted);
+		connect(this, &ControlPanel::reflowFinished, _metricsExporter, &MetricsExporter::runFinished);
+	}
+	return _metricsExporter->listen(port);
+}
+
 void ControlPanel::handleError(int error)
 {
 	ui->statusBar->showMessage(QString("An error occured (%1)").arg(error));
@@ -99,6 +442,18 @@ void ControlPanel::handleError(int error)
 	case EACCES:
 		QMessageBox::critical(this, "Failed to connect to driver", "Could not connect to the pcboven device. For now, run this as root. TODO ALEX");
 		break;
+	case ECONNREFUSED:
+		QMessageBox::critical(this, "Failed to connect to broker", "Could not connect to the oven broker. Make sure that pcboven-broker is running.");
+		break;
+	case ECONNRESET:
+		QMessageBox::critical(this, "Lost connection to broker", "The oven broker closed the connection.");
+		break;
+	case EBUSY:
+		QMessageBox::warning(this, "Oven in use", "Another client is controlling the oven. Readings will still be shown.");
+		break;
+	case ETIMEDOUT:
+		QMessageBox::warning(this, "Oven not responding", "The oven did not apply a command after several attempts.");
+		break;
 	default:
 		QMessageBox::critical(this, "Well fuck me", QString().setNum(error));
 		break;
@@ -107,24 +462,323 @@ void ControlPanel::handleError(int error)
 
 void ControlPanel::checkProfile()
 {
-	QTime adjustedTime = QTime(0, 0).addMSecs(_reflowStartTime.msecsTo(QTime::currentTime()));
+	int elapsed = _reflowStartTime.msecsTo(QTime::currentTime()) - _holdExtension;
+
+	// A hold only ends once the oven has settled within its tolerance; until
+	// then the profile clock is stretched at the end of the hold.
+	int segment = _profile.segmentAt(elapsed / 1000.0f);
+	if (_segment >= 0 && segment != _segment) {
+		ReflowProfile::Segment hold = _profile.getSegments().at(_segment);
+		if (hold.type == ReflowProfile::Hold &&
+		    qAbs(_estimatedTemperature - hold.coefficients[0]) > hold.tolerance) {
+			int holdEnd = qCeil(hold.end * 1000) - 1;
+			_holdExtension += elapsed - holdEnd;
+			elapsed = holdEnd;
+			segment = _segment;
+			ui->statusBar->showMessage(QString("Holding at %1C until stable").arg(hold.coefficients[0]));
+		}
+	}
+	_segment = segment;
+
+	// Each segment sets how the heating is split between top and bottom
+	QVector<ReflowProfile::Segment> segments = _profile.getSegments();
+	if (!segments.isEmpty()) {
+		float balance = segments.at(qMax(segment, 0)).balance;
+		_ovenManager->setBalance(qMin(qRound(balance * 2 * PCBOVEN_BALANCE_EVEN), 255));
+	}
+
+	QTime adjustedTime = QTime(0, 0).addMSecs(elapsed);
 	reflowStatus->setText(adjustedTime.toString());
 
 	if (adjustedTime >= _nextTarget.key()) {
-		if (_nextTarget != _profile.getProfile().constEnd())
+		// Targets passed while the oven was away are skipped
+		while (_nextTarget != _targets.constEnd() && adjustedTime >= _nextTarget.key())
 			_nextTarget++;
 
-		if (_nextTarget == _profile.getProfile().constEnd()) {
-			on_actionStop_Reflow_triggered();
+		if (_nextTarget == _targets.constEnd()) {
+			stopReflow();
+			if (_jobTimer->isActive())
+				completeJob();
 		} else {
 			_ovenManager->setTargetTemperature(_nextTarget.value());
-			ui->statusBar->showMessage(QString("Target temperature: %1C").arg(_nextTarget.value()));
+			_journal.step(_segment, _holdExtension, _nextTarget.value(), true);
+			ui->statusBar->showMessage(QString("Target temperature: %1C").arg(temperatureToCelsius(_nextTarget.value())));
 		}
 	}
 }
 
 void ControlPanel::logReadings(struct oven_state state, QTime timestamp)
 {
-	ui->reflowGraph->addTemperature(QTime(0, 0).addMSecs(_reflowStartTime.msecsTo(timestamp)), state.probe_temp);
+	QTime elapsed = QTime(0, 0).addMSecs(_reflowStartTime.msecsTo(timestamp));
+
+	float time = _reflowStartTime.msecsTo(timestamp) / 1000.0f;
+	float target = _nextTarget == _targets.constEnd() ? 0 : temperatureToCelsius(_nextTarget.value());
+
+	_recording.append(time, temperatureToCelsius(state.probe_temp), temperatureToCelsius(state.internal_temp), target,
+	                  state.top_duty / 255.0f, state.bottom_duty / 255.0f, _estimatedTemperature, _estimatedRate);
+	_journal.reading(time, temperatureToCelsius(state.probe_temp), temperatureToCelsius(state.internal_temp), target,
+	                 state.top_duty / 255.0f, state.bottom_duty / 255.0f, _estimatedTemperature, _estimatedRate);
+	ui->reflowGraph->addTemperature(elapsed, state.probe_temp);
+	ui->reflowGraph->addEstimate(elapsed, _estimatedTemperature);
+}
+
+// Estimates arrive just before the readings they were made from
+void ControlPanel::updateEstimate(double temperature, double rate, QTime timestamp)
+{
+	(void)timestamp;
+	_estimatedTemperature = temperature;
+	_estimatedRate = rate;
+	estimateStatus->setText(QString("%1C  %2C/s").arg(temperature, 0, 'f', 1).arg(rate, 0, 'f', 2));
+}
+
+void ControlPanel::applyThermalModel()
+{
+	StateEstimator *estimator = _ovenManager->getEstimator();
+
+	if (_thermalModel.isValid())
+		estimator->setModel(_thermalModel.getGain(), _thermalModel.getTimeConstant(), _thermalModel.getDeadTime(), _thermalModel.getAmbient());
+	else
+		estimator->clearModel();
+	_capability.setModel(_thermalModel);
+}
+
+// Predicts how the oven will manage the selected profile, so one it cannot
+// follow is caught before a board goes in rather than seen on the graph after
+void ControlPanel::checkFeasibility()
+{
+	struct oven_gains gains;
+
+	// Until the oven is there to ask, its firmware's default gains
+	if (!_ovenManager->getGains(&gains)) {
+		gains.proportional = ProfileFeasibility::DEFAULT_GAIN_P;
+		gains.integral = ProfileFeasibility::DEFAULT_GAIN_I;
+		gains.derivative = ProfileFeasibility::DEFAULT_GAIN_D;
+	}
+	_feasibility = ProfileFeasibility::check(_profile, _targets, gains, _capability);
+	ui->reflowGraph->setPrediction(_feasibility.getTimes(), _feasibility.getPredicted());
+	if (!_feasibility.isFeasible())
+		ui->statusBar->showMessage(QString("The oven is not expected to follow this profile: %1").arg(_feasibility.describe()));
+}
+
+
+void ControlPanel::refreshProfiles()
+{
+	QList<ProfileLibrary::Entry> entries = _profileLibrary->getEntries();
+
+	profileSelector->clear();
+	foreach (const ProfileLibrary::Entry &entry, entries) {
+		if (!entry.error.isEmpty()) {
+			profileSelector->addItem(QString("%1 (invalid)").arg(entry.title), entry.fileName);
+			profileSelector->setItemData(profileSelector->count() - 1, entry.error, Qt::ToolTipRole);
+			continue;
+		}
+		profileSelector->addItem(QString("%1 (%2s, %3C)").arg(entry.title)
+		                                                .arg(entry.duration)
+		                                                .arg(temperatureToCelsius(entry.peakTemperature)),
+		                         entry.fileName);
+	}
+	profileSelector->setCurrentIndex(profileSelector->findData(_profileName));
+}
+
+void ControlPanel::selectProfile(int index)
+{
+	QString fileName = profileSelector->itemData(index).toString();
+	ReflowProfile profile;
+	QString error;
+
+	if (!_profileLibrary->getProfile(fileName, &profile, &error)) {
+		ui->statusBar->showMessage(QString("Could not open '%1': %2").arg(fileName, error));
+		profileSelector->setCurrentIndex(profileSelector->findData(_profileName));
+		return;
+	}
+
+	_profileName = fileName;
+	_profile = profile;
+	_targets = _thermalModel.shape(_profile, REFLOW_STEP_PERIOD_MS);
+	profileSelector->setCurrentIndex(index);
+	ui->reflowGraph->setProfile(_profile);
+	setWindowTitle(_profile.getTitle());
+	checkFeasibility();
+}
+
+void ControlPanel::reloadProfile(QString fileName)
+{
+	// Never swap the profile out from under a running reflow
+	if (fileName != _profileName || _reflowTimer->isActive() || _resumeTimer->isActive())
+		return;
+
+	int index = profileSelector->findData(fileName);
+	if (index >= 0)
+		selectProfile(index);
+}
+
+void ControlPanel::finishRecording()
+{
+	saveRecording();
+
+	// Refit the oven model after every run so the next one is shaped with it
+	ThermalModel model = ThermalModel::fit(_recording);
+	if (model.isValid()) {
+		_thermalModel = model;
+		_thermalModel.save();
+		applyThermalModel();
+		_targets = _thermalModel.shape(_profile, REFLOW_STEP_PERIOD_MS);
+	}
+
+	_capability.learn(_recording);
+	_capability.save();
+	checkFeasibility();
+}
+
+void ControlPanel::saveRecording()
+{
+	QString fileName = _runId + ".csv";
+	if (!_recording.save(QDir(RunRecording::defaultDirectory()).filePath(fileName)))
+		std::cerr << "Could not save run recording" << std::endl;
+}
+
+// Takes over the run the journal says was interrupted, as long as it is the
+// same profile, unchanged, and the run would not have ended by now. The
+// profile clock is taken from the monotonic start reference, so the time
+// the application was away counts, and that stretch is marked as a gap.
+void ControlPanel::recoverRun()
+{
+	RunJournal::Run run = _interruptedRun;
+	qint64 elapsed = RunJournal::now() - run.started;
+	int index = profileSelector->findData(run.profile);
+
+	_recoveryTimer->stop();
+	if ((run.directory != _profileLibrary->getDirectory() && !BuiltinProfiles::find(run.profile)) || index < 0 ||
+	    _profileLibrary->getEntry(run.profile).checksum != run.checksum) {
+		_ovenManager->switchOff();
+		abandonRecovery("The profile it was running is no longer available or has changed, so the oven has been switched off.");
+		return;
+	}
+
+	selectProfile(index);
+	if (_targets.isEmpty() || elapsed < 0 ||
+	    QTime(0, 0).addMSecs(elapsed - run.holdExtension) >= _targets.lastKey()) {
+		_ovenManager->switchOff();
+		abandonRecovery("It would have finished by now, so the oven has been switched off.");
+		return;
+	}
+
+	_runId = run.id;
+	_recording = run.recording;
+	_recording.setTitle(_profile.getTitle());
+	_reflowStartTime = QTime::currentTime().addMSecs(-elapsed);
+	_segment = run.segment;
+	_holdExtension = run.holdExtension;
+
+	QVector<float> times = _recording.getTimes();
+	QVector<float> probe = _recording.getProbe();
+	QVector<float> filtered = _recording.getFiltered();
+	ui->reflowGraph->clearGraph();
+	for (int i = 0; i < times.size(); i++) {
+		QTime time = QTime(0, 0).addMSecs(times[i] * 1000);
+		ui->reflowGraph->addTemperature(time, celsiusToTemperature(probe[i]));
+		ui->reflowGraph->addEstimate(time, filtered[i]);
+	}
+	_recording.addGap(times.isEmpty() ? 0 : times.last(), elapsed / 1000.0f);
+
+	// Carry on in the same journal
+	_journal.resume();
+	_journal.gap(times.isEmpty() ? 0 : times.last(), elapsed / 1000.0f);
+	startReflow();
+	ui->statusBar->showMessage(QString("Recovered an interrupted reflow at %1").arg(QTime(0, 0).addMSecs(elapsed).toString()));
 }
 
+// Keeps what was recorded of the run and forgets about it
+void ControlPanel::abandonRecovery(QString reason)
+{
+	_recoveryTimer->stop();
+
+	_runId = _interruptedRun.id;
+	_recording = _interruptedRun.recording;
+	saveRecording();
+	_journal.end();
+
+	ui->statusBar->showMessage("Interrupted reflow stopped");
+	QMessageBox::warning(this, "Interrupted reflow stopped",
+	                     "A reflow was interrupted when the application last stopped and could not be resumed. " + reason);
+}
+
+void ControlPanel::recoveryTimedOut()
+{
+	abandonRecovery("The oven did not connect; its failsafe will have switched it off.");
+}
+
+// Starts the next job as soon as the oven has cooled onto the opening climb
+// of its profile, joining the climb at the oven's temperature
+void ControlPanel::checkJobs()
+{
+	if (_reflowTimer->isActive() || _resumeTimer->isActive() || _recoveryTimer->isActive())
+		return;
+
+	JobQueue::Job job = _jobs.getNext();
+	if (job.profile != _profileName) {
+		int index = profileSelector->findData(job.profile);
+		if (index >= 0)
+			selectProfile(index);
+		if (index < 0 || job.profile != _profileName || _targets.isEmpty()) {
+			on_actionStop_Reflow_triggered();
+			QMessageBox::warning(this, "Job queue stopped", QString("Could not open the profile '%1' for board %2.").arg(job.profile, job.board));
+			return;
+		}
+	}
+
+	// Nobody is there to decide whether to risk a board on a profile the
+	// oven is not expected to follow
+	if (!_feasibility.isFeasible()) {
+		on_actionStop_Reflow_triggered();
+		QMessageBox::warning(this, "Job queue stopped", QString("The oven is not expected to follow the profile '%1' for board %2: %3.")
+		                     .arg(job.profile, job.board, _feasibility.describe()));
+		return;
+	}
+
+	// Between boards the cooler runs flat out; during a run the firmware
+	// only cools when the oven falls behind the profile
+	float entry = _profile.entryTime(_estimatedTemperature);
+	if (entry < 0) {
+		_ovenManager->setCooling(JOB_COOLING_DUTY);
+		ui->statusBar->showMessage(QString("Board %1 is next, waiting for the oven to cool (%2C)")
+		                           .arg(job.board)
+		                           .arg(_estimatedTemperature, 0, 'f', 1));
+		return;
+	}
+
+	_ovenManager->setCooling(PCBOVEN_COOLING_AUTOMATIC);
+	beginRun(qRound(entry * 1000), job.board);
+	ui->statusBar->showMessage(QString("Board %1 (%2 of %3) started %4 s into the profile")
+	                           .arg(job.board)
+	                           .arg(_jobs.getCompleted() + 1)
+	                           .arg(_jobs.size())
+	                           .arg(entry, 0, 'f', 1));
+}
+
+void ControlPanel::completeJob()
+{
+	JobQueue::Job job = _jobs.getNext();
+
+	_jobs.complete();
+	if (!_jobs.isEmpty()) {
+		ui->statusBar->showMessage(QString("Board %1 done, %2 of %3 (%4 boards/h)")
+		                           .arg(job.board)
+		                           .arg(_jobs.getCompleted())
+		                           .arg(_jobs.size())
+		                           .arg(_jobs.getBoardsPerHour(), 0, 'f', 1));
+		return;
+	}
+
+	double boardsPerHour = _jobs.getBoardsPerHour();
+	_jobTimer->stop();
+	_ovenManager->setCooling(PCBOVEN_COOLING_AUTOMATIC);
+	ui->actionStart_Reflow->setEnabled(true);
+	ui->actionStop_Reflow->setEnabled(false);
+	ui->actionAutotune->setEnabled(true);
+	ui->actionRun_Job_Queue->setEnabled(true);
+	profileSelector->setEnabled(true);
+	ui->statusBar->showMessage(QString("Job queue finished (%1 boards/h)").arg(boardsPerHour, 0, 'f', 1));
+	QMessageBox::information(this, "Job queue finished",
+	                         QString("%1 boards reflowed at %2 boards per hour.").arg(_jobs.size()).arg(boardsPerHour, 0, 'f', 1));
+}
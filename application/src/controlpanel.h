@@ -2,11 +2,21 @@
 #define CONTROLPANEL_H
 
 #include <QMainWindow>
+#include <QComboBox>
 #include <QLabel>
 #include <QTime>
 #include <QTimer>
+#include "autotuner.h"
+#include "jobqueue.h"
+#include "metricsexporter.h"
+#include "ovencapability.h"
 #include "ovenmanager.h"
+#include "profilefeasibility.h"
+#include "profilelibrary.h"
 #include "reflowprofile.h"
+#include "runjournal.h"
+#include "runrecording.h"
+#include "thermalmodel.h"
 
 namespace Ui {
 	class ControlPanel;
@@ -17,30 +27,95 @@ class ControlPanel : public QMainWindow
 	Q_OBJECT
 
 	public:
-		explicit ControlPanel(QWidget *parent = 0);
+		explicit ControlPanel(QString profilePath, QString brokerName = QString(),
+		                      QString transport = OvenTransport::DEFAULT_TRANSPORT, QWidget *parent = 0);
 		~ControlPanel();
 
 		static const int REFLOW_CHECK_PERIOD_MS = 500;
 		static const int REFLOW_STEP_PERIOD_MS = 1000;
+		static const int RESUME_WINDOW_MS = 10000;
+		static const int RECOVERY_TIMEOUT_MS = 5000;
+		static const int JOB_COOLING_DUTY = 255;
+
+		bool exportMetrics(quint16 port);
+		void setResumeWindow(int ms);
+
+	signals:
+		void reflowStarted();
+		void reflowFinished();
 
 	private:
+		void beginRun(int offset, QString board);
+		void startReflow();
+		void stopReflow();
+		void completeJob();
+		void finishRecording();
+		void saveRecording();
+		void applyThermalModel();
+		void checkFeasibility();
+		void recoverRun();
+		void abandonRecovery(QString reason);
+		void resumeReflow();
+		void abandonReflow();
+
 		Ui::ControlPanel *ui;
 		QLabel *connectionStatus;
 		QLabel *reflowStatus;
+		QComboBox *profileSelector;
 		OvenManager *_ovenManager;
+		Autotuner *_autotuner;
+		MetricsExporter *_metricsExporter;
+		ProfileLibrary *_profileLibrary;
+		QString _profileName;
 		ReflowProfile _profile;
+		ThermalModel _thermalModel;
+		OvenCapability _capability;
+		ProfileFeasibility _feasibility;
+		RunRecording _recording;
+		RunJournal _journal;
+		RunJournal::Run _interruptedRun;
+		QTimer *_recoveryTimer;
+		QString _runId;
+		JobQueue _jobs;
+		QTimer *_jobTimer;
 		QTime _reflowStartTime;
 		QTimer *_reflowTimer;
-		QMap<QTime, int>::const_iterator _nextTarget;
+		QTimer *_resumeTimer;
+		int _resumeWindow;
+		float _gapStart;
+		QMap<QTime, Temperature> _targets;
+		QMap<QTime, Temperature>::const_iterator _nextTarget;
+		int _segment;
+		int _holdExtension;
+		double _estimatedTemperature;
+		double _estimatedRate;
+		QLabel *estimateStatus;
 
 	private slots:
 		void on_actionStart_Reflow_triggered();
 		void on_actionStop_Reflow_triggered();
+		void on_actionRun_Job_Queue_triggered();
+		void on_actionAutotune_triggered();
+		void on_actionOverlay_Runs_triggered();
+		void on_actionClear_Overlays_triggered();
+		void on_actionReset_Zoom_triggered();
+		void autotuneProgress(int cycle, int cycles);
+		void autotuneFinished(struct oven_gains gains);
+		void autotuneFailed(QString reason);
 		void ovenConnected();
 		void ovenDisconnected();
+		void resumeTimedOut();
+		void recoveryTimedOut();
+		void checkJobs();
+		void ovenTripped(int reason);
+		void commandCompleted(unsigned long code, int latency_ms);
 		void logReadings(struct oven_state state, QTime timestamp);
+		void updateEstimate(double temperature, double rate, QTime timestamp);
 		void handleError(int error);
 		void checkProfile();
+		void refreshProfiles();
+		void selectProfile(int index);
+		void reloadProfile(QString fileName);
 };
 
 #endif // CONTROLPANEL_H
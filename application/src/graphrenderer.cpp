@@ -0,0 +1,136 @@
+#include <QPainterPath>
+#include <QtCore/qmath.h>
+#include <math.h>
+#include "graphrenderer.h"
+
+static const QColor overlay_colors[] = {
+	QColor(0, 140, 0, 160),
+	QColor(200, 120, 0, 160),
+	QColor(140, 0, 160, 160),
+	QColor(0, 140, 160, 160),
+	QColor(120, 120, 120, 160)
+};
+
+static QPainterPath trace_path(const QVector<QPointF> &samples, const QTransform &transform)
+{
+	QPainterPath path;
+
+	if (samples.isEmpty())
+		return path;
+	path.moveTo(transform.map(samples.first()));
+	for (int i = 1; i < samples.size(); i++)
+		path.lineTo(transform.map(samples[i]));
+	return path;
+}
+
+GraphRenderer::GraphRenderer(QObject *parent) : QObject(parent)
+{
+}
+
+void GraphRenderer::render(GraphRenderer::Frame frame)
+{
+	QImage image(frame.size, QImage::Format_ARGB32_Premultiplied);
+
+	if (!image.isNull()) {
+		image.fill(Qt::transparent);
+		QPainter painter(&image);
+		draw(&painter, frame);
+	}
+	emit rendered(image, frame.generation);
+}
+
+// A 1, 2 or 5 times a power of ten step giving about the requested number of lines
+double GraphRenderer::gridStep(double span, int lines)
+{
+	double raw = span / lines;
+	double magnitude = qPow(10, qFloor(log10(raw)));
+	double normalized = raw / magnitude;
+
+	if (normalized < 1.5)
+		return magnitude;
+	if (normalized < 3.5)
+		return 2 * magnitude;
+	if (normalized < 7.5)
+		return 5 * magnitude;
+	return 10 * magnitude;
+}
+
+void GraphRenderer::draw(QPainter *painter, Frame frame)
+{
+	const QRect &contents = frame.contents;
+	double timeSpan = frame.viewEnd - frame.viewStart;
+	double temperatureSpan = frame.viewHigh - frame.viewLow;
+
+	painter->setRenderHint(QPainter::Antialiasing);
+	painter->setBackground(QBrush(Qt::white));
+	painter->setBackgroundMode(Qt::OpaqueMode);
+	painter->fillRect(contents, painter->background());
+	if (contents.width() < 2 || contents.height() < 2 || timeSpan <= 0 || temperatureSpan <= 0)
+		return;
+
+	// Maps (seconds, degrees) onto the contents rectangle
+	QTransform transform;
+	transform.translate(contents.left(), contents.bottom());
+	transform.scale(contents.width() / timeSpan, -contents.height() / temperatureSpan);
+	transform.translate(-frame.viewStart, -frame.viewLow);
+
+	// Draw grid, its density following the zoom
+	QFont font = painter->font();
+	if (font.pointSizeF() > 0)
+		font.setPointSizeF(font.pointSizeF() * 0.8);
+	painter->setFont(font);
+	painter->setBackgroundMode(Qt::TransparentMode);
+	QVector<QLineF> gridLines;
+	double step = gridStep(timeSpan, GRID_LINES);
+	for (double t = qCeil(frame.viewStart / step) * step; t <= frame.viewEnd; t += step) {
+		double x = transform.map(QPointF(t, 0)).x();
+		gridLines.append(QLineF(x, contents.top(), x, contents.bottom()));
+		painter->setPen(QColor(150, 150, 150));
+		painter->drawText(QPointF(x + 2, contents.bottom() - 2), QString("%1s").arg(t, 0, 'g', 6));
+	}
+	step = gridStep(temperatureSpan, GRID_LINES);
+	for (double v = qCeil(frame.viewLow / step) * step; v <= frame.viewHigh; v += step) {
+		double y = transform.map(QPointF(0, v)).y();
+		gridLines.append(QLineF(contents.left(), y, contents.right(), y));
+		painter->setPen(QColor(150, 150, 150));
+		painter->drawText(QPointF(contents.left() + 2, y - 2), QString("%1C").arg(v, 0, 'g', 6));
+	}
+	painter->setPen(QPen(QBrush(QColor(200, 200, 200)), 1));
+	painter->drawLines(gridLines);
+
+	painter->setClipRect(contents);
+	double resolution = timeSpan / contents.width();
+
+	// Draw target temp, evaluating the profile once per pixel column
+	if (!frame.profile.getSegments().isEmpty()) {
+		int columns = contents.width() + 1;
+		QVector<QPointF> points(columns);
+		QVector<float> times(columns);
+		QVector<float> targets(columns);
+		for (int i = 0; i < columns; i++)
+			times[i] = frame.viewStart + resolution * i;
+		frame.profile.evaluate(times.constData(), targets.data(), columns);
+		for (int i = 0; i < columns; i++)
+			points[i] = QPointF(times[i], targets[i]);
+
+		painter->setPen(QPen(QBrush(QColor(150, 150, 255)), 2));
+		painter->drawPath(trace_path(points, transform));
+	}
+
+	// Draw the curve the oven is predicted to manage on the profile
+	painter->setPen(QPen(QBrush(QColor(150, 150, 255)), 1, Qt::DashLine));
+	painter->drawPath(trace_path(frame.prediction.query(frame.viewStart, frame.viewEnd, resolution), transform));
+
+	// Draw previous runs, then the actual temp on top of them
+	for (int i = 0; i < frame.overlays.size(); i++) {
+		QColor color = overlay_colors[i % (sizeof(overlay_colors) / sizeof(overlay_colors[0]))];
+		painter->setPen(QPen(QBrush(color), 1.5));
+		painter->drawPath(trace_path(frame.overlays[i].query(frame.viewStart, frame.viewEnd, resolution), transform));
+		painter->drawText(QPointF(contents.right() - 150, contents.top() + 14 * (i + 1)), frame.overlayTitles.value(i));
+	}
+
+	painter->setPen(QPen(QBrush(QColor(200, 0, 0)), 2));
+	painter->drawPath(trace_path(frame.temperatures.query(frame.viewStart, frame.viewEnd, resolution), transform));
+	painter->setPen(QPen(QBrush(QColor(90, 0, 0)), 1));
+	painter->drawPath(trace_path(frame.estimates.query(frame.viewStart, frame.viewEnd, resolution), transform));
+}
@@ -0,0 +1,54 @@
+#ifndef GRAPHRENDERER_H
+#define GRAPHRENDERER_H
+
+#include <QImage>
+#include <QMetaType>
+#include <QObject>
+#include <QPainter>
+#include <QRect>
+#include <QStringList>
+#include <QVector>
+#include "reflowprofile.h"
+#include "sampleindex.h"
+
+// Rasterizes the reflow graph. A frame carries its own copies of the sample
+// buffers (implicitly shared, so taking one is cheap), which lets it be drawn
+// on a worker thread while the widget keeps collecting samples.
+class GraphRenderer : public QObject
+{
+	Q_OBJECT
+
+	public:
+		struct Frame {
+			QSize size;
+			QRect contents;
+			ReflowProfile profile;
+			SampleIndex prediction;
+			SampleIndex temperatures;
+			SampleIndex estimates;
+			QVector<SampleIndex> overlays;
+			QStringList overlayTitles;
+			double viewStart;
+			double viewEnd;
+			double viewLow;
+			double viewHigh;
+			quint64 generation;
+		};
+
+		static const int GRID_LINES = 10;
+
+		explicit GraphRenderer(QObject *parent = 0);
+
+		static void draw(QPainter *painter, Frame frame);
+		static double gridStep(double span, int lines);
+
+	signals:
+		void rendered(QImage image, quint64 generation);
+
+	public slots:
+		void render(GraphRenderer::Frame frame);
+};
+
+Q_DECLARE_METATYPE(GraphRenderer::Frame)
+
+#endif // GRAPHRENDERER_H
@@ -0,0 +1,88 @@
+#include <QFile>
+#include <QRegExp>
+#include <QStringList>
+#include "jobqueue.h"
+
+#define MS_PER_HOUR (60.0 * 60 * 1000)
+
+// Blank lines and lines starting with # are skipped; a board ID may contain
+// spaces, a profile file name may not
+JobQueue JobQueue::load(QString fileName, bool *ok)
+{
+	JobQueue queue;
+	QFile file(fileName);
+
+	if (ok)
+		*ok = false;
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		return queue;
+
+	while (!file.atEnd()) {
+		QString line = QString::fromUtf8(file.readLine()).trimmed();
+		if (line.isEmpty() || line.startsWith('#'))
+			continue;
+
+		QStringList fields = line.split(QRegExp("\\s+"));
+		Job job;
+		job.profile = fields.takeFirst();
+		job.board = fields.join(' ');
+		queue._jobs.append(job);
+	}
+
+	if (ok)
+		*ok = !queue._jobs.isEmpty();
+	return queue;
+}
+
+JobQueue::JobQueue()
+{
+	_next = 0;
+}
+
+// True once every job has been run
+bool JobQueue::isEmpty()
+{
+	return _next >= _jobs.size();
+}
+
+int JobQueue::size()
+{
+	return _jobs.size();
+}
+
+int JobQueue::getCompleted()
+{
+	return _next;
+}
+
+JobQueue::Job JobQueue::getNext()
+{
+	return _jobs.at(_next);
+}
+
+void JobQueue::start()
+{
+	_next = 0;
+	_started.start();
+}
+
+void JobQueue::complete()
+{
+	if (_next < _jobs.size())
+		_next++;
+}
+
+void JobQueue::clear()
+{
+	_jobs.clear();
+	_next = 0;
+	_started.invalidate();
+}
+
+// Over the whole queue so far, so the cooldowns between runs count
+double JobQueue::getBoardsPerHour()
+{
+	if (!_started.isValid() || _started.elapsed() <= 0)
+		return 0;
+	return _next * MS_PER_HOUR / _started.elapsed();
+}
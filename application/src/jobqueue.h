@@ -0,0 +1,37 @@
+#ifndef JOBQUEUE_H
+#define JOBQUEUE_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QString>
+
+// An ordered list of boards to reflow, each with the profile to use, read
+// from a text file with one "profile board-id" job per line. Keeps count of
+// the boards done for the throughput.
+class JobQueue
+{
+	public:
+		struct Job {
+			QString profile;
+			QString board;
+		};
+
+		static JobQueue load(QString fileName, bool *ok = 0);
+
+		JobQueue();
+		bool isEmpty();
+		int size();
+		int getCompleted();
+		Job getNext();
+		void start();
+		void complete();
+		void clear();
+		double getBoardsPerHour();
+
+	private:
+		QList<Job> _jobs;
+		int _next;
+		QElapsedTimer _started;
+};
+
+#endif // JOBQUEUE_H
@@ -0,0 +1,165 @@
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "kerneltransport.h"
+
+// The write end of the receiver's pipe, or -1
+static volatile sig_atomic_t _sigio_pipe = -1;
+
+KernelTransport::KernelTransport(QObject *parent) : OvenTransport(parent)
+{
+	_ioctlFd = -1;
+	_sigioPipe[0] = _sigioPipe[1] = -1;
+	_sigioNotifier = NULL;
+	_connected = false;
+}
+
+KernelTransport::~KernelTransport()
+{
+	close();
+}
+
+bool KernelTransport::open()
+{
+	_ioctlFd = ::open("/dev/pcboven", O_RDWR, O_NONBLOCK);
+	if (_ioctlFd < 0)
+		return false;
+
+	if (pipe2(_sigioPipe, O_NONBLOCK | O_CLOEXEC))
+		return false;
+	_sigioNotifier = new QSocketNotifier(_sigioPipe[0], QSocketNotifier::Read, this);
+	// activated() is overloaded from Qt 5.15, so it is connected by name
+	connect(_sigioNotifier, SIGNAL(activated(int)), this, SLOT(sigioReceived()));
+	register_sigio_receiver(this);
+
+	if (fcntl(_ioctlFd, F_SETOWN, getpid()))
+		return false;
+
+	if (fcntl(_ioctlFd, F_SETFL, (fcntl(_ioctlFd, F_GETFL) | FASYNC)))
+		return false;
+
+	int ret = ioctl(_ioctlFd, PCBOVEN_IS_CONNECTED);
+	if (ret < 0) {
+		emit errorOccurred(ret);
+	} else if (ret) {
+		_connected = true;
+		emit connected();
+	}
+	return true;
+}
+
+void KernelTransport::close()
+{
+	if (_ioctlFd >= 0) {
+		register_sigio_receiver(NULL);
+		::close(_ioctlFd);
+		_ioctlFd = -1;
+		_connected = false;
+	}
+	if (_sigioPipe[0] >= 0) {
+		delete _sigioNotifier;
+		_sigioNotifier = NULL;
+		::close(_sigioPipe[0]);
+		::close(_sigioPipe[1]);
+		_sigioPipe[0] = _sigioPipe[1] = -1;
+	}
+}
+
+int KernelTransport::execute(unsigned long code, QByteArray data, bool byReference)
+{
+	int value;
+	int ret;
+
+	if (byReference) {
+		ret = ioctl(_ioctlFd, code, data.data());
+	} else {
+		memcpy(&value, data.constData(), sizeof(value));
+		ret = ioctl(_ioctlFd, code, value);
+	}
+	return ret < 0 ? errno : 0;
+}
+
+bool KernelTransport::getGains(struct oven_gains *gains)
+{
+	return ioctl(_ioctlFd, PCBOVEN_GET_GAINS, gains) == 0;
+}
+
+// Signals that arrived together are handled as one: the state is the latest
+// and the sample queue is drained whole
+void KernelTransport::sigioReceived()
+{
+	QTime timestamp = QTime::currentTime();
+	struct oven_state state;
+	struct oven_samples samples;
+	char drain[64];
+	int ret;
+
+	while (read(_sigioPipe[0], drain, sizeof(drain)) > 0)
+		;
+
+	if (_connected) {
+		ret = ioctl(_ioctlFd, PCBOVEN_GET_STATE, &state);
+		if (ret == 0) {
+			if (ioctl(_ioctlFd, PCBOVEN_GET_SAMPLES, &samples) == 0 && samples.count) {
+				QVector<oven_sample> received(samples.count);
+				memcpy(received.data(), samples.samples, samples.count * sizeof(struct oven_sample));
+				emit samplesReceived(received);
+			}
+			emit stateReceived(state, timestamp);
+		} else if (ret == -1) {
+			if (errno == ENODEV) {
+				_connected = false;
+				emit disconnected();
+			} else {
+				emit errorOccurred(errno);
+			}
+		} else {
+			emit errorOccurred(ret);
+		}
+	} else {
+		ret = ioctl(_ioctlFd, PCBOVEN_IS_CONNECTED, &state);
+		if (ret < 0) {
+			emit errorOccurred(ret);
+		} else if (ret) {
+			_connected = true;
+			emit connected();
+		}
+	}
+}
+
+// Runs on whichever thread the signal lands on, so it may only do
+// async-signal-safe work
+void KernelTransport::top_sigio_handler(int sig)
+{
+	int saved = errno;
+	int fd = _sigio_pipe;
+	char byte = 0;
+	(void)sig;
+
+	// A write that fails on a full pipe is fine, as a wakeup is queued already
+	if (fd >= 0) {
+		ssize_t written = write(fd, &byte, 1);
+		(void)written;
+	}
+	errno = saved;
+}
+
+void KernelTransport::register_sigio_receiver(KernelTransport *receiver)
+{
+	struct sigaction action;
+
+	memset(&action, 0, sizeof(action));
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	if (receiver) {
+		_sigio_pipe = receiver->_sigioPipe[1];
+		action.sa_handler = &KernelTransport::top_sigio_handler;
+	} else {
+		action.sa_handler = SIG_IGN;
+	}
+	sigaction(SIGIO, &action, NULL);
+	if (!receiver)
+		_sigio_pipe = -1;
+}
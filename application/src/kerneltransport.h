@@ -0,0 +1,39 @@
+#ifndef KERNELTRANSPORT_H
+#define KERNELTRANSPORT_H
+
+#include <QSocketNotifier>
+#include <signal.h>
+#include "oventransport.h"
+
+// The pcboven kernel module: ioctls on /dev/pcboven, with the driver
+// raising SIGIO for every reading and connection change. The signal handler
+// only writes to a pipe; the ioctls and signals are handled on the
+// transport's thread once the pipe is readable.
+class KernelTransport : public OvenTransport
+{
+	Q_OBJECT
+
+	public:
+		explicit KernelTransport(QObject *parent = 0);
+		virtual ~KernelTransport();
+
+		virtual bool open();
+		virtual void close();
+		virtual int execute(unsigned long code, QByteArray data, bool byReference);
+		virtual bool getGains(struct oven_gains *gains);
+
+	protected:
+		static void register_sigio_receiver(KernelTransport *receiver);
+		static void top_sigio_handler(int signal);
+
+	private slots:
+		void sigioReceived();
+
+	private:
+		int _ioctlFd;
+		int _sigioPipe[2];
+		QSocketNotifier *_sigioNotifier;
+		bool _connected;
+};
+
+#endif // KERNELTRANSPORT_H
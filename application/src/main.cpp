@@ -1,21 +1,50 @@
 #include <QApplication>
+#include <QCommandLineParser>
 #include <iostream>
+#include "brokerprotocol.h"
 #include "controlpanel.h"
+#include "oventransport.h"
 
 int main(int argc, char *argv[])
 {
 	QApplication a(argc, argv);
+	a.setOrganizationName("PCBoven");
+	a.setApplicationName("control");
 
-	if (qApp->arguments().count() != 2) {
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	QCommandLineOption brokerOption("broker", "Share the oven through a running pcboven-broker.");
+	QCommandLineOption socketOption("socket", "Name of the broker socket.", "name", BrokerProtocol::DEFAULT_SOCKET);
+	QCommandLineOption metricsOption("metrics-port", "Serve OpenMetrics telemetry on localhost.", "port");
+	QCommandLineOption transportOption("transport", "How to reach the oven: " + OvenTransport::names().join(", ") + ".",
+	                                   "name", OvenTransport::DEFAULT_TRANSPORT);
+	parser.addOption(brokerOption);
+	parser.addOption(socketOption);
+	parser.addOption(metricsOption);
+	QCommandLineOption resumeOption("resume-window", "Seconds to wait for a disconnected oven to resume a reflow (0 stops at once).",
+	                                "seconds", QString::number(ControlPanel::RESUME_WINDOW_MS / 1000));
+	parser.addOption(transportOption);
+	parser.addOption(resumeOption);
+	parser.addPositionalArgument("profile", "Reflow profile or directory of profiles; the built-in profiles are always offered.", "[reflow-profile|profile-directory]");
+	parser.process(a);
+
+	if (parser.positionalArguments().count() > 1) {
 		std::cerr << "Usage: "
 		          << qApp->arguments().first().toUtf8().data()
-		          << " reflow-profile"
+		          << " [--broker [--socket name] | --transport name] [reflow-profile|profile-directory]"
 		          << std::endl;
 		return -1;
 	}
 
-	ControlPanel w;
+	ControlPanel w(parser.positionalArguments().value(0),
+	               parser.isSet(brokerOption) || parser.isSet(socketOption) ? parser.value(socketOption) : QString(),
+	               parser.value(transportOption));
+	if (parser.isSet(metricsOption) && !w.exportMetrics(parser.value(metricsOption).toUShort())) {
+		std::cerr << "Could not serve metrics on port "
+		          << parser.value(metricsOption).toUtf8().data()
+		          << std::endl;
+	}
+	w.setResumeWindow(parser.value(resumeOption).toDouble() * 1000);
 	w.show();
 	return a.exec();
 }
-
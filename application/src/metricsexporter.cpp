@@ -0,0 +1,287 @@
+#include <QDateTime>
+#include <QHostAddress>
+#include <QTcpSocket>
+#include "metricsexporter.h"
+
+// Upper bounds in seconds; the last bucket is +Inf
+static const double interval_bounds[MetricsExporter::HISTOGRAM_BUCKETS] = { 0.25, 0.5, 0.9, 1.1, 1.5, 2, 5 };
+static const double latency_bounds[MetricsExporter::HISTOGRAM_BUCKETS] = { 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1 };
+static const double command_bounds[MetricsExporter::HISTOGRAM_BUCKETS] = { 0.01, 0.1, 0.5, 1, 2, 5, 10 };
+
+static void render_metric(QByteArray *out, const char *name, const char *type, const char *help)
+{
+	out->append("# TYPE ").append(name).append(' ').append(type).append('\n');
+	out->append("# HELP ").append(name).append(' ').append(help).append('\n');
+}
+
+static void render_sample(QByteArray *out, const char *name, const char *labels, double value)
+{
+	out->append(name);
+	if (labels)
+		out->append('{').append(labels).append('}');
+	out->append(' ').append(QByteArray::number(value, 'g', 15)).append('\n');
+}
+
+MetricsExporter::MetricsExporter(OvenManager *ovenManager, QObject *parent) : QObject(parent)
+{
+	_ovenManager = ovenManager;
+	connect(_ovenManager, &OvenManager::connected, this, &MetricsExporter::ovenConnected);
+	connect(_ovenManager, &OvenManager::disconnected, this, &MetricsExporter::ovenDisconnected);
+	connect(_ovenManager, &OvenManager::readingsRead, this, &MetricsExporter::processReadings);
+	connect(_ovenManager, &OvenManager::samplesRead, this, &MetricsExporter::countSamples);
+	connect(_ovenManager, &OvenManager::errorOccurred, this, &MetricsExporter::countError);
+	connect(_ovenManager, &OvenManager::commandCompleted, this, &MetricsExporter::commandCompleted);
+	connect(_ovenManager, &OvenManager::commandFailed, this, &MetricsExporter::commandFailed);
+
+	_server = new MetricsServer(this);
+	_server->moveToThread(&_thread);
+	connect(&_thread, &QThread::finished, _server, &QObject::deleteLater);
+	_thread.start();
+}
+
+MetricsExporter::~MetricsExporter()
+{
+	_thread.quit();
+	_thread.wait();
+}
+
+bool MetricsExporter::listen(quint16 port)
+{
+	bool ok = false;
+	QMetaObject::invokeMethod(_server, "listen", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, ok), Q_ARG(quint16, port));
+	return ok;
+}
+
+void MetricsExporter::runStarted()
+{
+	_runs.fetchAndAddRelaxed(1);
+	_runStart.storeRelease(QDateTime::currentMSecsSinceEpoch());
+}
+
+void MetricsExporter::runFinished()
+{
+	_runStart.storeRelease(0);
+}
+
+void MetricsExporter::ovenConnected()
+{
+	_connected.storeRelease(1);
+}
+
+void MetricsExporter::ovenDisconnected()
+{
+	_connected.storeRelease(0);
+	_lastReading = QTime();
+}
+
+void MetricsExporter::processReadings(struct oven_state state, QTime timestamp)
+{
+	qint64 latency = timestamp.msecsTo(QTime::currentTime());
+
+	// QTime wraps at midnight
+	if (latency < 0)
+		latency += 24 * 60 * 60 * 1000;
+	observe(&_latency, latency_bounds, latency * 1000);
+
+	if (_lastReading.isValid()) {
+		qint64 interval = _lastReading.msecsTo(timestamp);
+		if (interval < 0)
+			interval += 24 * 60 * 60 * 1000;
+		observe(&_interval, interval_bounds, interval * 1000);
+	}
+	_lastReading = timestamp;
+
+	_readings.fetchAndAddRelaxed(1);
+	_probeTemperature.storeRelease(state.probe_temp);
+	_internalTemperature.storeRelease(state.internal_temp);
+	_targetTemperature.storeRelease(state.target_temp);
+	_filamentsEnabled.storeRelease(state.enable_filaments);
+	_topDuty.storeRelease(state.top_duty);
+	_bottomDuty.storeRelease(state.bottom_duty);
+	_coolingDuty.storeRelease(state.cooling_duty);
+	if (state.fault_short_vcc)
+		_faultShortVcc.fetchAndAddRelaxed(1);
+	if (state.fault_short_gnd)
+		_faultShortGnd.fetchAndAddRelaxed(1);
+	if (state.fault_open_circuit)
+		_faultOpenCircuit.fetchAndAddRelaxed(1);
+}
+
+void MetricsExporter::countSamples(QVector<oven_sample> samples)
+{
+	_samples.fetchAndAddRelaxed(samples.size());
+}
+
+void MetricsExporter::countError(int error)
+{
+	(void)error;
+	_errors.fetchAndAddRelaxed(1);
+}
+
+void MetricsExporter::commandCompleted(unsigned long code, int latency_ms)
+{
+	(void)code;
+	observe(&_command, command_bounds, latency_ms * 1000LL);
+}
+
+void MetricsExporter::commandFailed(unsigned long code, int error)
+{
+	(void)code;
+	(void)error;
+	_commandFailures.fetchAndAddRelaxed(1);
+}
+
+void MetricsExporter::observe(Histogram *histogram, const double *bounds, qint64 value_us)
+{
+	int bucket = 0;
+
+	while (bucket < HISTOGRAM_BUCKETS && value_us > bounds[bucket] * 1000000)
+		bucket++;
+	histogram->buckets[bucket].fetchAndAddRelaxed(1);
+	histogram->sum_us.fetchAndAddRelaxed(value_us);
+	histogram->count.fetchAndAddRelaxed(1);
+}
+
+void MetricsExporter::renderHistogram(QByteArray *out, const char *name, const char *help, const Histogram *histogram, const double *bounds)
+{
+	QByteArray bucket = QByteArray(name) + "_bucket";
+	quint64 cumulative = 0;
+
+	render_metric(out, name, "histogram", help);
+	out->append("# UNIT ").append(name).append(" seconds\n");
+	for (int i = 0; i <= HISTOGRAM_BUCKETS; i++) {
+		QByteArray le = "le=\"" + (i < HISTOGRAM_BUCKETS ? QByteArray::number(bounds[i]) : QByteArray("+Inf")) + "\"";
+		cumulative += histogram->buckets[i].loadAcquire();
+		render_sample(out, bucket.constData(), le.constData(), cumulative);
+	}
+	// The buckets are read one at a time, so the count is taken from them to
+	// keep the exposition self-consistent while readings keep arriving.
+	render_sample(out, (QByteArray(name) + "_count").constData(), NULL, cumulative);
+	render_sample(out, (QByteArray(name) + "_sum").constData(), NULL, histogram->sum_us.loadAcquire() / 1e6);
+}
+
+QByteArray MetricsExporter::render() const
+{
+	QByteArray out;
+	qint64 runStart = _runStart.loadAcquire();
+
+	render_metric(&out, "pcboven_connected", "gauge", "Whether the oven is connected.");
+	render_sample(&out, "pcboven_connected", NULL, _connected.loadAcquire());
+
+	render_metric(&out, "pcboven_probe_temperature_celsius", "gauge", "Thermocouple probe temperature.");
+	out.append("# UNIT pcboven_probe_temperature_celsius celsius\n");
+	render_sample(&out, "pcboven_probe_temperature_celsius", NULL, temperatureToCelsius(_probeTemperature.loadAcquire()));
+
+	render_metric(&out, "pcboven_internal_temperature_celsius", "gauge", "Cold junction temperature of the thermocouple converter.");
+	out.append("# UNIT pcboven_internal_temperature_celsius celsius\n");
+	render_sample(&out, "pcboven_internal_temperature_celsius", NULL, temperatureToCelsius(_internalTemperature.loadAcquire()));
+
+	render_metric(&out, "pcboven_target_temperature_celsius", "gauge", "Target temperature of the oven controller.");
+	out.append("# UNIT pcboven_target_temperature_celsius celsius\n");
+	render_sample(&out, "pcboven_target_temperature_celsius", NULL, temperatureToCelsius(_targetTemperature.loadAcquire()));
+
+	render_metric(&out, "pcboven_filaments_enabled", "gauge", "Whether the filaments are enabled.");
+	render_sample(&out, "pcboven_filaments_enabled", NULL, _filamentsEnabled.loadAcquire());
+
+	render_metric(&out, "pcboven_filament_duty_ratio", "gauge", "Duty cycle of each heating element.");
+	out.append("# UNIT pcboven_filament_duty_ratio ratio\n");
+	render_sample(&out, "pcboven_filament_duty_ratio", "element=\"top\"", _topDuty.loadAcquire() / 255.0);
+	render_sample(&out, "pcboven_filament_duty_ratio", "element=\"bottom\"", _bottomDuty.loadAcquire() / 255.0);
+
+	render_metric(&out, "pcboven_cooling_duty_ratio", "gauge", "Duty cycle of the cooling output.");
+	out.append("# UNIT pcboven_cooling_duty_ratio ratio\n");
+	render_sample(&out, "pcboven_cooling_duty_ratio", NULL, _coolingDuty.loadAcquire() / 255.0);
+
+	render_metric(&out, "pcboven_readings", "counter", "Readings received from the oven.");
+	render_sample(&out, "pcboven_readings_total", NULL, _readings.loadAcquire());
+
+	render_metric(&out, "pcboven_samples", "counter", "Thermocouple samples received with the readings.");
+	render_sample(&out, "pcboven_samples_total", NULL, _samples.loadAcquire());
+
+	render_metric(&out, "pcboven_thermocouple_faults", "counter", "Readings reporting a thermocouple fault.");
+	render_sample(&out, "pcboven_thermocouple_faults_total", "fault=\"short_vcc\"", _faultShortVcc.loadAcquire());
+	render_sample(&out, "pcboven_thermocouple_faults_total", "fault=\"short_gnd\"", _faultShortGnd.loadAcquire());
+	render_sample(&out, "pcboven_thermocouple_faults_total", "fault=\"open_circuit\"", _faultOpenCircuit.loadAcquire());
+
+	render_metric(&out, "pcboven_errors", "counter", "Errors talking to the oven.");
+	render_sample(&out, "pcboven_errors_total", NULL, _errors.loadAcquire());
+
+	renderHistogram(&out, "pcboven_reading_interval_seconds", "Time between consecutive readings.", &_interval, interval_bounds);
+	renderHistogram(&out, "pcboven_reading_latency_seconds", "Delay from a reading being taken to it being processed.", &_latency, latency_bounds);
+	renderHistogram(&out, "pcboven_command_latency_seconds", "Time from a command being issued to the oven applying it.", &_command, command_bounds);
+
+	render_metric(&out, "pcboven_command_failures", "counter", "Commands the oven failed or did not confirm.");
+	render_sample(&out, "pcboven_command_failures_total", NULL, _commandFailures.loadAcquire());
+
+	render_metric(&out, "pcboven_runs", "counter", "Reflow runs started.");
+	render_sample(&out, "pcboven_runs_total", NULL, _runs.loadAcquire());
+
+	render_metric(&out, "pcboven_run_active", "gauge", "Whether a reflow run is in progress.");
+	render_sample(&out, "pcboven_run_active", NULL, runStart != 0);
+
+	render_metric(&out, "pcboven_run_elapsed_seconds", "gauge", "Time since the current run started.");
+	out.append("# UNIT pcboven_run_elapsed_seconds seconds\n");
+	render_sample(&out, "pcboven_run_elapsed_seconds", NULL, runStart ? (QDateTime::currentMSecsSinceEpoch() - runStart) / 1000.0 : 0);
+
+	out.append("# EOF\n");
+	return out;
+}
+
+MetricsServer::MetricsServer(const MetricsExporter *exporter) : QObject()
+{
+	_exporter = exporter;
+	_server = NULL;
+}
+
+bool MetricsServer::listen(quint16 port)
+{
+	if (!_server) {
+		_server = new QTcpServer(this);
+		connect(_server, &QTcpServer::newConnection, this, &MetricsServer::clientConnected);
+	}
+	// Only ever exposed on the loopback interface
+	return _server->listen(QHostAddress::LocalHost, port);
+}
+
+void MetricsServer::clientConnected()
+{
+	QTcpSocket *client;
+
+	while ((client = _server->nextPendingConnection())) {
+		connect(client, &QTcpSocket::readyRead, this, &MetricsServer::clientReadyRead);
+		connect(client, &QTcpSocket::disconnected, client, &QObject::deleteLater);
+	}
+}
+
+void MetricsServer::clientReadyRead()
+{
+	QTcpSocket *client = qobject_cast<QTcpSocket *>(sender());
+	QByteArray status = "200 OK";
+	QByteArray type = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+	QByteArray body;
+
+	if (client->bytesAvailable() > MAX_REQUEST) {
+		client->abort();
+		return;
+	}
+	if (!client->canReadLine())
+		return;
+
+	// Only the request line matters; the headers are never needed
+	QList<QByteArray> request = client->readLine().split(' ');
+	if (request.size() < 2 || request[0] != "GET") {
+		status = "405 Method Not Allowed";
+		type = "text/plain";
+	} else if (request[1] != "/metrics" && request[1] != "/") {
+		status = "404 Not Found";
+		type = "text/plain";
+	} else {
+		body = _exporter->render();
+	}
+
+	client->write("HTTP/1.0 " + status + "\r\n"
+	              "Content-Type: " + type + "\r\n"
+	              "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+	              "Connection: close\r\n\r\n" + body);
+	client->disconnectFromHost();
+}
@@ -0,0 +1,103 @@
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include <QAtomicInteger>
+#include <QObject>
+#include <QTcpServer>
+#include <QThread>
+#include <QTime>
+#include "ovenmanager.h"
+
+class MetricsServer;
+
+// Serves the oven's telemetry in OpenMetrics text format on localhost.
+// Readings update fixed sets of atomic gauges, counters and histogram
+// buckets as they arrive (possibly on a transport's thread), and scrapes are
+// answered from those on a separate thread, so a scrape costs the same at
+// any point of a run and never holds up the oven.
+class MetricsExporter : public QObject
+{
+	Q_OBJECT
+
+	public:
+		explicit MetricsExporter(OvenManager *ovenManager, QObject *parent = 0);
+		virtual ~MetricsExporter();
+
+		static const int HISTOGRAM_BUCKETS = 7;
+
+		bool listen(quint16 port);
+		QByteArray render() const;
+
+	public slots:
+		void runStarted();
+		void runFinished();
+
+	private slots:
+		void ovenConnected();
+		void ovenDisconnected();
+		void processReadings(struct oven_state state, QTime timestamp);
+		void countSamples(QVector<oven_sample> samples);
+		void countError(int error);
+		void commandCompleted(unsigned long code, int latency_ms);
+		void commandFailed(unsigned long code, int error);
+
+	private:
+		struct Histogram {
+			QAtomicInteger<quint32> buckets[HISTOGRAM_BUCKETS + 1];
+			QAtomicInteger<quint64> count;
+			QAtomicInteger<quint64> sum_us;
+		};
+
+		static void observe(Histogram *histogram, const double *bounds, qint64 value_us);
+		static void renderHistogram(QByteArray *out, const char *name, const char *help, const Histogram *histogram, const double *bounds);
+
+		OvenManager *_ovenManager;
+		QThread _thread;
+		MetricsServer *_server;
+		QTime _lastReading;
+
+		QAtomicInt _connected;
+		QAtomicInt _probeTemperature;
+		QAtomicInt _internalTemperature;
+		QAtomicInt _targetTemperature;
+		QAtomicInt _filamentsEnabled;
+		QAtomicInt _topDuty;
+		QAtomicInt _bottomDuty;
+		QAtomicInt _coolingDuty;
+		QAtomicInteger<quint64> _readings;
+		QAtomicInteger<quint64> _samples;
+		QAtomicInteger<quint64> _faultShortVcc;
+		QAtomicInteger<quint64> _faultShortGnd;
+		QAtomicInteger<quint64> _faultOpenCircuit;
+		QAtomicInteger<quint64> _errors;
+		QAtomicInteger<quint64> _commandFailures;
+		QAtomicInteger<quint64> _runs;
+		QAtomicInteger<qint64> _runStart;
+		Histogram _interval;
+		Histogram _latency;
+		Histogram _command;
+};
+
+// Minimal HTTP/1.0 responder living on the exporter's thread
+class MetricsServer : public QObject
+{
+	Q_OBJECT
+
+	public:
+		explicit MetricsServer(const MetricsExporter *exporter);
+
+		static const int MAX_REQUEST = 8192;
+
+	public slots:
+		bool listen(quint16 port);
+
+	private slots:
+		void clientConnected();
+		void clientReadyRead();
+
+	private:
+		const MetricsExporter *_exporter;
+		QTcpServer *_server;
+};
+
+#endif // METRICSEXPORTER_H
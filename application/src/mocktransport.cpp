@@ -0,0 +1,136 @@
+#include <errno.h>
+#include <string.h>
+#include "mocktransport.h"
+#include "temperature.h"
+
+// Roughly a small toaster oven
+#define AMBIENT       25.0   // C
+#define HEATER_GAIN   260.0  // C above ambient at full duty
+#define TIME_CONSTANT 150.0  // s
+#define COOLER_GAIN   3.0    // extra heat loss at full cooling, in multiples of the oven's own
+
+// The firmware's defaults and fixed point scaling, see controller.c
+#define DEFAULT_GAIN_P (16 << 8)
+#define DEFAULT_GAIN_I 13
+#define TERM_SHIFT     10
+#define DUTY_MAX       255
+#define COOLING_BAND   2.0   // C
+#define COOLING_GAIN   64    // duty per degree C beyond the band
+
+MockTransport::MockTransport(QObject *parent) : OvenTransport(parent)
+{
+	memset(&_oven, 0, sizeof(_oven));
+	_oven.balance = PCBOVEN_BALANCE_EVEN;
+	_gains.proportional = DEFAULT_GAIN_P;
+	_gains.integral = DEFAULT_GAIN_I;
+	_gains.derivative = 0;
+	_temperature = AMBIENT;
+	_integral = 0;
+	_sampleSequence = 0;
+
+	_timer = new QTimer(this);
+	_timer->setInterval(READING_PERIOD_MS);
+	connect(_timer, &QTimer::timeout, this, &MockTransport::step);
+}
+
+MockTransport::~MockTransport()
+{
+	close();
+}
+
+bool MockTransport::open()
+{
+	_timer->start();
+	emit connected();
+	return true;
+}
+
+void MockTransport::close()
+{
+	if (_timer->isActive()) {
+		_timer->stop();
+		emit disconnected();
+	}
+}
+
+int MockTransport::execute(unsigned long code, QByteArray data, bool byReference)
+{
+	QMutexLocker locker(&_mutex);
+	int frame;
+	(void)byReference;
+
+	return applyCommand(&_oven, &_gains, code, data, &frame);
+}
+
+bool MockTransport::getGains(struct oven_gains *gains)
+{
+	QMutexLocker locker(&_mutex);
+	*gains = _gains;
+	return true;
+}
+
+// Proportional and integral terms only, at one update per reading
+int MockTransport::controllerOutput()
+{
+	qint32 error = _oven.target_temp - _oven.probe_temp;
+	qint32 output;
+
+	_integral = qBound(0, _integral + (qint32)_gains.integral * error, DUTY_MAX << TERM_SHIFT);
+	output = ((qint32)_gains.proportional * error + _integral) >> TERM_SHIFT;
+	return qBound(0, output, DUTY_MAX);
+}
+
+void MockTransport::step()
+{
+	struct oven_state state;
+	QVector<oven_sample> samples;
+	double dt = READING_PERIOD_MS / 1000.0 / PCBOVEN_SAMPLE_RATE;
+	double heat, loss;
+
+	_mutex.lock();
+	if (!_oven.enable_filaments) {
+		_oven.top_duty = _oven.bottom_duty = 0;
+		_integral = 0;
+	} else if (!_oven.manual_duty) {
+		int duty = controllerOutput();
+		_oven.top_duty = qMin(DUTY_MAX, duty * _oven.balance / PCBOVEN_BALANCE_EVEN);
+		_oven.bottom_duty = qMin(DUTY_MAX, duty * (256 - _oven.balance) / PCBOVEN_BALANCE_EVEN);
+	} else {
+		_oven.top_duty = _oven.manual_top_duty;
+		_oven.bottom_duty = _oven.manual_bottom_duty;
+	}
+	_oven.filament_top_on = _oven.top_duty > 0;
+	_oven.filament_bottom_on = _oven.bottom_duty > 0;
+
+	if (!_oven.manual_cooling) {
+		double behind = temperatureToCelsius(_oven.probe_temp - _oven.target_temp) - COOLING_BAND;
+		if (_oven.enable_filaments && !_oven.manual_duty)
+			_oven.cooling_duty = qBound(0, (int)(behind * COOLING_GAIN), DUTY_MAX);
+		else
+			_oven.cooling_duty = 0;
+	} else {
+		_oven.cooling_duty = _oven.manual_cooling_duty;
+	}
+
+	// Sampled like the firmware, several times per reading
+	heat = HEATER_GAIN * (_oven.top_duty + _oven.bottom_duty) / (2.0 * DUTY_MAX);
+	for (int i = 0; i < PCBOVEN_SAMPLE_RATE; i++) {
+		struct oven_sample sample;
+		loss = COOLER_GAIN * _oven.cooling_duty / DUTY_MAX * (_temperature - AMBIENT);
+		_temperature += (AMBIENT + heat - _temperature - loss) * dt / TIME_CONSTANT;
+		sample.time = _sampleSequence++ * (1000 / PCBOVEN_SAMPLE_RATE);
+		sample.probe_temp = celsiusToTemperature(_temperature);
+		samples.append(sample);
+	}
+	_oven.probe_temp = celsiusToTemperature(_temperature);
+	_oven.internal_temp = celsiusToTemperature(AMBIENT);
+	_oven.applied_target_temp = _oven.target_temp;
+	_oven.applied_enable = _oven.enable_filaments;
+
+	checkWatchdog(&_oven, CEILING);
+	state = _oven;
+	_mutex.unlock();
+
+	emit samplesReceived(samples);
+	emit stateReceived(state, QTime::currentTime());
+}
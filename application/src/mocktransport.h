@@ -0,0 +1,44 @@
+#ifndef MOCKTRANSPORT_H
+#define MOCKTRANSPORT_H
+
+#include <QMutex>
+#include <QTimer>
+#include "oventransport.h"
+
+// A simulated oven, for running the applications and exercising OvenManager
+// without hardware. A first order thermal model is driven by a copy of the
+// firmware's controller and automatic cooling, and read every
+// READING_PERIOD_MS. Commands take effect at once, so they are echoed in the
+// next reading.
+class MockTransport : public OvenTransport
+{
+	Q_OBJECT
+
+	public:
+		explicit MockTransport(QObject *parent = 0);
+		virtual ~MockTransport();
+
+		static const int READING_PERIOD_MS = 1000;
+		static const int CEILING = 300;
+
+		virtual bool open();
+		virtual void close();
+		virtual int execute(unsigned long code, QByteArray data, bool byReference);
+		virtual bool getGains(struct oven_gains *gains);
+
+	private slots:
+		void step();
+
+	private:
+		int controllerOutput();
+
+		QTimer *_timer;
+		QMutex _mutex;
+		struct oven_state _oven;
+		struct oven_gains _gains;
+		double _temperature;
+		qint32 _integral;
+		quint32 _sampleSequence;
+};
+
+#endif // MOCKTRANSPORT_H
@@ -0,0 +1,211 @@
+#include <errno.h>
+#include <string.h>
+#include <iostream>
+#include "brokerprotocol.h"
+#include "ovenbroker.h"
+
+OvenBroker::OvenBroker(OvenManager *ovenManager, QObject *parent) : QObject(parent)
+{
+	_ovenManager = ovenManager;
+	_ovenManager->setAutomaticHeartbeat(false);
+	_controller = NULL;
+	_ovenConnected = false;
+
+	_server = new QLocalServer(this);
+	connect(_server, &QLocalServer::newConnection, this, &OvenBroker::clientConnected);
+
+	connect(_ovenManager, &OvenManager::connected, this, &OvenBroker::ovenConnected);
+	connect(_ovenManager, &OvenManager::disconnected, this, &OvenBroker::ovenDisconnected);
+	connect(_ovenManager, &OvenManager::readingsRead, this, &OvenBroker::ovenReadings);
+	connect(_ovenManager, &OvenManager::samplesRead, this, &OvenBroker::ovenSamples);
+	connect(_ovenManager, &OvenManager::errorOccurred, this, &OvenBroker::ovenError);
+}
+
+OvenBroker::~OvenBroker()
+{
+	releaseControl();
+}
+
+bool OvenBroker::listen(QString name)
+{
+	QLocalServer::removeServer(name);
+	_server->setSocketOptions(QLocalServer::UserAccessOption);
+	return _server->listen(name);
+}
+
+void OvenBroker::clientConnected()
+{
+	QLocalSocket *client;
+
+	while ((client = _server->nextPendingConnection())) {
+		connect(client, &QLocalSocket::disconnected, this, &OvenBroker::clientDisconnected);
+		connect(client, &QLocalSocket::readyRead, this, &OvenBroker::clientReadyRead);
+		_clients.insert(client, QByteArray());
+
+		if (_ovenConnected)
+			send(client, BrokerProtocol::frame(BrokerProtocol::Connected));
+	}
+}
+
+void OvenBroker::clientDisconnected()
+{
+	QLocalSocket *client = qobject_cast<QLocalSocket *>(sender());
+
+	if (client == _controller)
+		releaseControl();
+
+	_clients.remove(client);
+	client->deleteLater();
+}
+
+void OvenBroker::clientReadyRead()
+{
+	QLocalSocket *client = qobject_cast<QLocalSocket *>(sender());
+	QByteArray buffer = _clients.value(client) + client->readAll();
+	QByteArray payload;
+	quint8 type;
+
+	while (BrokerProtocol::unframe(&buffer, &type, &payload))
+		handleMessage(client, type, payload);
+
+	// The client may have been dropped while its messages were handled
+	if (_clients.contains(client))
+		_clients.insert(client, buffer);
+}
+
+void OvenBroker::handleMessage(QLocalSocket *client, quint8 type, QByteArray payload)
+{
+	switch (type) {
+	case BrokerProtocol::AcquireControl:
+		if (!_controller)
+			_controller = client;
+		send(client, BrokerProtocol::frame(BrokerProtocol::Control, QByteArray(1, _controller == client)));
+		break;
+	case BrokerProtocol::ReleaseControl:
+		if (client == _controller)
+			releaseControl();
+		send(client, BrokerProtocol::frame(BrokerProtocol::Control, QByteArray(1, 0)));
+		break;
+	case BrokerProtocol::Command:
+		if (client == _controller)
+			handleCommand(client, payload);
+		else
+			send(client, BrokerProtocol::frame(BrokerProtocol::Error, BrokerProtocol::encodeInt(EPERM)));
+		break;
+	default:
+		send(client, BrokerProtocol::frame(BrokerProtocol::Error, BrokerProtocol::encodeInt(EINVAL)));
+		break;
+	}
+}
+
+void OvenBroker::handleCommand(QLocalSocket *client, QByteArray payload)
+{
+	unsigned long code = (quint32)BrokerProtocol::decodeInt(payload);
+	QByteArray data = payload.mid(sizeof(qint32));
+	int value = BrokerProtocol::decodeInt(data);
+	struct oven_duty duty;
+	struct oven_gains gains;
+
+	switch (code) {
+	case PCBOVEN_HEARTBEAT:
+		_ovenManager->heartbeat();
+		break;
+	case PCBOVEN_ENABLE_FILAMENTS:
+		_ovenManager->setFilamentsEnabled(true);
+		break;
+	case PCBOVEN_DISABLE_FILAMENTS:
+		_ovenManager->setFilamentsEnabled(false);
+		break;
+	case PCBOVEN_SET_TEMPERATURE:
+		_ovenManager->setTargetTemperature(value);
+		break;
+	case PCBOVEN_SET_DUTY:
+		_ovenManager->setManualDuty(value);
+		break;
+	case PCBOVEN_SET_BALANCE:
+		_ovenManager->setBalance(value);
+		break;
+	case PCBOVEN_SET_COOLING:
+		_ovenManager->setCooling(value);
+		break;
+	case PCBOVEN_SET_ELEMENT_DUTY:
+		if (data.size() != sizeof(duty))
+			goto invalid;
+		memcpy(&duty, data.constData(), sizeof(duty));
+		_ovenManager->setElementDuty(duty.top, duty.bottom);
+		break;
+	case PCBOVEN_SET_GAINS:
+		if (data.size() != sizeof(gains))
+			goto invalid;
+		memcpy(&gains, data.constData(), sizeof(gains));
+		_ovenManager->setGains(gains);
+		break;
+	default:
+		goto invalid;
+	}
+	return;
+
+invalid:
+	send(client, BrokerProtocol::frame(BrokerProtocol::Error, BrokerProtocol::encodeInt(EINVAL)));
+}
+
+// The oven must never keep heating for a controller that has gone away
+void OvenBroker::releaseControl()
+{
+	if (!_controller)
+		return;
+
+	_controller = NULL;
+	_ovenManager->setManualDuty(PCBOVEN_DUTY_AUTOMATIC);
+	_ovenManager->setCooling(PCBOVEN_COOLING_AUTOMATIC);
+	_ovenManager->setFilamentsEnabled(false);
+}
+
+void OvenBroker::ovenConnected()
+{
+	_ovenConnected = true;
+	broadcast(BrokerProtocol::frame(BrokerProtocol::Connected));
+}
+
+void OvenBroker::ovenDisconnected()
+{
+	_ovenConnected = false;
+	broadcast(BrokerProtocol::frame(BrokerProtocol::Disconnected));
+}
+
+void OvenBroker::ovenReadings(struct oven_state state, QTime timestamp)
+{
+	struct oven_gains gains;
+
+	if (!_ovenManager->getGains(&gains))
+		memset(&gains, 0, sizeof(gains));
+	broadcast(BrokerProtocol::frame(BrokerProtocol::State, BrokerProtocol::encodeState(state, gains, timestamp)));
+}
+
+void OvenBroker::ovenSamples(QVector<oven_sample> samples)
+{
+	broadcast(BrokerProtocol::frame(BrokerProtocol::Samples, BrokerProtocol::encodeSamples(samples)));
+}
+
+void OvenBroker::ovenError(int error)
+{
+	std::cerr << "Oven error: " << error << std::endl;
+	broadcast(BrokerProtocol::frame(BrokerProtocol::Error, BrokerProtocol::encodeInt(error)));
+}
+
+void OvenBroker::broadcast(QByteArray frame)
+{
+	foreach (QLocalSocket *client, _clients.keys())
+		send(client, frame);
+}
+
+void OvenBroker::send(QLocalSocket *client, QByteArray frame)
+{
+	// A client that stops reading is dropped rather than buffered forever;
+	// it must never hold up the others or the run.
+	if (client->bytesToWrite() > MAX_PENDING_BYTES) {
+		client->abort();
+		return;
+	}
+	client->write(frame);
+}
@@ -0,0 +1,48 @@
+#ifndef OVENBROKER_H
+#define OVENBROKER_H
+
+#include <QHash>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include "ovenmanager.h"
+
+// Owns the oven on behalf of any number of local clients. Every reading is
+// read from the device once and fanned out to all clients; commands are only
+// accepted from the single client holding control.
+class OvenBroker : public QObject
+{
+	Q_OBJECT
+
+	public:
+		explicit OvenBroker(OvenManager *ovenManager, QObject *parent = 0);
+		virtual ~OvenBroker();
+
+		static const int MAX_PENDING_BYTES = 64 * 1024;
+
+		bool listen(QString name);
+
+	private slots:
+		void clientConnected();
+		void clientDisconnected();
+		void clientReadyRead();
+		void ovenConnected();
+		void ovenDisconnected();
+		void ovenReadings(struct oven_state state, QTime timestamp);
+		void ovenSamples(QVector<oven_sample> samples);
+		void ovenError(int error);
+
+	private:
+		void broadcast(QByteArray frame);
+		void send(QLocalSocket *client, QByteArray frame);
+		void handleMessage(QLocalSocket *client, quint8 type, QByteArray payload);
+		void handleCommand(QLocalSocket *client, QByteArray payload);
+		void releaseControl();
+
+		OvenManager *_ovenManager;
+		QLocalServer *_server;
+		QHash<QLocalSocket *, QByteArray> _clients;
+		QLocalSocket *_controller;
+		bool _ovenConnected;
+};
+
+#endif // OVENBROKER_H
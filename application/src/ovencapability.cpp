@@ -0,0 +1,141 @@
+#include <QSettings>
+#include <QVariant>
+#include "ovencapability.h"
+
+// Share of full heater power a window must average to count as flat out,
+// and at most to count as coasting
+#define SATURATED_POWER 0.9
+#define IDLE_POWER      0.1
+
+// Rates that are not known at all, so never limit a prediction
+#define UNLIMITED_RATE  1e6f
+
+static QVariantList to_list(const QVector<float> &rates)
+{
+	QVariantList list;
+	foreach (float rate, rates)
+		list.append(rate);
+	return list;
+}
+
+static QVector<float> from_list(const QVariantList &list, int size)
+{
+	QVector<float> rates(size, 0);
+	for (int i = 0; i < size && i < list.size(); i++)
+		rates[i] = list[i].toFloat();
+	return rates;
+}
+
+OvenCapability OvenCapability::load()
+{
+	OvenCapability capability;
+	QSettings settings;
+	settings.beginGroup("OvenCapability");
+	capability._heating = from_list(settings.value("heating").toList(), BANDS);
+	capability._cooling = from_list(settings.value("cooling").toList(), BANDS);
+	settings.endGroup();
+	return capability;
+}
+
+OvenCapability::OvenCapability()
+{
+	_heating.fill(0, BANDS);
+	_cooling.fill(0, BANDS);
+}
+
+/*
+ * Measures the rate over every RATE_WINDOW of the run and keeps the fastest
+ * heating while the elements were flat out and the fastest cooling while
+ * they were off, in the band of the window's mean temperature. Windows
+ * spanning a gap in the recording are skipped.
+ */
+void OvenCapability::learn(RunRecording run)
+{
+	QVector<float> times = run.getTimes();
+	QVector<float> probe = run.getProbe();
+	QVector<float> top = run.getTopPower();
+	QVector<float> bottom = run.getBottomPower();
+	int count = times.size();
+	int j = 0;
+
+	for (int i = 0; i < count; i++) {
+		while (j < count && times[j] < times[i] + RATE_WINDOW)
+			j++;
+		if (j >= count)
+			break;
+
+		float span = times[j] - times[i];
+		if (span > 2 * RATE_WINDOW)
+			continue;
+
+		double power = 0;
+		for (int k = i; k < j; k++)
+			power += (top[k] + bottom[k]) / 2;
+		power /= j - i;
+
+		float rate = (probe[j] - probe[i]) / span;
+		int b = band((probe[i] + probe[j]) / 2);
+		if (power >= SATURATED_POWER && rate > _heating[b])
+			_heating[b] = rate;
+		else if (power <= IDLE_POWER && -rate > _cooling[b])
+			_cooling[b] = -rate;
+	}
+}
+
+void OvenCapability::save()
+{
+	QSettings settings;
+	settings.beginGroup("OvenCapability");
+	settings.setValue("heating", to_list(_heating));
+	settings.setValue("cooling", to_list(_cooling));
+	settings.endGroup();
+}
+
+bool OvenCapability::isValid()
+{
+	if (_model.isValid())
+		return true;
+	for (int i = 0; i < BANDS; i++) {
+		if (_heating[i] > 0 || _cooling[i] > 0)
+			return true;
+	}
+	return false;
+}
+
+void OvenCapability::setModel(ThermalModel model)
+{
+	_model = model;
+}
+
+ThermalModel OvenCapability::getModel()
+{
+	return _model;
+}
+
+float OvenCapability::getHeatingRate(float temperature)
+{
+	float rate = _heating[band(temperature)];
+
+	if (rate > 0)
+		return rate;
+	if (_model.isValid())
+		return qMax(0.0, (_model.getAmbient() + _model.getGain() - temperature) / _model.getTimeConstant());
+	return UNLIMITED_RATE;
+}
+
+// Without a measurement this is passive cooling, so slower than a fan can manage
+float OvenCapability::getCoolingRate(float temperature)
+{
+	float rate = _cooling[band(temperature)];
+
+	if (rate > 0)
+		return rate;
+	if (_model.isValid())
+		return qMax(0.0, (temperature - _model.getAmbient()) / _model.getTimeConstant());
+	return UNLIMITED_RATE;
+}
+
+int OvenCapability::band(float temperature)
+{
+	return qBound(0, (int)(temperature / BAND_WIDTH), BANDS - 1);
+}
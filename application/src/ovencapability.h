@@ -0,0 +1,37 @@
+#ifndef OVENCAPABILITY_H
+#define OVENCAPABILITY_H
+
+#include <QVector>
+#include "runrecording.h"
+#include "thermalmodel.h"
+
+// The fastest the oven has been seen to heat (elements full on) and cool
+// (elements off) in each band of probe temperature, learned from recorded
+// runs. Bands it has never been seen in fall back to the thermal model.
+class OvenCapability
+{
+	public:
+		static const int BAND_WIDTH = 20;
+		static const int BANDS = 15;
+		static const int RATE_WINDOW = 5;
+
+		static OvenCapability load();
+
+		OvenCapability();
+		void learn(RunRecording run);
+		void save();
+		bool isValid();
+		void setModel(ThermalModel model);
+		ThermalModel getModel();
+		float getHeatingRate(float temperature);
+		float getCoolingRate(float temperature);
+
+	private:
+		int band(float temperature);
+
+		QVector<float> _heating;
+		QVector<float> _cooling;
+		ThermalModel _model;
+};
+
+#endif // OVENCAPABILITY_H
@@ -1,17 +1,44 @@
-#include <fcntl.h>
-#include <sys/ioctl.h>
-#include <linux/usbdevice_fs.h>
 #include <errno.h>
+#include <limits.h>
+#include <string.h>
 #include <QThread>
+#include "brokerprotocol.h"
 #include "ovenmanager.h"
+#include "pcboven_protocol.h"
 
-static OvenManager *_sigio_receiver;
+// Cached settings are set to this when a command fails, so the next
+// request for any value goes out again
+#define UNKNOWN INT_MIN
 
 OvenManager::OvenManager(QObject *parent) : QObject(parent)
 {
 	_filamentsEnabled = false;
 	_targetTemperature = 0;
+	_topDuty = PCBOVEN_DUTY_AUTOMATIC;
+	_bottomDuty = PCBOVEN_DUTY_AUTOMATIC;
+	_balance = PCBOVEN_BALANCE_EVEN;
+	_cooling = PCBOVEN_COOLING_AUTOMATIC;
 	_connected = false;
+	_transport = NULL;
+	_brokerSocket = NULL;
+	_brokerControl = false;
+	memset(&_gains, 0, sizeof(_gains));
+	_automaticHeartbeat = true;
+	_tripReason = PCBOVEN_TRIP_NONE;
+	_lastSampleTime = -1;
+	_heater = 0;
+
+	// Commands are sent from a worker thread and confirmed against the
+	// readings, which may arrive on a transport's own thread, so their
+	// results are reported from the event loop
+	_commands = new CommandQueue(this);
+	connect(_commands, &CommandQueue::completed, this, &OvenManager::commandCompleted, Qt::QueuedConnection);
+	connect(_commands, &CommandQueue::failed, this, &OvenManager::forgetCommand, Qt::QueuedConnection);
+
+	// The driver switches the filaments off if it stops hearing from us
+	_heartbeatTimer = new QTimer(this);
+	_heartbeatTimer->setInterval(HEARTBEAT_PERIOD_MS);
+	connect(_heartbeatTimer, &QTimer::timeout, this, &OvenManager::heartbeat);
 }
 
 OvenManager::~OvenManager()
@@ -19,38 +46,51 @@ OvenManager::~OvenManager()
 	stop();
 }
 
-void OvenManager::start()
+// Opens the oven through one of OvenTransport::names()
+void OvenManager::start(QString transport)
 {
-	_ioctlFd = open("/dev/pcboven", O_RDWR, O_NONBLOCK);
-	if (_ioctlFd < 0) {
-		emit errorOccurred(errno);
+	_transport = OvenTransport::create(transport, this);
+	if (!_transport) {
+		emit errorOccurred(EINVAL);
 		return;
 	}
 
-	register_sigio_receiver(this);
+	connect(_transport, &OvenTransport::connected, this, &OvenManager::transportConnected);
+	connect(_transport, &OvenTransport::disconnected, this, &OvenManager::transportDisconnected);
+	connect(_transport, &OvenTransport::stateReceived, this, &OvenManager::processState);
+	connect(_transport, &OvenTransport::samplesReceived, this, &OvenManager::processSamples);
+	connect(_transport, &OvenTransport::errorOccurred, this, &OvenManager::errorOccurred);
+	_commands->setTransport(_transport);
 
-	if (fcntl(_ioctlFd, F_SETOWN, getpid())) {
+	if (!_transport->open())
 		emit errorOccurred(errno);
-		return;
-	}
+}
 
-	if (fcntl(_ioctlFd, F_SETFL, (fcntl(_ioctlFd, F_GETFL) | FASYNC))) {
-		emit errorOccurred(errno);
-		return;
-	}
+// Shares an oven owned by the broker daemon instead of opening the device.
+// With control, commands are forwarded to the device; without it, this
+// instance only watches.
+void OvenManager::startBroker(QString name, bool control)
+{
+	_brokerControl = control;
+	_brokerSocket = new QLocalSocket(this);
+	_commands->setBroker(_brokerSocket);
+	connect(_brokerSocket, &QLocalSocket::connected, this, &OvenManager::brokerConnected);
+	connect(_brokerSocket, &QLocalSocket::disconnected, this, &OvenManager::brokerDisconnected);
+	connect(_brokerSocket, &QLocalSocket::readyRead, this, &OvenManager::brokerReadyRead);
 
-	int ret = ioctl(_ioctlFd, PCBOVEN_IS_CONNECTED);
-	if (ret < 0) {
-		emit errorOccurred(ret);
-	} else if (ret) {
-		_connected = true;
-		emit connected();
-	}
+	_brokerSocket->connectToServer(name);
+	if (!_brokerSocket->waitForConnected(BROKER_TIMEOUT_MS))
+		emit errorOccurred(ECONNREFUSED);
 }
 
 void OvenManager::stop()
 {
-	close(_ioctlFd);
+	if (_brokerSocket) {
+		_brokerSocket->disconnectFromServer();
+	} else if (_transport) {
+		_commands->clear();
+		_transport->close();
+	}
 }
 
 void OvenManager::setFilamentsEnabled(bool enabled)
@@ -58,68 +98,315 @@ void OvenManager::setFilamentsEnabled(bool enabled)
 	if (enabled != _filamentsEnabled) {
 		int code = enabled ? PCBOVEN_ENABLE_FILAMENTS :
 		                     PCBOVEN_DISABLE_FILAMENTS;
-		if (ioctl(_ioctlFd, code))
+		if (control(code))
 			emit errorOccurred(errno);
 		else
 			_filamentsEnabled = enabled;
 	}
+
+	if (_filamentsEnabled && _automaticHeartbeat)
+		_heartbeatTimer->start();
+	else
+		_heartbeatTimer->stop();
 }
 
-void OvenManager::setTargetTemperature(int temperature)
+// Used by the broker, which relays its controlling client's heartbeats
+// instead of vouching for it
+void OvenManager::setAutomaticHeartbeat(bool automatic)
+{
+	_automaticHeartbeat = automatic;
+	if (!automatic)
+		_heartbeatTimer->stop();
+	else if (_filamentsEnabled)
+		_heartbeatTimer->start();
+}
+
+// Sends the filaments off even if they are believed to be, for when this
+// instance cannot know what an earlier one left the oven doing
+void OvenManager::switchOff()
+{
+	if (control(PCBOVEN_DISABLE_FILAMENTS))
+		emit errorOccurred(errno);
+	_filamentsEnabled = false;
+	_heartbeatTimer->stop();
+}
+
+void OvenManager::heartbeat()
+{
+	if (control(PCBOVEN_HEARTBEAT))
+		emit errorOccurred(errno);
+}
+
+void OvenManager::setTargetTemperature(Temperature temperature)
 {
 	if (temperature != _targetTemperature) {
-		if (ioctl(_ioctlFd, PCBOVEN_SET_TEMPERATURE, temperature))
+		if (control(PCBOVEN_SET_TEMPERATURE, temperature))
 			emit errorOccurred(errno);
 		else
 			_targetTemperature = temperature;
 	}
 }
 
-void OvenManager::sigio_handler(int sig)
+void OvenManager::setManualDuty(int duty)
 {
-	QTime timestamp = QTime::currentTime();
-	struct oven_state state;
-	int ret;
-	(void)sig;
-
-	if (_connected) {
-		ret = ioctl(_ioctlFd, PCBOVEN_GET_STATE, &state);
-		if (ret == 0) {
-			emit readingsRead(state, timestamp);
-		} else if (ret == -1) {
-			if (errno == ENODEV) {
-				_connected = false;
-				emit disconnected();
-			} else {
+	if (duty == PCBOVEN_DUTY_AUTOMATIC) {
+		if (_topDuty != PCBOVEN_DUTY_AUTOMATIC) {
+			if (control(PCBOVEN_SET_DUTY, duty))
 				emit errorOccurred(errno);
-			}
-		} else {
-			emit errorOccurred(ret);
+			else
+				_topDuty = _bottomDuty = duty;
 		}
 	} else {
-		ret = ioctl(_ioctlFd, PCBOVEN_IS_CONNECTED, &state);
-		if (ret < 0) {
-			emit errorOccurred(ret);
-		} else if (ret) {
+		setElementDuty(duty, duty);
+	}
+}
+
+void OvenManager::setElementDuty(int top, int bottom)
+{
+	struct oven_duty duty = { top, bottom };
+
+	if (top != _topDuty || bottom != _bottomDuty) {
+		if (control(PCBOVEN_SET_ELEMENT_DUTY, &duty, sizeof(duty))) {
+			emit errorOccurred(errno);
+		} else {
+			_topDuty = top;
+			_bottomDuty = bottom;
+		}
+	}
+}
+
+void OvenManager::setBalance(int balance)
+{
+	if (balance != _balance) {
+		if (control(PCBOVEN_SET_BALANCE, balance))
+			emit errorOccurred(errno);
+		else
+			_balance = balance;
+	}
+}
+
+// A fixed cooling duty (0-255), or PCBOVEN_COOLING_AUTOMATIC to let the
+// firmware cool whenever the oven falls behind a falling target
+void OvenManager::setCooling(int cooling)
+{
+	if (cooling != _cooling) {
+		if (control(PCBOVEN_SET_COOLING, cooling))
+			emit errorOccurred(errno);
+		else
+			_cooling = cooling;
+	}
+}
+
+void OvenManager::setGains(struct oven_gains gains)
+{
+	if (control(PCBOVEN_SET_GAINS, &gains, sizeof(gains)))
+		emit errorOccurred(errno);
+}
+
+bool OvenManager::getGains(struct oven_gains *gains)
+{
+	if (_brokerSocket) {
+		*gains = _gains;
+		return _connected;
+	}
+	return _transport && _transport->getGains(gains);
+}
+
+// Commands are queued rather than sent here; failures are reported later
+// through commandFailed and errorOccurred
+int OvenManager::control(unsigned long code, int value)
+{
+	if (_brokerSocket && !_brokerControl) {
+		errno = EPERM;
+		return -1;
+	}
+
+	_commands->submit(code, value);
+	return 0;
+}
+
+int OvenManager::control(unsigned long code, void *data, int size)
+{
+	if (_brokerSocket && !_brokerControl) {
+		errno = EPERM;
+		return -1;
+	}
+
+	_commands->submit(code, data, size);
+	return 0;
+}
+
+void OvenManager::forgetCommand(unsigned long code, int error)
+{
+	switch (code) {
+	case PCBOVEN_SET_TEMPERATURE:
+		_targetTemperature = UNKNOWN;
+		break;
+	case PCBOVEN_ENABLE_FILAMENTS:
+		_filamentsEnabled = false;
+		_heartbeatTimer->stop();
+		break;
+	case PCBOVEN_DISABLE_FILAMENTS:
+		_filamentsEnabled = true;
+		break;
+	case PCBOVEN_SET_DUTY:
+	case PCBOVEN_SET_ELEMENT_DUTY:
+		_topDuty = _bottomDuty = UNKNOWN;
+		break;
+	case PCBOVEN_SET_BALANCE:
+		_balance = UNKNOWN;
+		break;
+	case PCBOVEN_SET_COOLING:
+		_cooling = UNKNOWN;
+		break;
+	default:
+		break;
+	}
+
+	emit commandFailed(code, error);
+	emit errorOccurred(error);
+}
+
+void OvenManager::brokerConnected()
+{
+	if (_brokerControl)
+		_brokerSocket->write(BrokerProtocol::frame(BrokerProtocol::AcquireControl));
+}
+
+void OvenManager::brokerDisconnected()
+{
+	_commands->clear();
+	if (_connected) {
+		_connected = false;
+		emit disconnected();
+	}
+	emit errorOccurred(ECONNRESET);
+}
+
+void OvenManager::brokerReadyRead()
+{
+	quint8 type;
+	QByteArray payload;
+	struct oven_state state;
+	QVector<oven_sample> samples;
+	QTime timestamp;
+
+	_brokerBuffer.append(_brokerSocket->readAll());
+	while (BrokerProtocol::unframe(&_brokerBuffer, &type, &payload)) {
+		switch (type) {
+		case BrokerProtocol::Connected:
 			_connected = true;
 			emit connected();
+			break;
+		case BrokerProtocol::Disconnected:
+			_connected = false;
+			forgetDevice();
+			emit disconnected();
+			break;
+		case BrokerProtocol::State:
+			if (BrokerProtocol::decodeState(payload, &state, &_gains, &timestamp))
+				processState(state, timestamp);
+			break;
+		case BrokerProtocol::Samples:
+			if (BrokerProtocol::decodeSamples(payload, &samples))
+				processSamples(samples);
+			break;
+		case BrokerProtocol::Error:
+			emit errorOccurred(BrokerProtocol::decodeInt(payload));
+			break;
+		case BrokerProtocol::Control:
+			if (payload.isEmpty() || !payload.at(0)) {
+				_brokerControl = false;
+				emit errorOccurred(EBUSY);
+			}
+			break;
+		default:
+			break;
 		}
 	}
 }
 
-void OvenManager::top_sigio_handler(int sig)
+void OvenManager::transportConnected()
 {
-	if (_sigio_receiver)
-		_sigio_receiver->sigio_handler(sig);
-	signal(SIGIO, &OvenManager::top_sigio_handler);
+	_connected = true;
+	emit connected();
 }
 
-void OvenManager::register_sigio_receiver(OvenManager *receiver)
+void OvenManager::transportDisconnected()
 {
-	_sigio_receiver = receiver;
-	if (receiver)
-		signal(SIGIO, &OvenManager::top_sigio_handler);
-	else
-		signal(SIGIO, NULL);
+	_connected = false;
+	_commands->clear();
+	forgetDevice();
+	emit disconnected();
+}
+
+// An oven that comes back has started over with its filaments off, so
+// nothing sent to it before can be assumed; the next settings all go out
+void OvenManager::forgetDevice()
+{
+	_filamentsEnabled = false;
+	_heartbeatTimer->stop();
+	_targetTemperature = UNKNOWN;
+	_topDuty = _bottomDuty = UNKNOWN;
+	_balance = UNKNOWN;
+	_cooling = UNKNOWN;
+	_tripReason = PCBOVEN_TRIP_NONE;
+	_lastReading = QTime();
+	_samples.clear();
+	_lastSampleTime = -1;
+}
+
+// Held for the estimator until their reading arrives
+void OvenManager::processSamples(QVector<oven_sample> samples)
+{
+	_samples += samples;
+	emit samplesRead(samples);
+}
+
+StateEstimator *OvenManager::getEstimator()
+{
+	return &_estimator;
+}
+
+void OvenManager::processState(struct oven_state state, QTime timestamp)
+{
+	double heater = state.enable_filaments ? (state.top_duty + state.bottom_duty) / 510.0 : 0;
+	double dt = _lastReading.isValid() ? _lastReading.msecsTo(timestamp) / 1000.0 : 0;
+	bool first = !_lastReading.isValid();
+
+	// QTime wraps at midnight
+	if (dt < 0)
+		dt += 24 * 60 * 60;
+	_lastReading = timestamp;
+
+	// The samples since the last reading are timed by the oven, and were
+	// taken with the heater as the last reading left it
+	if (_samples.isEmpty()) {
+		_estimator.update(temperatureToCelsius(state.probe_temp), heater, dt);
+	} else {
+		foreach (const struct oven_sample &sample, _samples) {
+			double step = _lastSampleTime < 0 ? 0 : qMax(0.0, (sample.time - _lastSampleTime) / 1000.0);
+			_estimator.update(temperatureToCelsius(sample.probe_temp), _heater, step);
+			_lastSampleTime = sample.time;
+		}
+		_samples.clear();
+	}
+	_heater = heater;
+	_commands->acknowledge(state);
+
+	// The driver has already switched the filaments off; keep in step so
+	// that enabling them again re-arms it. A trip from before the first
+	// reading is not news: it belongs to whoever drove the oven last.
+	if (state.trip_reason != _tripReason) {
+		_tripReason = state.trip_reason;
+		if (_tripReason != PCBOVEN_TRIP_NONE && !first) {
+			_commands->cancel(PCBOVEN_ENABLE_FILAMENTS);
+			_filamentsEnabled = false;
+			emit tripped(_tripReason);
+		}
+	}
+	emit estimateUpdated(_estimator.getTemperature(), _estimator.getRate(), timestamp);
+	emit readingsRead(state, timestamp);
 }
 
+
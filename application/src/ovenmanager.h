@@ -1,9 +1,14 @@
 #ifndef OVENMANAGER_H
 #define OVENMANAGER_H
 
-#include <signal.h>
+#include <QLocalSocket>
 #include <QTime>
+#include <QTimer>
+#include "commandqueue.h"
+#include "oventransport.h"
 #include "pcboven_usb.h"
+#include "stateestimator.h"
+#include "temperature.h"
 
 class OvenManager : public QObject
 {
@@ -12,30 +17,74 @@ class OvenManager : public QObject
 	public:
 		explicit OvenManager(QObject *parent = 0);
 		virtual ~OvenManager();
-		void start();
+
+		static const int BROKER_TIMEOUT_MS = 1000;
+		static const int HEARTBEAT_PERIOD_MS = 1000;
+		void start(QString transport = OvenTransport::DEFAULT_TRANSPORT);
+		void startBroker(QString name, bool control = true);
 		void stop();
+		bool getGains(struct oven_gains *gains);
+		void setAutomaticHeartbeat(bool automatic);
+		StateEstimator *getEstimator();
 
 	signals:
 		void connected();
 		void disconnected();
 		void readingsRead(struct oven_state readings, QTime timestamp);
+		void samplesRead(QVector<oven_sample> samples);
+		void estimateUpdated(double temperature, double rate, QTime timestamp);
 		void errorOccurred(int error);
+		void tripped(int reason);
+		void commandCompleted(unsigned long code, int latency_ms);
+		void commandFailed(unsigned long code, int error);
 
 	public slots:
 		void setFilamentsEnabled(bool enabled);
-		void setTargetTemperature(int temperature);
+		void setTargetTemperature(Temperature temperature);
+		void setManualDuty(int duty);
+		void setElementDuty(int top, int bottom);
+		void setBalance(int balance);
+		void setCooling(int cooling);
+		void setGains(struct oven_gains gains);
+		void heartbeat();
+		void switchOff();
 
-	protected:
-		static void register_sigio_receiver(OvenManager *receiver);
-		static void top_sigio_handler(int signal);
+	private slots:
+		void transportConnected();
+		void transportDisconnected();
+		void processState(struct oven_state state, QTime timestamp);
+		void processSamples(QVector<oven_sample> samples);
+		void brokerConnected();
+		void brokerDisconnected();
+		void brokerReadyRead();
+		void forgetCommand(unsigned long code, int error);
 
 	private:
-		void sigio_handler(int sig);
+		void forgetDevice();
+		int control(unsigned long code, int value = 0);
+		int control(unsigned long code, void *data, int size);
 
-		int _targetTemperature;
+		Temperature _targetTemperature;
+		int _topDuty;
+		int _bottomDuty;
+		int _balance;
+		int _cooling;
 		bool _filamentsEnabled;
 		bool _connected;
-		int _ioctlFd;
+		OvenTransport *_transport;
+		QLocalSocket *_brokerSocket;
+		QByteArray _brokerBuffer;
+		bool _brokerControl;
+		CommandQueue *_commands;
+		QTimer *_heartbeatTimer;
+		bool _automaticHeartbeat;
+		int _tripReason;
+		StateEstimator _estimator;
+		QTime _lastReading;
+		QVector<oven_sample> _samples;
+		qint64 _lastSampleTime;
+		double _heater;
+		struct oven_gains _gains;
 };
 
 #endif // OVENMANAGER_H
@@ -0,0 +1,132 @@
+#include <errno.h>
+#include <string.h>
+#include "kerneltransport.h"
+#include "mocktransport.h"
+#include "oventransport.h"
+#include "usbtransport.h"
+
+const char *OvenTransport::DEFAULT_TRANSPORT = "kernel";
+
+OvenTransport::OvenTransport(QObject *parent) : QObject(parent)
+{
+	qRegisterMetaType<oven_state>("oven_state");
+	qRegisterMetaType<QVector<oven_sample> >("QVector<oven_sample>");
+}
+
+QStringList OvenTransport::names()
+{
+	return QStringList() << "kernel" << "libusb" << "mock";
+}
+
+OvenTransport *OvenTransport::create(QString name, QObject *parent)
+{
+	if (name == "kernel")
+		return new KernelTransport(parent);
+	if (name == "libusb")
+		return new UsbTransport(parent);
+	if (name == "mock")
+		return new MockTransport(parent);
+	return NULL;
+}
+
+// Applies a command to the oven's settings the way the kernel driver's ioctl
+// handler does, for the backends that talk to the firmware themselves.
+// Returns 0 or an errno, and sets frame to the command (PCBOVEN_CMD_*) that
+// must be sent to the firmware, if any.
+int OvenTransport::applyCommand(struct oven_state *oven, struct oven_gains *gains, unsigned long code, QByteArray data, int *frame)
+{
+	int value = 0;
+
+	if (data.size() >= (int)sizeof(value))
+		memcpy(&value, data.constData(), sizeof(value));
+
+	*frame = PCBOVEN_CMD_SETTINGS;
+	switch (code) {
+	case PCBOVEN_HEARTBEAT:
+		*frame = PCBOVEN_CMD_HEARTBEAT;
+		break;
+	case PCBOVEN_SET_TEMPERATURE:
+		oven->target_temp = value;
+		break;
+	case PCBOVEN_ENABLE_FILAMENTS:
+		oven->enable_filaments = true;
+		oven->trip_reason = PCBOVEN_TRIP_NONE;
+		break;
+	case PCBOVEN_DISABLE_FILAMENTS:
+		oven->enable_filaments = false;
+		break;
+	case PCBOVEN_SET_DUTY:
+		if (value == PCBOVEN_DUTY_AUTOMATIC) {
+			oven->manual_duty = false;
+		} else if (value >= 0 && value <= 255) {
+			oven->manual_duty = true;
+			oven->manual_top_duty = value;
+			oven->manual_bottom_duty = value;
+		} else {
+			return EINVAL;
+		}
+		break;
+	case PCBOVEN_SET_ELEMENT_DUTY: {
+		struct oven_duty duty;
+		if (data.size() != sizeof(duty))
+			return EINVAL;
+		memcpy(&duty, data.constData(), sizeof(duty));
+		if (duty.top < 0 || duty.top > 255 || duty.bottom < 0 || duty.bottom > 255)
+			return EINVAL;
+		oven->manual_duty = true;
+		oven->manual_top_duty = duty.top;
+		oven->manual_bottom_duty = duty.bottom;
+		break;
+	}
+	case PCBOVEN_SET_BALANCE:
+		if (value < 0 || value > 255)
+			return EINVAL;
+		oven->balance = value;
+		break;
+	case PCBOVEN_SET_COOLING:
+		if (value == PCBOVEN_COOLING_AUTOMATIC) {
+			oven->manual_cooling = false;
+		} else if (value >= 0 && value <= 255) {
+			oven->manual_cooling = true;
+			oven->manual_cooling_duty = value;
+		} else {
+			return EINVAL;
+		}
+		break;
+	case PCBOVEN_SET_GAINS:
+		if (data.size() != sizeof(*gains))
+			return EINVAL;
+		memcpy(gains, data.constData(), sizeof(*gains));
+		*frame = PCBOVEN_CMD_GAINS;
+		break;
+	default:
+		return ENOTTY;
+	}
+	return 0;
+}
+
+// The kernel driver's per-reading watchdog, less the heartbeat timeout: with
+// no driver in between, the firmware's own timeout covers a host that stops.
+// Returns whether the filaments must be switched off, latching the reason.
+bool OvenTransport::checkWatchdog(struct oven_state *oven, int ceiling)
+{
+	int reason = PCBOVEN_TRIP_NONE;
+
+	if (!oven->enable_filaments)
+		return false;
+
+	if (oven->failsafe != PCBOVEN_FAILSAFE_NONE)
+		reason = PCBOVEN_TRIP_DEVICE;
+	else if (oven->fault_short_vcc || oven->fault_short_gnd || oven->fault_open_circuit)
+		reason = PCBOVEN_TRIP_FAULT;
+	else if (oven->probe_temp > ceiling << PCBOVEN_TEMP_SHIFT)
+		reason = PCBOVEN_TRIP_CEILING;
+
+	if (reason == PCBOVEN_TRIP_NONE)
+		return false;
+
+	oven->trip_reason = reason;
+	oven->enable_filaments = false;
+	oven->manual_duty = false;
+	return true;
+}
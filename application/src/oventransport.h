@@ -0,0 +1,48 @@
+#ifndef OVENTRANSPORT_H
+#define OVENTRANSPORT_H
+
+#include <QByteArray>
+#include <QMetaType>
+#include <QObject>
+#include <QStringList>
+#include <QTime>
+#include <QVector>
+#include "pcboven_usb.h"
+
+// How OvenManager reaches the oven. Commands are the driver's ioctl codes
+// and arguments, and execute() is called from the command queue's worker
+// thread. Readings and connection changes are signalled, possibly from a
+// backend's own thread. The thermocouple samples that came with a reading
+// are signalled just before it.
+class OvenTransport : public QObject
+{
+	Q_OBJECT
+
+	public:
+		explicit OvenTransport(QObject *parent = 0);
+
+		static const char *DEFAULT_TRANSPORT;
+		static QStringList names();
+		static OvenTransport *create(QString name, QObject *parent = 0);
+
+		virtual bool open() = 0;
+		virtual void close() = 0;
+		virtual int execute(unsigned long code, QByteArray data, bool byReference) = 0;
+		virtual bool getGains(struct oven_gains *gains) = 0;
+
+	signals:
+		void connected();
+		void disconnected();
+		void stateReceived(struct oven_state state, QTime timestamp);
+		void samplesReceived(QVector<oven_sample> samples);
+		void errorOccurred(int error);
+
+	protected:
+		static int applyCommand(struct oven_state *oven, struct oven_gains *gains, unsigned long code, QByteArray data, int *frame);
+		static bool checkWatchdog(struct oven_state *oven, int ceiling);
+};
+
+Q_DECLARE_METATYPE(oven_state)
+Q_DECLARE_METATYPE(oven_sample)
+
+#endif // OVENTRANSPORT_H
@@ -0,0 +1,166 @@
+#include <QStringList>
+#include "profilefeasibility.h"
+
+// The firmware's controller and automatic cooling: gains are duty counts per
+// degree C in PCBOVEN_GAIN_SHIFT fixed point, and the cooler adds COOLING_GAIN counts per degree
+// beyond COOLING_BAND above the target
+#define DUTY_MAX        255.0f
+#define GAIN_SCALE      ((float)(1 << PCBOVEN_GAIN_SHIFT))
+#define CONTROLLER_RATE 1 // updates per second, one per reading
+#define CONTROLLER_MS   (1000 / CONTROLLER_RATE)
+#define COOLING_BAND    2
+#define COOLING_GAIN    64
+
+/*
+ * With a thermal model the run is simulated: the targets that will be sent,
+ * the firmware's PID controller with the oven's gains, and the model's first
+ * order lag and dead time, with the oven's rate of change held to what it
+ * has been measured to manage. Heat still arriving through the dead time
+ * carries the oven past the top of a fast ramp or into a hold, which shows
+ * up as overshoot. Without a model the oven simply follows the profile as
+ * closely as its rates allow, so the only overshoot is from cooling too
+ * slowly.
+ *
+ * Holds wait for the oven, so only overshooting one is flagged.
+ */
+ProfileFeasibility ProfileFeasibility::check(ReflowProfile profile, QMap<QTime, Temperature> targets,
+                                             struct oven_gains gains, OvenCapability capability)
+{
+	ProfileFeasibility result;
+	QVector<ReflowProfile::Segment> segments = profile.getSegments();
+	ThermalModel model = capability.getModel();
+	int steps = profile.getDuration() * 1000 / STEP_MS + 1;
+	float step = STEP_MS / 1000.0f;
+
+	result._known = capability.isValid();
+	if (!result._known || segments.isEmpty())
+		return result;
+
+	QVector<float> reference(steps);
+	result._times.resize(steps);
+	result._predicted.resize(steps);
+	for (int i = 0; i < steps; i++)
+		result._times[i] = i * step;
+	profile.evaluate(result._times.constData(), reference.data(), steps);
+
+	bool simulated = model.isValid() && !targets.isEmpty();
+	int delay = simulated ? qRound(model.getDeadTime() / step) : 0;
+	QVector<float> power(steps, 0);
+	QMap<QTime, Temperature>::const_iterator target = targets.constBegin();
+	float setpoint = 0;
+	float integral = 0;
+	float lastInput = reference[0];
+
+	float temperature = reference[0];
+	int segment = 0;
+	Flag lag = { -1, Lag, 0, 0 };
+	Flag overshoot = { -1, Overshoot, 0, 0 };
+	for (int i = 0; i < steps; i++) {
+		float heating = capability.getHeatingRate(temperature) * step;
+		float cooling = capability.getCoolingRate(temperature) * step;
+
+		if (simulated) {
+			// Each target holds until the next one is due, and the
+			// controller updates once per reading
+			QTime now = QTime(0, 0).addMSecs(i * STEP_MS);
+			while (target + 1 != targets.constEnd() && (target + 1).key() <= now)
+				target++;
+			setpoint = temperatureToCelsius(target.value());
+			if ((i * STEP_MS) % CONTROLLER_MS == 0) {
+				float error = setpoint - temperature;
+				integral = qBound(0.0f, integral + gains.integral / GAIN_SCALE * error / CONTROLLER_RATE, DUTY_MAX);
+				float output = gains.proportional / GAIN_SCALE * error + integral -
+				               gains.derivative / GAIN_SCALE * (temperature - lastInput) * CONTROLLER_RATE;
+				lastInput = temperature;
+				power[i] = qBound(0.0f, output, DUTY_MAX) / DUTY_MAX;
+			} else if (i > 0) {
+				power[i] = power[i - 1];
+			}
+
+			float u = (i >= delay) ? power[i - delay] : 0;
+			float change = step / model.getTimeConstant() * (model.getAmbient() + model.getGain() * u - temperature);
+
+			// The model only knows passive cooling; the cooler can take
+			// the oven down as fast as it has been measured to cool
+			float passive = qMax(0.0f, (float)(step / model.getTimeConstant() * (temperature - model.getAmbient())));
+			float fan = qBound(0.0f, (temperature - setpoint - COOLING_BAND) * COOLING_GAIN / DUTY_MAX, 1.0f);
+			change -= fan * qMax(0.0f, cooling - passive);
+
+			temperature += qBound(-cooling, change, heating);
+		} else if (i > 0) {
+			temperature += qBound(-cooling, reference[i] - temperature, heating);
+		}
+		result._predicted[i] = temperature;
+
+		float time = result._times[i];
+		while (segment < segments.size() - 1 && time >= segments[segment].end)
+			segment++;
+		if (time < segments[segment].start)
+			continue;
+
+		const ReflowProfile::Segment &current = segments[segment];
+		float allowed = ALLOWED_DEVIATION + current.tolerance;
+		float deviation = temperature - reference[i];
+		if (current.type != ReflowProfile::Hold && -deviation > allowed && -deviation > lag.deviation)
+			lag = { segment, Lag, time, -deviation };
+		if (deviation > allowed && deviation > overshoot.deviation)
+			overshoot = { segment, Overshoot, time, deviation };
+
+		// One flag of each kind per segment, for its worst point
+		if (i == steps - 1 || (segment < segments.size() - 1 && result._times[i + 1] >= current.end)) {
+			if (lag.segment >= 0)
+				result._flags.append(lag);
+			if (overshoot.segment >= 0)
+				result._flags.append(overshoot);
+			lag = { -1, Lag, 0, 0 };
+			overshoot = { -1, Overshoot, 0, 0 };
+		}
+	}
+
+	return result;
+}
+
+ProfileFeasibility::ProfileFeasibility()
+{
+	_known = false;
+}
+
+bool ProfileFeasibility::isKnown()
+{
+	return _known;
+}
+
+// Profiles are assumed feasible until the oven's capabilities are known
+bool ProfileFeasibility::isFeasible()
+{
+	return _flags.isEmpty();
+}
+
+QVector<float> ProfileFeasibility::getTimes()
+{
+	return _times;
+}
+
+QVector<float> ProfileFeasibility::getPredicted()
+{
+	return _predicted;
+}
+
+QVector<ProfileFeasibility::Flag> ProfileFeasibility::getFlags()
+{
+	return _flags;
+}
+
+QString ProfileFeasibility::describe()
+{
+	QStringList problems;
+
+	foreach (const Flag &flag, _flags) {
+		problems.append(QString("segment %1 %2 by %3C at %4s")
+		                .arg(flag.segment + 1)
+		                .arg(flag.problem == Lag ? "lags" : "overshoots")
+		                .arg(flag.deviation, 0, 'f', 1)
+		                .arg(flag.time, 0, 'f', 0));
+	}
+	return problems.join(", ");
+}
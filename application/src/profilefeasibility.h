@@ -0,0 +1,57 @@
+#ifndef PROFILEFEASIBILITY_H
+#define PROFILEFEASIBILITY_H
+
+#include <QMap>
+#include <QString>
+#include <QTime>
+#include <QVector>
+#include "ovencapability.h"
+#include "pcboven_usb.h"
+#include "reflowprofile.h"
+
+// Predicts the curve the oven will follow on a profile, from its thermal
+// model and the rates it can heat and cool at, and flags the segments it
+// will lag or overshoot
+class ProfileFeasibility
+{
+	public:
+		enum Problem {
+			Lag,
+			Overshoot
+		};
+
+		// The worst deviation of a problem within a segment
+		struct Flag {
+			int segment;
+			Problem problem;
+			float time;
+			float deviation;
+		};
+
+		static const int STEP_MS = 100;
+		static const int ALLOWED_DEVIATION = 5;
+
+		// The firmware's gains until it has been tuned
+		static const int DEFAULT_GAIN_P = 16 << 8;
+		static const int DEFAULT_GAIN_I = 13;
+		static const int DEFAULT_GAIN_D = 0;
+
+		static ProfileFeasibility check(ReflowProfile profile, QMap<QTime, Temperature> targets,
+		                                struct oven_gains gains, OvenCapability capability);
+
+		ProfileFeasibility();
+		bool isKnown();
+		bool isFeasible();
+		QVector<float> getTimes();
+		QVector<float> getPredicted();
+		QVector<Flag> getFlags();
+		QString describe();
+
+	private:
+		bool _known;
+		QVector<float> _times;
+		QVector<float> _predicted;
+		QVector<Flag> _flags;
+};
+
+#endif // PROFILEFEASIBILITY_H
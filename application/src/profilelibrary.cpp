@@ -0,0 +1,264 @@
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include "builtinprofiles.h"
+#include "profilelibrary.h"
+
+#define INDEX_FILE_NAME ".pcboven-index"
+
+ProfileLibrary::ProfileLibrary(int granularity_ms, QObject *parent) : QObject(parent)
+{
+	_granularity = granularity_ms;
+	_profiles.setMaxCost(CACHED_PROFILES);
+
+	_watcher = new QFileSystemWatcher(this);
+	connect(_watcher, &QFileSystemWatcher::fileChanged, this, &ProfileLibrary::fileChanged);
+
+	// Editors tend to save by replacing files, which shows up as a burst of
+	// directory events; coalesce them into a single rescan.
+	_rescanTimer = new QTimer(this);
+	_rescanTimer->setSingleShot(true);
+	_rescanTimer->setInterval(RESCAN_DELAY_MS);
+	connect(_rescanTimer, &QTimer::timeout, this, &ProfileLibrary::rescan);
+	connect(_watcher, &QFileSystemWatcher::directoryChanged, _rescanTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+
+	// Built-in profiles are listed ahead of the directory's, whether or not
+	// one is open, and never go in its index
+	for (int i = 0; i < BuiltinProfiles::count(); i++) {
+		const BuiltinProfiles::Profile &builtin = BuiltinProfiles::at(i);
+		ReflowProfile profile = BuiltinProfiles::create(builtin);
+		Entry entry;
+		entry.fileName = BuiltinProfiles::fileName(builtin);
+		entry.title = profile.getTitle();
+		entry.duration = profile.getDuration();
+		entry.peakTemperature = profile.getPeakTemperature();
+		entry.checksum = BuiltinProfiles::checksum(builtin);
+		entry.size = 0;
+		entry.modified = 0;
+		_builtins.insert(entry.fileName, entry);
+	}
+}
+
+ProfileLibrary::~ProfileLibrary()
+{
+}
+
+bool ProfileLibrary::open(QString directory)
+{
+	QDir dir(directory);
+	if (!dir.exists())
+		return false;
+
+	if (!_watcher->directories().isEmpty())
+		_watcher->removePaths(_watcher->directories());
+	if (!_watcher->files().isEmpty())
+		_watcher->removePaths(_watcher->files());
+	foreach (const QString &fileName, _entries.keys())
+		_profiles.remove(fileName);
+	_entries.clear();
+
+	_directory = dir.canonicalPath();
+	loadIndex();
+	rescan();
+	_watcher->addPath(_directory);
+
+	return true;
+}
+
+QString ProfileLibrary::getDirectory()
+{
+	return _directory;
+}
+
+QList<ProfileLibrary::Entry> ProfileLibrary::getEntries()
+{
+	return _builtins.values() + _entries.values();
+}
+
+bool ProfileLibrary::contains(QString fileName)
+{
+	return _builtins.contains(fileName) || _entries.contains(fileName);
+}
+
+ProfileLibrary::Entry ProfileLibrary::getEntry(QString fileName)
+{
+	if (_builtins.contains(fileName))
+		return _builtins.value(fileName);
+	return _entries.value(fileName);
+}
+
+bool ProfileLibrary::getProfile(QString fileName, ReflowProfile *profile, QString *error)
+{
+	ReflowProfile *cached = _profiles.object(fileName);
+	if (cached) {
+		*profile = *cached;
+		return true;
+	}
+
+	const BuiltinProfiles::Profile *builtin = BuiltinProfiles::find(fileName);
+	if (builtin) {
+		cached = new ReflowProfile(BuiltinProfiles::create(*builtin));
+		cached->interpolate(_granularity);
+		*profile = *cached;
+		_profiles.insert(fileName, cached);
+		return true;
+	}
+
+	QFile rawProfile(QDir(_directory).filePath(fileName));
+	if (!rawProfile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		if (error)
+			*error = rawProfile.errorString();
+		return false;
+	}
+
+	QString parseError;
+	ReflowProfile parsed = ReflowProfile::parseFromJson(rawProfile.readAll(), &parseError);
+	rawProfile.close();
+	_watcher->addPath(rawProfile.fileName());
+	if (!parseError.isEmpty()) {
+		if (error)
+			*error = parseError;
+		return false;
+	}
+
+	cached = new ReflowProfile(parsed);
+	cached->interpolate(_granularity);
+
+	*profile = *cached;
+	_profiles.insert(fileName, cached);
+
+	return true;
+}
+
+void ProfileLibrary::rescan()
+{
+	QFileInfoList files = QDir(_directory).entryInfoList(QStringList("*.json"), QDir::Files | QDir::Readable, QDir::Name);
+	QMap<QString, Entry> entries;
+	bool changed = false;
+
+	foreach (const QFileInfo &info, files) {
+		QMap<QString, Entry>::const_iterator known = _entries.constFind(info.fileName());
+		if (known != _entries.constEnd() &&
+		    known->size == info.size() &&
+		    known->modified == info.lastModified().toMSecsSinceEpoch()) {
+			entries.insert(info.fileName(), *known);
+			continue;
+		}
+
+		Entry entry;
+		if (indexFile(info.fileName(), &entry)) {
+			entries.insert(info.fileName(), entry);
+			if (known != _entries.constEnd() && _profiles.remove(info.fileName()))
+				emit profileChanged(info.fileName());
+		}
+		changed = true;
+	}
+
+	if (entries.size() != _entries.size())
+		changed = true;
+
+	_entries = entries;
+	if (changed) {
+		saveIndex();
+		emit entriesChanged();
+	}
+}
+
+void ProfileLibrary::fileChanged(QString path)
+{
+	QString fileName = QFileInfo(path).fileName();
+
+	_profiles.remove(fileName);
+	if (QFileInfo(path).exists())
+		_watcher->addPath(path);
+	else
+		_watcher->removePath(path);
+
+	Entry entry;
+	if (indexFile(fileName, &entry))
+		_entries.insert(fileName, entry);
+	else
+		_entries.remove(fileName);
+	saveIndex();
+
+	emit entriesChanged();
+	emit profileChanged(fileName);
+}
+
+bool ProfileLibrary::indexFile(QString fileName, Entry *entry)
+{
+	QFile rawProfile(QDir(_directory).filePath(fileName));
+	if (!rawProfile.open(QIODevice::ReadOnly | QIODevice::Text))
+		return false;
+
+	QFileInfo info(rawProfile);
+	QByteArray json = rawProfile.readAll();
+	rawProfile.close();
+
+	ReflowProfile profile = ReflowProfile::parseFromJson(json, &entry->error);
+	entry->fileName = fileName;
+	entry->title = profile.getTitle().isEmpty() ? fileName : profile.getTitle();
+	entry->duration = profile.getDuration();
+	entry->peakTemperature = profile.getPeakTemperature();
+	entry->checksum = QCryptographicHash::hash(json, QCryptographicHash::Sha1);
+	entry->size = info.size();
+	entry->modified = info.lastModified().toMSecsSinceEpoch();
+
+	return true;
+}
+
+QString ProfileLibrary::indexPath()
+{
+	QFileInfo dir(_directory);
+	if (dir.isWritable())
+		return QDir(_directory).filePath(INDEX_FILE_NAME);
+
+	// Read-only libraries get their index in the user's cache instead
+	QString cache = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+	QDir().mkpath(cache);
+	QByteArray key = QCryptographicHash::hash(_directory.toUtf8(), QCryptographicHash::Sha1).toHex();
+	return QDir(cache).filePath(QString::fromLatin1(key) + ".index");
+}
+
+void ProfileLibrary::loadIndex()
+{
+	QFile file(indexPath());
+	if (!file.open(QIODevice::ReadOnly))
+		return;
+
+	QDataStream in(&file);
+	quint32 magic, version, count;
+	in >> magic >> version >> count;
+	if (magic != INDEX_MAGIC || version != INDEX_VERSION)
+		return;
+
+	for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+		Entry entry;
+		qint32 duration, peakTemperature;
+		in >> entry.fileName >> entry.title >> duration >> peakTemperature
+		   >> entry.checksum >> entry.size >> entry.modified >> entry.error;
+		entry.duration = duration;
+		entry.peakTemperature = peakTemperature;
+		if (in.status() == QDataStream::Ok)
+			_entries.insert(entry.fileName, entry);
+	}
+}
+
+void ProfileLibrary::saveIndex()
+{
+	QSaveFile file(indexPath());
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+
+	QDataStream out(&file);
+	out << INDEX_MAGIC << INDEX_VERSION << (quint32)_entries.size();
+	foreach (const Entry &entry, _entries) {
+		out << entry.fileName << entry.title << (qint32)entry.duration << (qint32)entry.peakTemperature
+		    << entry.checksum << entry.size << entry.modified << entry.error;
+	}
+	file.commit();
+}
@@ -0,0 +1,66 @@
+#ifndef PROFILELIBRARY_H
+#define PROFILELIBRARY_H
+
+#include <QObject>
+#include <QCache>
+#include <QMap>
+#include <QStringList>
+#include <QTimer>
+#include <QFileSystemWatcher>
+#include "reflowprofile.h"
+
+class ProfileLibrary : public QObject
+{
+	Q_OBJECT
+
+	public:
+		struct Entry {
+			QString fileName;
+			QString title;
+			int duration;
+			Temperature peakTemperature;
+			QByteArray checksum;
+			qint64 size;
+			qint64 modified;
+			QString error; // why the profile is not valid, if it is not
+		};
+
+		explicit ProfileLibrary(int granularity_ms, QObject *parent = 0);
+		virtual ~ProfileLibrary();
+
+		static const quint32 INDEX_MAGIC = 0x50434249; // "PCBI"
+		static const quint32 INDEX_VERSION = 3;
+		static const int CACHED_PROFILES = 32;
+		static const int RESCAN_DELAY_MS = 200;
+
+		bool open(QString directory);
+		QString getDirectory();
+		QList<Entry> getEntries();
+		bool contains(QString fileName);
+		Entry getEntry(QString fileName);
+		bool getProfile(QString fileName, ReflowProfile *profile, QString *error = 0);
+
+	signals:
+		void entriesChanged();
+		void profileChanged(QString fileName);
+
+	private slots:
+		void rescan();
+		void fileChanged(QString path);
+
+	private:
+		bool indexFile(QString fileName, Entry *entry);
+		QString indexPath();
+		void loadIndex();
+		void saveIndex();
+
+		int _granularity;
+		QString _directory;
+		QMap<QString, Entry> _entries;
+		QMap<QString, Entry> _builtins;
+		QCache<QString, ReflowProfile> _profiles;
+		QFileSystemWatcher *_watcher;
+		QTimer *_rescanTimer;
+};
+
+#endif // PROFILELIBRARY_H
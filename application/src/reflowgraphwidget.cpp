@@ -1,92 +1,266 @@
+#include <QMouseEvent>
 #include <QPainter>
 #include <QVector>
+#include <QWheelEvent>
 #include <QtCore/qmath.h>
 #include "reflowgraphwidget.h"
 
-#define DEGREES_PER_BAR 10.0
-#define SECONDS_PER_BAR 10.0
+// Zoom per notch of the wheel
+#define ZOOM_STEP 0.8
 
 ReflowGraphWidget::ReflowGraphWidget(QWidget *parent) : QWidget(parent)
 {
-	_temperatures = new QVector<QPair<QTime, int> >();
-	_temperatureTargets = new QVector<QPair<QTime, int> >();
 	_maxTime = 0;
 	_maxTemperature = 0;
+	_autoView = true;
+	_viewStart = _viewEnd = 0;
+	_viewLow = _viewHigh = 0;
+	_renderThread = NULL;
+	_generation = 0;
+	_rendering = false;
+	_stale = false;
 	setContentsMargins(10, 10, 10, 10);
 }
 
-void ReflowGraphWidget::setTemperatureTargets(QMap<QTime, int> targets)
+ReflowGraphWidget::~ReflowGraphWidget()
 {
-	_temperatureTargets->clear();
-	for (QMap<QTime, int>::const_iterator i = targets.constBegin(); i != targets.constEnd(); i++) {
-		_temperatureTargets->append(QPair<QTime, int>(i.key(), i.value()));
-		if (i.value() > _maxTemperature)
-			_maxTemperature = i.value();
+	setThreadedRendering(false);
+}
+
+// In threaded mode the graph is rasterized on a worker thread and paintEvent
+// only blits the last finished frame, so long traces never hold up the GUI.
+void ReflowGraphWidget::setThreadedRendering(bool threaded)
+{
+	if (threaded == (_renderThread != NULL))
+		return;
+
+	if (threaded) {
+		qRegisterMetaType<GraphRenderer::Frame>();
+		_renderThread = new QThread(this);
+		GraphRenderer *renderer = new GraphRenderer();
+		renderer->moveToThread(_renderThread);
+		connect(_renderThread, &QThread::finished, renderer, &QObject::deleteLater);
+		connect(this, &ReflowGraphWidget::frameRequested, renderer, &GraphRenderer::render);
+		connect(renderer, &GraphRenderer::rendered, this, &ReflowGraphWidget::frameRendered);
+		_renderThread->start();
+		invalidate();
+	} else {
+		_renderThread->quit();
+		_renderThread->wait();
+		delete _renderThread;
+		_renderThread = NULL;
+		_frame = QImage();
+		_rendering = false;
+		update();
 	}
-	_maxTime = QTime(0, 0).secsTo(_temperatureTargets->last().first);
+}
+
+void ReflowGraphWidget::setProfile(ReflowProfile profile)
+{
+	_profile = profile;
+	_maxTemperature = qMax(_profile.getPeakTemperature(), celsiusToTemperature(_temperatures.getMaximum()));
+	_maxTime = _profile.getDuration();
+
+	updateView();
+}
 
-	repaint();
+void ReflowGraphWidget::setPrediction(QVector<float> times, QVector<float> temperatures)
+{
+	_prediction.clear();
+	for (int i = 0; i < times.size(); i++)
+		_prediction.append(times[i], temperatures[i]);
+	invalidate();
+}
+
+void ReflowGraphWidget::addOverlay(QString title, RunRecording run)
+{
+	QVector<float> times = run.getTimes();
+	QVector<float> probe = run.getProbe();
+	SampleIndex overlay;
+
+	for (int i = 0; i < times.size(); i++)
+		overlay.append(times[i], probe[i]);
+	_overlays.append(overlay);
+	_overlayTitles.append(title);
+	updateView();
+}
+
+void ReflowGraphWidget::clearOverlays()
+{
+	_overlays.clear();
+	_overlayTitles.clear();
+	updateView();
 }
 
-void ReflowGraphWidget::addTemperature(QTime time, int temperature)
+void ReflowGraphWidget::addTemperature(QTime time, Temperature temperature)
 {
-	_temperatures->append(QPair<QTime, int>(time, temperature));
+	_temperatures.append(QTime(0, 0).msecsTo(time) / 1000.0f, temperatureToCelsius(temperature));
 	if (temperature > _maxTemperature)
 		_maxTemperature = temperature;
-	repaint();
+	updateView();
+}
+
+void ReflowGraphWidget::addEstimate(QTime time, float temperature)
+{
+	_estimates.append(QTime(0, 0).msecsTo(time) / 1000.0f, temperature);
+	updateView();
 }
 
 void ReflowGraphWidget::clearGraph()
 {
-	_temperatures->clear();
-	repaint();
+	_temperatures.clear();
+	_estimates.clear();
+	updateView();
 }
 
-void ReflowGraphWidget::paintEvent(QPaintEvent *)
+void ReflowGraphWidget::resetView()
 {
-	QPainter painter(this);
-	painter.setRenderHint(QPainter::Antialiasing);
-	painter.setBackground(QBrush(Qt::white));
-	painter.setBackgroundMode(Qt::OpaqueMode);
-	painter.fillRect(contentsRect(), painter.background());
-
-	// Draw grid
-	painter.setPen(QPen(QBrush(QColor(200, 200, 200)), 1));
-	QVector<QLineF> gridLines;
-	int divisions = qCeil(_maxTime/SECONDS_PER_BAR);
-	for (int i = 0; i <= divisions; i++)
-		gridLines.append(QLineF((double)contentsRect().width()/divisions*i + contentsRect().left(),
-		                        (double)contentsRect().top(),
-		                        (double)contentsRect().width()/divisions*i + contentsRect().left(),
-		                        (double)contentsRect().bottom()));
-	divisions = qCeil(_maxTemperature/DEGREES_PER_BAR);
-	for (int i = 0; i <= divisions; i++)
-		gridLines.append(QLineF((double)contentsRect().left(),
-		                        (double)contentsRect().height()/divisions*i + contentsRect().top(),
-		                        (double)contentsRect().right(),
-		                        (double)contentsRect().height()/divisions*i + contentsRect().top()));
-	painter.drawLines(gridLines);
-
-	// Draw target temp
-	if (!_temperatureTargets->empty()) {
-		painter.setPen(QPen(QBrush(QColor(150, 150, 255)), 2));
-		QPainterPath patha(QPointF(contentsRect().left(),
-		                           contentsRect().bottom() - (double)_temperatureTargets->first().second/_maxTemperature*contentsRect().height()));
-		for (int i = 1; i < _temperatureTargets->size(); i++)
-			patha.lineTo((double)contentsRect().width()*QTime(0, 0).secsTo(_temperatureTargets->at(i).first)/_maxTime + contentsRect().left(),
-			             contentsRect().bottom() - (double)_temperatureTargets->at(i).second/_maxTemperature*contentsRect().height());
-		painter.drawPath(patha);
+	_autoView = true;
+	updateView();
+}
+
+// Until the user zooms or pans, the view follows the whole profile and every
+// trace on the graph
+void ReflowGraphWidget::updateView()
+{
+	if (_autoView) {
+		double end = qMax((double)_maxTime, (double)_temperatures.getEnd());
+		double high = temperatureToCelsius(_maxTemperature);
+		for (int i = 0; i < _overlays.size(); i++) {
+			end = qMax(end, (double)_overlays[i].getEnd());
+			high = qMax(high, (double)_overlays[i].getMaximum());
+		}
+
+		_viewStart = 0;
+		_viewEnd = qMax(end, MIN_TIME_SPAN_MS / 1000.0);
+		_viewLow = 0;
+		_viewHigh = qMax(high, (double)MIN_TEMPERATURE_SPAN);
+	}
+	invalidate();
+}
+
+GraphRenderer::Frame ReflowGraphWidget::snapshot()
+{
+	GraphRenderer::Frame frame;
+	frame.size = size();
+	frame.contents = contentsRect();
+	frame.profile = _profile;
+	frame.prediction = _prediction;
+	frame.temperatures = _temperatures;
+	frame.estimates = _estimates;
+	frame.overlays = _overlays;
+	frame.overlayTitles = _overlayTitles;
+	frame.viewStart = _viewStart;
+	frame.viewEnd = _viewEnd;
+	frame.viewLow = _viewLow;
+	frame.viewHigh = _viewHigh;
+	frame.generation = ++_generation;
+	return frame;
+}
+
+// At most one frame is in flight; changes made meanwhile are folded into the
+// next one rather than queueing a frame per sample.
+void ReflowGraphWidget::invalidate()
+{
+	if (!_renderThread) {
+		update();
+		return;
 	}
 
-	// Draw actual temp
-	if (!_temperatures->empty()) {
-		painter.setPen(QPen(QBrush(QColor(200, 0, 0)), 2));
-		QPainterPath patha(QPointF(contentsRect().left(),
-		                           contentsRect().bottom() - (double)_temperatures->first().second/_maxTemperature*contentsRect().height()));
-		for (int i = 1; i < _temperatures->size(); i++)
-			patha.lineTo((double)contentsRect().width()*QTime(0, 0).secsTo(_temperatures->at(i).first)/_maxTime + contentsRect().left(),
-			             contentsRect().bottom() - (double)_temperatures->at(i).second/_maxTemperature*contentsRect().height());
-		painter.drawPath(patha);
+	if (_rendering) {
+		_stale = true;
+		return;
 	}
+
+	_rendering = true;
+	_stale = false;
+	emit frameRequested(snapshot());
+}
+
+void ReflowGraphWidget::frameRendered(QImage image, quint64 generation)
+{
+	// Frames from before the last toggle of the render mode are dropped
+	if (!_renderThread || generation != _generation)
+		return;
+
+	_frame = image;
+	_rendering = false;
+	update();
+	if (_stale)
+		invalidate();
+}
+
+void ReflowGraphWidget::resizeEvent(QResizeEvent *)
+{
+	invalidate();
+}
+
+void ReflowGraphWidget::wheelEvent(QWheelEvent *event)
+{
+	QRect contents = contentsRect();
+	double factor = qPow(ZOOM_STEP, event->angleDelta().y() / 120.0);
+
+	if (contents.width() < 2 || contents.height() < 2 || factor == 1)
+		return;
+
+	// The point under the cursor stays put
+	_autoView = false;
+	if (event->modifiers() & Qt::ShiftModifier) {
+		double anchor = _viewLow + (double)(contents.bottom() - event->pos().y()) / contents.height() * (_viewHigh - _viewLow);
+		double span = qMax((_viewHigh - _viewLow) * factor, (double)MIN_TEMPERATURE_SPAN);
+		double ratio = (anchor - _viewLow) / (_viewHigh - _viewLow);
+		_viewLow = anchor - ratio * span;
+		_viewHigh = _viewLow + span;
+	} else {
+		double anchor = _viewStart + (double)(event->pos().x() - contents.left()) / contents.width() * (_viewEnd - _viewStart);
+		double span = qMax((_viewEnd - _viewStart) * factor, MIN_TIME_SPAN_MS / 1000.0);
+		double ratio = (anchor - _viewStart) / (_viewEnd - _viewStart);
+		_viewStart = anchor - ratio * span;
+		_viewEnd = _viewStart + span;
+	}
+	event->accept();
+	invalidate();
+}
+
+void ReflowGraphWidget::mousePressEvent(QMouseEvent *event)
+{
+	_dragPosition = event->pos();
+}
+
+void ReflowGraphWidget::mouseMoveEvent(QMouseEvent *event)
+{
+	QRect contents = contentsRect();
+
+	if (!(event->buttons() & Qt::LeftButton) || contents.width() < 2 || contents.height() < 2)
+		return;
+
+	QPoint delta = event->pos() - _dragPosition;
+	double dt = (double)delta.x() / contents.width() * (_viewEnd - _viewStart);
+	double dv = (double)delta.y() / contents.height() * (_viewHigh - _viewLow);
+	_dragPosition = event->pos();
+	_autoView = false;
+	_viewStart -= dt;
+	_viewEnd -= dt;
+	_viewLow += dv;
+	_viewHigh += dv;
+	invalidate();
+}
+
+void ReflowGraphWidget::mouseDoubleClickEvent(QMouseEvent *)
+{
+	resetView();
 }
 
+void ReflowGraphWidget::paintEvent(QPaintEvent *)
+{
+	QPainter painter(this);
+
+	if (!_renderThread) {
+		GraphRenderer::draw(&painter, snapshot());
+		return;
+	}
+
+	// Until a frame of the new size arrives the last one is stretched over it
+	if (!_frame.isNull())
+		painter.drawImage(rect(), _frame);
+}
@@ -2,31 +2,78 @@
 #define REFLOWGRAPHWIDGET_H
 
 #include <QWidget>
-#include <QMap>
+#include <QImage>
+#include <QPoint>
+#include <QStringList>
+#include <QThread>
 #include <QTime>
-#include <QPair>
+#include "graphrenderer.h"
+#include "reflowprofile.h"
+#include "runrecording.h"
+#include "sampleindex.h"
 
+// Wheel zooms the time axis around the cursor (with Shift, the temperature
+// axis), dragging pans and a double click returns to the whole run.
 class ReflowGraphWidget : public QWidget
 {
 	Q_OBJECT
 
 	public:
 		explicit ReflowGraphWidget(QWidget *parent = 0);
-		void setTemperatureTargets(QMap<QTime, int> targets);
+		virtual ~ReflowGraphWidget();
+		void setProfile(ReflowProfile profile);
+		void setPrediction(QVector<float> times, QVector<float> temperatures);
+		void setThreadedRendering(bool threaded);
+		void addOverlay(QString title, RunRecording run);
+		void clearOverlays();
+
+		static const int MIN_TIME_SPAN_MS = 500;
+		static const int MIN_TEMPERATURE_SPAN = 1;
 
 	signals:
+		void frameRequested(GraphRenderer::Frame frame);
 
 	public slots:
-		void addTemperature(QTime time, int temperature);
+		void addTemperature(QTime time, Temperature temperature);
+		void addEstimate(QTime time, float temperature);
 		void clearGraph();
+		void resetView();
+
+	private slots:
+		void frameRendered(QImage image, quint64 generation);
 
 	protected:
 		virtual void paintEvent(QPaintEvent *);
-		QVector<QPair<QTime, int> > *_temperatures;
-		QVector<QPair<QTime, int> > *_temperatureTargets;
+		virtual void resizeEvent(QResizeEvent *);
+		virtual void wheelEvent(QWheelEvent *event);
+		virtual void mousePressEvent(QMouseEvent *event);
+		virtual void mouseMoveEvent(QMouseEvent *event);
+		virtual void mouseDoubleClickEvent(QMouseEvent *event);
+		GraphRenderer::Frame snapshot();
+		void updateView();
+		void invalidate();
+
+		SampleIndex _prediction;
+		SampleIndex _temperatures;
+		SampleIndex _estimates;
+		QVector<SampleIndex> _overlays;
+		QStringList _overlayTitles;
+		ReflowProfile _profile;
 		unsigned int _maxTime;
-		int _maxTemperature;
+		Temperature _maxTemperature;
+
+		bool _autoView;
+		double _viewStart;
+		double _viewEnd;
+		double _viewLow;
+		double _viewHigh;
+		QPoint _dragPosition;
+
+		QThread *_renderThread;
+		QImage _frame;
+		quint64 _generation;
+		bool _rendering;
+		bool _stale;
 };
 
 #endif // REFLOWGRAPHWIDGET_H
-
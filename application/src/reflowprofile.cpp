@@ -1,13 +1,59 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <algorithm>
 #include "reflowprofile.h"
 
-ReflowProfile ReflowProfile::parseFromJson(QByteArray json)
+// Share of the heating done by the top element
+#define DEFAULT_BALANCE 0.5
+
+static bool segment_ends_before(float time, const ReflowProfile::Segment &segment)
+{
+	return time < segment.end;
+}
+
+QString ReflowProfile::describe(Validation validation)
+{
+	QString waypoint = QString("waypoint %1").arg(validation.waypoint + 1);
+
+	switch (validation.violation) {
+	case Valid:
+		return QString();
+	case TooFewWaypoints:
+		return "it has fewer than two waypoints";
+	case TimestampOrder:
+		return waypoint + " does not come after the one before it";
+	case TemperatureRange:
+		return waypoint + QString(" is outside 0-%1C").arg(MAX_TEMPERATURE);
+	case HeatingRate:
+		return waypoint + QString(" heats faster than %1C/s").arg(MAX_HEATING_RATE);
+	case CoolingRate:
+		return waypoint + QString(" cools faster than %1C/s").arg(MAX_COOLING_RATE);
+	case ToleranceRange:
+		return waypoint + " has a negative tolerance";
+	case BalanceRange:
+		return waypoint + " has a balance outside 0-1";
+	}
+	return "it is not a valid profile";
+}
+
+/*
+ * Profiles that are not valid JSON or break the rules in validate() come
+ * back without waypoints, keeping their title, and with the reason in error.
+ */
+ReflowProfile ReflowProfile::parseFromJson(QByteArray json, QString *error)
 {
-	QMap<QTime, int> profile;
-	QJsonParseError error;
-	QJsonDocument doc = QJsonDocument::fromJson(json, &error);
+	QVector<Waypoint> profile;
+	QJsonParseError parseError;
+	QJsonDocument doc = QJsonDocument::fromJson(json, &parseError);
+
+	if (doc.isNull() || !doc.isObject()) {
+		if (error && doc.isNull())
+			*error = QString("%1 at offset %2").arg(parseError.errorString()).arg(parseError.offset);
+		else if (error)
+			*error = "it is not a JSON object";
+		return ReflowProfile();
+	}
 
 	QJsonObject obj = doc.object();
 	QString title = obj["title"].toString();
@@ -15,36 +61,148 @@ ReflowProfile ReflowProfile::parseFromJson(QByteArray json)
 	QJsonValue node;
 	foreach (node, waypoints) {
 		QJsonObject waypoint = node.toObject();
-		int time = waypoint["timestamp"].toDouble();
-		int temp = waypoint["temperature"].toDouble();
-		profile.insert(QTime(0, 0).addSecs(time), temp);
+		QString segment = waypoint["segment"].toString("linear");
+		Waypoint step;
+		step.segment = Linear;
+		step.timestamp = waypoint["timestamp"].toDouble();
+		step.temperature = waypoint["temperature"].toDouble();
+		step.tolerance = 0;
+		step.balance = waypoint["balance"].toDouble(DEFAULT_BALANCE);
+
+		if (segment == "cubic") {
+			step.segment = Cubic;
+		} else if (segment == "ramp" && !profile.isEmpty()) {
+			// Ramp at a fixed rate (C/s) from the previous waypoint until the target is reached
+			double rate = qAbs(waypoint["rate"].toDouble());
+			step.segment = Ramp;
+			if (rate > 0)
+				step.timestamp = profile.last().timestamp + qAbs(step.temperature - profile.last().temperature) / rate;
+		} else if (segment == "hold" && !profile.isEmpty()) {
+			// Hold the previous temperature for at least the duration, until within tolerance
+			step.segment = Hold;
+			step.temperature = profile.last().temperature;
+			step.tolerance = waypoint["tolerance"].toDouble(HOLD_DEFAULT_TOLERANCE);
+			if (waypoint.contains("duration"))
+				step.timestamp = profile.last().timestamp + waypoint["duration"].toDouble();
+		}
+
+		profile.append(step);
 	}
 
+	Validation validation = validate(profile.constData(), profile.size());
+	if (validation.violation != Valid) {
+		if (error)
+			*error = describe(validation);
+		return ReflowProfile(title, QVector<Waypoint>());
+	}
+
+	if (error)
+		error->clear();
 	return ReflowProfile(title, profile);
 }
 
 ReflowProfile::ReflowProfile()
 {
+	_initialTemperature = 0;
 }
 
-ReflowProfile::ReflowProfile(QString title, QMap<QTime, int> profile)
+ReflowProfile::ReflowProfile(QString title, QMap<QTime, Temperature> profile)
 {
+	QVector<Waypoint> waypoints;
+	for (QMap<QTime, Temperature>::const_iterator i = profile.constBegin(); i != profile.constEnd(); i++) {
+		Waypoint step;
+		step.segment = Linear;
+		step.timestamp = QTime(0, 0).msecsTo(i.key()) / 1000.0;
+		step.temperature = temperatureToCelsius(i.value());
+		step.tolerance = 0;
+		step.balance = DEFAULT_BALANCE;
+		waypoints.append(step);
+	}
+
 	_title = title;
-	_profile = profile;
+	buildSegments(waypoints);
+}
+
+ReflowProfile::ReflowProfile(QString title, QVector<Waypoint> waypoints)
+{
+	_title = title;
+	buildSegments(waypoints);
+}
+
+void ReflowProfile::buildSegments(QVector<Waypoint> waypoints)
+{
+	int count = waypoints.size();
+
+	_profile.clear();
+	_segments.clear();
+	_initialTemperature = count ? waypoints.first().temperature : 0;
+	foreach (const Waypoint &step, waypoints)
+		_profile.insert(QTime(0, 0).addMSecs(qRound(step.timestamp * 1000)), celsiusToTemperature(step.temperature));
+
+	if (count < 2)
+		return;
+
+	for (int k = 0; k < count - 1; k++) {
+		const Waypoint &from = waypoints[k];
+		const Waypoint &to = waypoints[k + 1];
+		double h = to.timestamp - from.timestamp;
+		if (h <= 0)
+			continue;
+
+		Segment segment;
+		segment.type = to.segment;
+		segment.start = from.timestamp;
+		segment.end = to.timestamp;
+		segment.tolerance = to.tolerance;
+		segment.balance = to.balance;
+		segment.coefficients[0] = from.temperature;
+		segment.coefficients[1] = 0;
+		segment.coefficients[2] = 0;
+		segment.coefficients[3] = 0;
+
+		switch (to.segment) {
+		case Hold:
+			break;
+		case Cubic: {
+			double d = secant(waypoints.constData(), k);
+			double m0 = 0, m1 = 0;
+			cubicTangents(waypoints.constData(), count, k, &m0, &m1);
+			segment.coefficients[1] = m0;
+			segment.coefficients[2] = (3 * d - 2 * m0 - m1) / h;
+			segment.coefficients[3] = (m0 + m1 - 2 * d) / (h * h);
+			break;
+		}
+		case Linear:
+		case Ramp:
+		default:
+			segment.coefficients[1] = secant(waypoints.constData(), k);
+			break;
+		}
+
+		_segments.append(segment);
+	}
 }
 
 void ReflowProfile::interpolate(int granularity_ms)
 {
-	QMap<QTime, int>::const_iterator thisStep;
-	QMap<QTime, int>::const_iterator nextStep;
-	QMap<QTime, int> newSteps;
+	QMap<QTime, Temperature>::const_iterator thisStep;
+	QMap<QTime, Temperature>::const_iterator nextStep;
+	QMap<QTime, Temperature> newSteps;
+	QVector<QTime> keys;
+	QVector<float> times;
 
 	for (thisStep = _profile.constBegin(), nextStep = thisStep + 1; nextStep != _profile.constEnd(); thisStep++, nextStep++) {
-		double tempStep = (double)(nextStep.value() - thisStep.value()) / thisStep.key().msecsTo(nextStep.key());
-		for (int t = granularity_ms; t < thisStep.key().msecsTo(nextStep.key()); t += granularity_ms)
-			newSteps.insert(thisStep.key().addMSecs(t), thisStep.value() + tempStep*t);
+		for (int t = granularity_ms; t < thisStep.key().msecsTo(nextStep.key()); t += granularity_ms) {
+			keys.append(thisStep.key().addMSecs(t));
+			times.append(QTime(0, 0).msecsTo(keys.last()) / 1000.0f);
+		}
 	}
 
+	QVector<float> temperatures(times.size());
+	evaluate(times.constData(), temperatures.data(), times.size());
+	for (int i = 0; i < keys.size(); i++)
+		newSteps.insert(keys[i], celsiusToTemperature(temperatures[i]));
+
 	_profile.unite(newSteps);
 }
 
@@ -53,8 +211,118 @@ QString ReflowProfile::getTitle()
 	return _title;
 }
 
-QMap<QTime, int> ReflowProfile::getProfile()
+QMap<QTime, Temperature> ReflowProfile::getProfile()
 {
 	return _profile;
 }
 
+QVector<ReflowProfile::Segment> ReflowProfile::getSegments()
+{
+	return _segments;
+}
+
+int ReflowProfile::getDuration()
+{
+	if (_profile.isEmpty())
+		return 0;
+	return QTime(0, 0).secsTo(_profile.lastKey());
+}
+
+Temperature ReflowProfile::getPeakTemperature()
+{
+	Temperature peak = 0;
+	for (QMap<QTime, Temperature>::const_iterator i = _profile.constBegin(); i != _profile.constEnd(); i++) {
+		if (i.value() > peak)
+			peak = i.value();
+	}
+	return peak;
+}
+
+int ReflowProfile::segmentAt(float time)
+{
+	if (_segments.isEmpty() || time < _segments.first().start)
+		return -1;
+
+	QVector<Segment>::const_iterator segment = std::upper_bound(_segments.constBegin(), _segments.constEnd(), time, segment_ends_before);
+	if (segment == _segments.constEnd())
+		return _segments.size() - 1;
+	return segment - _segments.constBegin();
+}
+
+float ReflowProfile::temperatureAt(float time)
+{
+	float temperature;
+	evaluate(&time, &temperature, 1);
+	return temperature;
+}
+
+/*
+ * Where a run can join the profile with the oven already at a temperature:
+ * the point on the opening climb (the first segment, up to the first
+ * waypoint) that reaches it, so that preheat overlaps the previous run's
+ * cooldown. Returns -1 if the oven is hotter than that climb goes.
+ */
+float ReflowProfile::entryTime(float temperature)
+{
+	if (temperature <= _initialTemperature || _segments.isEmpty())
+		return 0;
+
+	Segment climb = _segments.first();
+	if (climb.type == Hold || temperatureAt(climb.end) < temperature)
+		return -1;
+
+	// Segments are monotone, so bisect to a tenth of a second
+	float low = climb.start, high = climb.end;
+	while (high - low > 0.1f) {
+		float middle = (low + high) / 2;
+		if (temperatureAt(middle) < temperature)
+			low = middle;
+		else
+			high = middle;
+	}
+	return high;
+}
+
+void ReflowProfile::evaluate(const float *times, float *temperatures, int count)
+{
+	int i = 0;
+
+	if (_segments.isEmpty()) {
+		for (; i < count; i++)
+			temperatures[i] = _initialTemperature;
+		return;
+	}
+
+	// Times are expected in ascending order, so the segments are walked once
+	// and each run of samples within a segment is a plain polynomial loop.
+	const Segment *segment = _segments.constData();
+	const Segment *last = segment + _segments.size() - 1;
+
+	for (; i < count && times[i] < segment->start; i++)
+		temperatures[i] = _initialTemperature;
+
+	while (i < count) {
+		while (segment < last && times[i] >= segment->end)
+			segment++;
+
+		int end = i;
+		if (segment == last) {
+			end = count;
+		} else {
+			while (end < count && times[end] < segment->end)
+				end++;
+		}
+
+		const float start = segment->start;
+		const float span = segment->end - segment->start;
+		const float a = segment->coefficients[0];
+		const float b = segment->coefficients[1];
+		const float c = segment->coefficients[2];
+		const float d = segment->coefficients[3];
+		for (int k = i; k < end; k++) {
+			float t = qBound(0.0f, times[k] - start, span);
+			temperatures[k] = a + t * (b + t * (c + t * d));
+		}
+		i = end;
+	}
+}
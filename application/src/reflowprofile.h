@@ -4,22 +4,200 @@
 #include <QString>
 #include <QMap>
 #include <QTime>
+#include <QVector>
+#include "temperature.h"
 
 class ReflowProfile
 {
 	public:
-		static ReflowProfile parseFromJson(QByteArray json);
+		enum SegmentType {
+			Linear,
+			Cubic,
+			Ramp,
+			Hold
+		};
+
+		// A waypoint describes the segment leading into it from the previous one
+		struct Waypoint {
+			SegmentType segment;
+			double timestamp;
+			double temperature;
+			double tolerance;
+			double balance;
+		};
+
+		// Segments are cubics in the seconds elapsed since their start,
+		// temperature = c[0] + c[1]*t + c[2]*t^2 + c[3]*t^3
+		struct Segment {
+			SegmentType type;
+			float start;
+			float end;
+			float coefficients[4];
+			float tolerance;
+			float balance;
+		};
+
+		static const int HOLD_DEFAULT_TOLERANCE = 5;
+
+		// Limits every profile is held to, built in or loaded: J-STD-020's
+		// peak temperature (C) and ramp rates (C/s) between waypoints
+		static constexpr double MAX_TEMPERATURE = 260;
+		static constexpr double MAX_HEATING_RATE = 3;
+		static constexpr double MAX_COOLING_RATE = 6;
+
+		enum Violation {
+			Valid,
+			TooFewWaypoints,
+			TimestampOrder,
+			TemperatureRange,
+			HeatingRate,
+			CoolingRate,
+			ToleranceRange,
+			BalanceRange
+		};
+
+		// The first rule a profile breaks, and the waypoint breaking it
+		struct Validation {
+			Violation violation;
+			int waypoint;
+		};
+
+		static constexpr Validation validate(const Waypoint *waypoints, int count);
+		static QString describe(Validation validation);
+		static ReflowProfile parseFromJson(QByteArray json, QString *error = 0);
 
 		ReflowProfile();
-		ReflowProfile(QString title, QMap<QTime, int> profile);
+		ReflowProfile(QString title, QMap<QTime, Temperature> profile);
+		ReflowProfile(QString title, QVector<Waypoint> waypoints);
 		void interpolate(int granularity_ms);
 		QString getTitle();
-		QMap<QTime, int> getProfile();
+		QMap<QTime, Temperature> getProfile();
+		QVector<Segment> getSegments();
+		int getDuration();
+		Temperature getPeakTemperature();
+		int segmentAt(float time);
+		float temperatureAt(float time);
+		float entryTime(float temperature);
+		void evaluate(const float *times, float *temperatures, int count);
 
 	private:
+		static constexpr double secant(const Waypoint *waypoints, int k);
+		static constexpr double tangent(const Waypoint *waypoints, int count, int k);
+		static constexpr void cubicTangents(const Waypoint *waypoints, int count, int k, double *m0, double *m1);
+		static constexpr double squareRoot(double x);
+		void buildSegments(QVector<Waypoint> waypoints);
+
 		QString _title;
-		QMap<QTime, int> _profile;
+		QMap<QTime, Temperature> _profile;
+		QVector<Segment> _segments;
+		float _initialTemperature;
 };
 
-#endif // REFLOWPROFILE_H
+// Slope of the secant from waypoint k to the next
+constexpr double ReflowProfile::secant(const Waypoint *waypoints, int k)
+{
+	double h = waypoints[k + 1].timestamp - waypoints[k].timestamp;
+	return (h > 0) ? (waypoints[k + 1].temperature - waypoints[k].temperature) / h : 0;
+}
+
+// Knot tangents (Fritsch-Butland) for the monotone cubics. Knots at a local
+// extremum or next to a hold get a flat tangent, so the curve eases into
+// soak and peak rather than overshooting them.
+constexpr double ReflowProfile::tangent(const Waypoint *waypoints, int count, int k)
+{
+	if (k == 0)
+		return secant(waypoints, 0);
+	if (k == count - 1)
+		return secant(waypoints, count - 2);
+
+	double h0 = waypoints[k].timestamp - waypoints[k - 1].timestamp;
+	double h1 = waypoints[k + 1].timestamp - waypoints[k].timestamp;
+	double d0 = secant(waypoints, k - 1);
+	double d1 = secant(waypoints, k);
+	if (d0 * d1 <= 0 || h0 <= 0 || h1 <= 0)
+		return 0;
+	return 3 * (h0 + h1) / ((2 * h1 + h0) / d0 + (h1 + 2 * h0) / d1);
+}
 
+// The tangents at either end of the cubic from waypoint k to the next, with
+// the Fritsch-Carlson limit that keeps the Hermite segment monotone
+constexpr void ReflowProfile::cubicTangents(const Waypoint *waypoints, int count, int k, double *m0, double *m1)
+{
+	double d = secant(waypoints, k);
+
+	*m0 = tangent(waypoints, count, k);
+	*m1 = tangent(waypoints, count, k + 1);
+	if (d == 0) {
+		*m0 = *m1 = 0;
+		return;
+	}
+
+	double alpha = *m0 / d;
+	double beta = *m1 / d;
+	if (alpha * alpha + beta * beta > 9) {
+		double tau = 3 / squareRoot(alpha * alpha + beta * beta);
+		*m0 = tau * alpha * d;
+		*m1 = tau * beta * d;
+	}
+}
+
+// Newton's method, as std::sqrt is not constexpr
+constexpr double ReflowProfile::squareRoot(double x)
+{
+	double root = x > 1 ? x : 1;
+	for (int i = 0; i < 64; i++)
+		root = (root + x / root) / 2;
+	return root;
+}
+
+/*
+ * Usable in constant expressions, so built-in profiles are checked at compile
+ * time. Cubic segments can be steeper between their waypoints than the secant,
+ * so their rates are checked at the steepest point of the Hermite cubic.
+ */
+constexpr ReflowProfile::Validation ReflowProfile::validate(const Waypoint *waypoints, int count)
+{
+	if (count < 2)
+		return {TooFewWaypoints, 0};
+
+	for (int k = 0; k < count; k++) {
+		const Waypoint &step = waypoints[k];
+		if (step.temperature < 0 || step.temperature > MAX_TEMPERATURE)
+			return {TemperatureRange, k};
+		if (step.tolerance < 0)
+			return {ToleranceRange, k};
+		if (step.balance < 0 || step.balance > 1)
+			return {BalanceRange, k};
+		if (k == 0)
+			continue;
+
+		double span = step.timestamp - waypoints[k - 1].timestamp;
+		double rise = step.temperature - waypoints[k - 1].temperature;
+		if (span <= 0)
+			return {TimestampOrder, k};
+
+		double steepest = rise / span;
+		double shallowest = rise / span;
+		if (step.segment == Cubic) {
+			// The derivative m0 + 2*c2*t + 3*c3*t^2 peaks at an end or its vertex
+			double m0 = 0, m1 = 0;
+			cubicTangents(waypoints, count, k - 1, &m0, &m1);
+			double c2 = (3 * rise / span - 2 * m0 - m1) / span;
+			double c3 = (m0 + m1 - 2 * rise / span) / (span * span);
+			steepest = m0 > m1 ? m0 : m1;
+			shallowest = m0 < m1 ? m0 : m1;
+			if (c3 != 0 && -c2 / (3 * c3) > 0 && -c2 / (3 * c3) < span) {
+				double vertex = m0 - c2 * c2 / (3 * c3);
+				steepest = vertex > steepest ? vertex : steepest;
+				shallowest = vertex < shallowest ? vertex : shallowest;
+			}
+		}
+		if (steepest > MAX_HEATING_RATE)
+			return {HeatingRate, k};
+		if (-shallowest > MAX_COOLING_RATE)
+			return {CoolingRate, k};
+	}
+	return {Valid, -1};
+}
+
+#endif // REFLOWPROFILE_H
@@ -0,0 +1,145 @@
+#include <QDir>
+#include <QFileInfo>
+#include <QtConcurrent>
+#include <QtCore/qmath.h>
+#include <math.h>
+#include "runanalytics.h"
+
+// Time within [low, high] while a sample interval moves linearly from a to b
+static float time_within(float a, float b, float dt, float low, float high)
+{
+	if (a == b)
+		return (a >= low && a <= high) ? dt : 0;
+
+	float from = qBound(0.0f, (low - a) / (b - a), 1.0f);
+	float to = qBound(0.0f, (high - a) / (b - a), 1.0f);
+	return qAbs(to - from) * dt;
+}
+
+struct AnalyzeFile
+{
+	typedef RunAnalytics::Metrics result_type;
+
+	AnalyzeFile(RunAnalytics::Settings settings) : settings(settings) {}
+
+	RunAnalytics::Metrics operator()(const QString &fileName) const
+	{
+		bool ok;
+		RunAnalytics::Metrics metrics = RunAnalytics::analyze(RunRecording::load(fileName, &ok), settings);
+		metrics.fileName = fileName;
+		metrics.valid = metrics.valid && ok;
+		return metrics;
+	}
+
+	RunAnalytics::Settings settings;
+};
+
+RunAnalytics::Settings RunAnalytics::defaultSettings()
+{
+	Settings settings;
+	settings.liquidus = DEFAULT_LIQUIDUS;
+	settings.soakMinimum = DEFAULT_SOAK_MINIMUM;
+	settings.soakMaximum = DEFAULT_SOAK_MAXIMUM;
+	settings.rateWindow = DEFAULT_RATE_WINDOW;
+	return settings;
+}
+
+RunAnalytics::Metrics RunAnalytics::analyze(RunRecording run, Settings settings)
+{
+	QVector<float> times = run.getTimes();
+	QVector<float> probe = run.getProbe();
+	QVector<float> target = run.getTarget();
+	QVector<float> rates = run.getRate();
+	Metrics metrics = analyze(times.constData(), probe.constData(), target.constData(), times.size(), settings,
+	                          run.hasEstimates() ? rates.constData() : 0);
+
+	metrics.title = run.getTitle();
+	return metrics;
+}
+
+// A single pass over the sample arrays. Rates are taken over a trailing
+// window rather than between neighbouring samples, which would mostly
+// measure the thermocouple's quantisation. The soak is the time spent in the
+// soak band before the peak, so it is latched whenever a new peak is seen.
+// Recordings that carry the state estimator's rate use it directly.
+RunAnalytics::Metrics RunAnalytics::analyze(const float *times, const float *probe, const float *target, int count, Settings settings, const float *rates)
+{
+	Metrics metrics;
+	float soak = 0;
+	double squaredError = 0;
+	int lag = 0;
+
+	metrics.valid = count >= 2;
+	metrics.duration = 0;
+	metrics.peakTemperature = count ? probe[0] : 0;
+	metrics.timeToPeak = 0;
+	metrics.timeAboveLiquidus = 0;
+	metrics.maxRampRate = 0;
+	metrics.maxCoolRate = 0;
+	metrics.soakDuration = 0;
+	metrics.rmsTrackingError = 0;
+	if (!metrics.valid)
+		return metrics;
+
+	for (int i = 1; i < count; i++) {
+		float dt = times[i] - times[i - 1];
+		if (dt <= 0)
+			continue;
+
+		float a = probe[i - 1];
+		float b = probe[i];
+		float errorA = a - target[i - 1];
+		float errorB = b - target[i];
+
+		metrics.timeAboveLiquidus += time_within(a, b, dt, settings.liquidus, INFINITY);
+		soak += time_within(a, b, dt, settings.soakMinimum, settings.soakMaximum);
+		squaredError += (errorA * errorA + errorB * errorB) * 0.5f * dt;
+
+		if (b > metrics.peakTemperature) {
+			metrics.peakTemperature = b;
+			metrics.timeToPeak = times[i] - times[0];
+			metrics.soakDuration = soak;
+		}
+
+		float rate = 0;
+		if (rates) {
+			rate = rates[i];
+		} else {
+			while (lag + 1 < i && times[i] - times[lag + 1] >= settings.rateWindow)
+				lag++;
+			float span = times[i] - times[lag];
+			if (span < settings.rateWindow)
+				continue;
+			rate = (b - probe[lag]) / span;
+		}
+		if (rate > metrics.maxRampRate)
+			metrics.maxRampRate = rate;
+		if (-rate > metrics.maxCoolRate)
+			metrics.maxCoolRate = -rate;
+	}
+
+	metrics.duration = times[count - 1] - times[0];
+	if (metrics.duration > 0)
+		metrics.rmsTrackingError = qSqrt(squaredError / metrics.duration);
+	return metrics;
+}
+
+QVector<RunAnalytics::Metrics> RunAnalytics::analyzeFiles(QStringList fileNames, Settings settings)
+{
+	// Loading dominates, so runs are spread across the cores whole
+	return QtConcurrent::blockingMapped<QVector<Metrics> >(fileNames, AnalyzeFile(settings));
+}
+
+QStringList RunAnalytics::findRuns(QString path)
+{
+	QFileInfo info(path);
+	QStringList runs;
+
+	if (!info.isDir())
+		return QStringList(path);
+
+	QDir directory(path);
+	foreach (QString fileName, directory.entryList(QStringList("*.csv"), QDir::Files, QDir::Name))
+		runs.append(directory.filePath(fileName));
+	return runs;
+}
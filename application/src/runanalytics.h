@@ -0,0 +1,47 @@
+#ifndef RUNANALYTICS_H
+#define RUNANALYTICS_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "runrecording.h"
+
+// Reflow quality metrics computed from recorded runs
+class RunAnalytics
+{
+	public:
+		struct Settings {
+			float liquidus;
+			float soakMinimum;
+			float soakMaximum;
+			float rateWindow;
+		};
+
+		struct Metrics {
+			QString fileName;
+			QString title;
+			bool valid;
+			float duration;
+			float peakTemperature;
+			float timeToPeak;
+			float timeAboveLiquidus;
+			float maxRampRate;
+			float maxCoolRate;
+			float soakDuration;
+			float rmsTrackingError;
+		};
+
+		// SAC305 by default
+		static const int DEFAULT_LIQUIDUS = 217;
+		static const int DEFAULT_SOAK_MINIMUM = 150;
+		static const int DEFAULT_SOAK_MAXIMUM = 200;
+		static const int DEFAULT_RATE_WINDOW = 5;
+
+		static Settings defaultSettings();
+		static Metrics analyze(RunRecording run, Settings settings);
+		static Metrics analyze(const float *times, const float *probe, const float *target, int count, Settings settings, const float *rates = 0);
+		static QVector<Metrics> analyzeFiles(QStringList fileNames, Settings settings);
+		static QStringList findRuns(QString path);
+};
+
+#endif // RUNANALYTICS_H
@@ -0,0 +1,136 @@
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QList>
+#include <QStandardPaths>
+#include <QUrl>
+#include <unistd.h>
+#include "runjournal.h"
+
+#define RUN_RECORD     "run"
+#define STEP_RECORD    "step"
+#define READING_RECORD "reading"
+#define GAP_RECORD     "gap"
+#define READING_FIELDS 8
+
+QString RunJournal::defaultPath()
+{
+	return QDir(QStandardPaths::writableLocation(QStandardPaths::DataLocation)).filePath("journal");
+}
+
+// Milliseconds on the monotonic clock, which keeps counting across restarts
+// of the application but not of the machine
+qint64 RunJournal::now()
+{
+	QElapsedTimer timer;
+	timer.start();
+	return timer.msecsSinceReference();
+}
+
+RunJournal::RunJournal(QString path) : _file(path)
+{
+}
+
+// Reads back a run that never ended. A line cut short by the crash is
+// ignored, and only the last step counts.
+bool RunJournal::recover(Run *run)
+{
+	QFile file(_file.fileName());
+	bool found = false;
+
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	while (!file.atEnd()) {
+		QByteArray line = file.readLine();
+		if (!line.endsWith('\n'))
+			break;
+
+		QList<QByteArray> fields = line.trimmed().split(' ');
+		if (fields[0] == RUN_RECORD && fields.size() == 6) {
+			run->id = QString::fromUtf8(fields[1]);
+			run->checksum = QByteArray::fromHex(fields[2]);
+			run->started = fields[3].toLongLong();
+			run->directory = QUrl::fromPercentEncoding(fields[4]);
+			run->profile = QUrl::fromPercentEncoding(fields[5]);
+			run->segment = -1;
+			run->holdExtension = 0;
+			run->target = 0;
+			run->filaments = false;
+			run->recording.clear();
+			run->recording.setTitle(run->profile);
+			found = true;
+		} else if (!found) {
+			break;
+		} else if (fields[0] == STEP_RECORD && fields.size() == 5) {
+			run->segment = fields[1].toInt();
+			run->holdExtension = fields[2].toInt();
+			run->target = fields[3].toInt();
+			run->filaments = fields[4].toInt();
+		} else if (fields[0] == GAP_RECORD && fields.size() == 3) {
+			run->recording.addGap(fields[1].toFloat(), fields[2].toFloat());
+		} else if (fields[0] == READING_RECORD && fields.size() == READING_FIELDS + 1) {
+			run->recording.append(fields[1].toFloat(), fields[2].toFloat(), fields[3].toFloat(), fields[4].toFloat(),
+			                      fields[5].toFloat(), fields[6].toFloat(), fields[7].toFloat(), fields[8].toFloat());
+		}
+	}
+
+	return found;
+}
+
+bool RunJournal::begin(const Run &run)
+{
+	_file.close();
+	QDir().mkpath(QFileInfo(_file.fileName()).path());
+	if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered))
+		return false;
+
+	write(QByteArray(RUN_RECORD) + ' ' + run.id.toUtf8() + ' ' + run.checksum.toHex() + ' ' +
+	      QByteArray::number(run.started) + ' ' + QUrl::toPercentEncoding(run.directory) + ' ' +
+	      QUrl::toPercentEncoding(run.profile) + '\n');
+	return fdatasync(_file.handle()) == 0;
+}
+
+// Appends to the journal of a recovered run
+bool RunJournal::resume()
+{
+	_file.close();
+	return _file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered);
+}
+
+void RunJournal::gap(float start, float end)
+{
+	write(QByteArray(GAP_RECORD) + ' ' + QByteArray::number(start, 'f', 3) + ' ' + QByteArray::number(end, 'f', 3) + '\n');
+}
+
+void RunJournal::step(int segment, int holdExtension, Temperature target, bool filaments)
+{
+	write(QByteArray(STEP_RECORD) + ' ' + QByteArray::number(segment) + ' ' + QByteArray::number(holdExtension) + ' ' +
+	      QByteArray::number(target) + ' ' + QByteArray::number(filaments ? 1 : 0) + '\n');
+}
+
+void RunJournal::reading(float time, float probe, float internal, float target, float top, float bottom, float filtered, float rate)
+{
+	write(QByteArray(READING_RECORD) + ' ' +
+	      QByteArray::number(time, 'f', 3) + ' ' +
+	      QByteArray::number(probe, 'f', 2) + ' ' +
+	      QByteArray::number(internal, 'f', 2) + ' ' +
+	      QByteArray::number(target, 'f', 2) + ' ' +
+	      QByteArray::number(top, 'f', 3) + ' ' +
+	      QByteArray::number(bottom, 'f', 3) + ' ' +
+	      QByteArray::number(filtered, 'f', 2) + ' ' +
+	      QByteArray::number(rate, 'f', 3) + '\n');
+}
+
+void RunJournal::end()
+{
+	_file.close();
+	_file.remove();
+}
+
+// Each line goes out in one write so a crash can only cut the last one short
+void RunJournal::write(const QByteArray &line)
+{
+	if (_file.isOpen())
+		_file.write(line);
+}
@@ -0,0 +1,53 @@
+#ifndef RUNJOURNAL_H
+#define RUNJOURNAL_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include "runrecording.h"
+#include "temperature.h"
+
+// An append-only log of the reflow in progress, so that a run interrupted by
+// the control application crashing or being killed can be picked up again
+// when it restarts. A line is written when a run starts, whenever the target
+// changes, with every reading and for every gap in the readings. Only the
+// start of a run is synced to disk: the later lines are written straight
+// through to the kernel, which keeps them across a crash of the application,
+// and after a crash of the machine the oven will have lost power anyway. The
+// journal is removed when the run ends normally.
+class RunJournal
+{
+	public:
+		struct Run {
+			QString id;
+			QString directory;
+			QString profile;
+			QByteArray checksum;
+			qint64 started; // monotonic milliseconds, see now()
+			int segment;
+			int holdExtension;
+			Temperature target;
+			bool filaments;
+			RunRecording recording;
+		};
+
+		static QString defaultPath();
+		static qint64 now();
+
+		explicit RunJournal(QString path = defaultPath());
+
+		bool recover(Run *run);
+		bool begin(const Run &run);
+		bool resume();
+		void gap(float start, float end);
+		void step(int segment, int holdExtension, Temperature target, bool filaments);
+		void reading(float time, float probe, float internal, float target, float top, float bottom, float filtered, float rate);
+		void end();
+
+	private:
+		void write(const QByteArray &line);
+
+		QFile _file;
+};
+
+#endif // RUNJOURNAL_H
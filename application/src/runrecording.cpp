@@ -0,0 +1,225 @@
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include "runrecording.h"
+
+#define TITLE_PREFIX "# title: "
+#define GAP_PREFIX   "# gap: "
+#define COLUMNS      8
+
+RunRecording RunRecording::load(QString fileName, bool *ok)
+{
+	RunRecording run;
+	QFile file(fileName);
+
+	if (ok)
+		*ok = false;
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		return run;
+
+	// Columns are looked up by name so that recordings can grow new ones
+	QList<QByteArray> header;
+	QVector<float> *columns[COLUMNS] = { 0 };
+	while (!file.atEnd()) {
+		QByteArray line = file.readLine().trimmed();
+		if (line.isEmpty())
+			continue;
+
+		if (line.startsWith('#')) {
+			if (line.startsWith(TITLE_PREFIX)) {
+				run._title = QString::fromUtf8(line.mid(sizeof(TITLE_PREFIX) - 1));
+			} else if (line.startsWith(GAP_PREFIX)) {
+				QList<QByteArray> bounds = line.mid(sizeof(GAP_PREFIX) - 1).split(',');
+				if (bounds.size() == 2)
+					run.addGap(bounds[0].toFloat(), bounds[1].toFloat());
+			}
+			continue;
+		}
+
+		if (header.isEmpty()) {
+			header = line.split(',');
+			for (int i = 0; i < header.size() && i < COLUMNS; i++) {
+				if (header[i] == "time")
+					columns[i] = &run._times;
+				else if (header[i] == "probe")
+					columns[i] = &run._probe;
+				else if (header[i] == "internal")
+					columns[i] = &run._internal;
+				else if (header[i] == "target")
+					columns[i] = &run._target;
+				else if (header[i] == "top")
+					columns[i] = &run._top;
+				else if (header[i] == "bottom")
+					columns[i] = &run._bottom;
+				else if (header[i] == "filtered")
+					columns[i] = &run._filtered;
+				else if (header[i] == "rate")
+					columns[i] = &run._rate;
+			}
+			run._estimates = header.contains("filtered") && header.contains("rate");
+			continue;
+		}
+
+		QList<QByteArray> fields = line.split(',');
+		if (fields.size() != header.size())
+			continue;
+		for (int i = 0; i < fields.size() && i < COLUMNS; i++) {
+			if (columns[i])
+				columns[i]->append(fields[i].toFloat());
+		}
+	}
+
+	// Missing columns read as zero so every array has the same length
+	int count = run._times.size();
+	run._probe.resize(count);
+	run._internal.resize(count);
+	run._target.resize(count);
+	run._top.resize(count);
+	run._bottom.resize(count);
+	run._filtered.resize(count);
+	run._rate.resize(count);
+
+	if (ok)
+		*ok = count > 0;
+	return run;
+}
+
+QString RunRecording::defaultDirectory()
+{
+	return QDir(QStandardPaths::writableLocation(QStandardPaths::DataLocation)).filePath("runs");
+}
+
+RunRecording::RunRecording()
+{
+	_estimates = false;
+}
+
+void RunRecording::clear()
+{
+	_times.clear();
+	_probe.clear();
+	_internal.clear();
+	_target.clear();
+	_top.clear();
+	_bottom.clear();
+	_filtered.clear();
+	_rate.clear();
+	_gaps.clear();
+	_estimates = false;
+}
+
+void RunRecording::append(float time, float probe, float internal, float target, float top, float bottom, float filtered, float rate)
+{
+	_times.append(time);
+	_probe.append(probe);
+	_internal.append(internal);
+	_target.append(target);
+	_top.append(top);
+	_bottom.append(bottom);
+	_filtered.append(filtered);
+	_rate.append(rate);
+	_estimates = true;
+}
+
+void RunRecording::addGap(float start, float end)
+{
+	Gap gap = { start, end };
+	_gaps.append(gap);
+}
+
+bool RunRecording::save(QString fileName)
+{
+	QDir().mkpath(QFileInfo(fileName).path());
+
+	QSaveFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+		return false;
+
+	QByteArray out;
+	out += TITLE_PREFIX + _title.toUtf8() + "\n";
+	foreach (const Gap &gap, _gaps)
+		out += GAP_PREFIX + QByteArray::number(gap.start, 'f', 3) + ',' + QByteArray::number(gap.end, 'f', 3) + "\n";
+	out += "time,probe,internal,target,top,bottom,filtered,rate\n";
+	for (int i = 0; i < _times.size(); i++) {
+		out += QByteArray::number(_times[i], 'f', 3) + ',' +
+		       QByteArray::number(_probe[i], 'f', 2) + ',' +
+		       QByteArray::number(_internal[i], 'f', 2) + ',' +
+		       QByteArray::number(_target[i], 'f', 2) + ',' +
+		       QByteArray::number(_top[i], 'f', 3) + ',' +
+		       QByteArray::number(_bottom[i], 'f', 3) + ',' +
+		       QByteArray::number(_filtered[i], 'f', 2) + ',' +
+		       QByteArray::number(_rate[i], 'f', 3) + '\n';
+	}
+	file.write(out);
+
+	return file.commit();
+}
+
+int RunRecording::size()
+{
+	return _times.size();
+}
+
+QString RunRecording::getTitle()
+{
+	return _title;
+}
+
+void RunRecording::setTitle(QString title)
+{
+	_title = title;
+}
+
+QVector<float> RunRecording::getTimes()
+{
+	return _times;
+}
+
+QVector<float> RunRecording::getProbe()
+{
+	return _probe;
+}
+
+QVector<float> RunRecording::getInternal()
+{
+	return _internal;
+}
+
+QVector<float> RunRecording::getTarget()
+{
+	return _target;
+}
+
+QVector<float> RunRecording::getTopPower()
+{
+	return _top;
+}
+
+QVector<float> RunRecording::getBottomPower()
+{
+	return _bottom;
+}
+
+QVector<float> RunRecording::getFiltered()
+{
+	return _filtered;
+}
+
+QVector<float> RunRecording::getRate()
+{
+	return _rate;
+}
+
+// Recordings from before the state estimator have no filtered or rate columns
+bool RunRecording::hasEstimates()
+{
+	return _estimates;
+}
+
+QVector<RunRecording::Gap> RunRecording::getGaps()
+{
+	return _gaps;
+}
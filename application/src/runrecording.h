@@ -0,0 +1,52 @@
+#ifndef RUNRECORDING_H
+#define RUNRECORDING_H
+
+#include <QString>
+#include <QVector>
+
+class RunRecording
+{
+	public:
+		// A stretch of the run without readings, while the oven was away
+		struct Gap {
+			float start;
+			float end;
+		};
+
+		static RunRecording load(QString fileName, bool *ok = 0);
+		static QString defaultDirectory();
+
+		RunRecording();
+		void clear();
+		void append(float time, float probe, float internal, float target, float top, float bottom, float filtered, float rate);
+		void addGap(float start, float end);
+		bool save(QString fileName);
+		int size();
+		QString getTitle();
+		void setTitle(QString title);
+		QVector<float> getTimes();
+		QVector<float> getProbe();
+		QVector<float> getInternal();
+		QVector<float> getTarget();
+		QVector<float> getTopPower();
+		QVector<float> getBottomPower();
+		QVector<float> getFiltered();
+		QVector<float> getRate();
+		bool hasEstimates();
+		QVector<Gap> getGaps();
+
+	private:
+		QString _title;
+		QVector<float> _times;
+		QVector<float> _probe;
+		QVector<float> _internal;
+		QVector<float> _target;
+		QVector<float> _top;
+		QVector<float> _bottom;
+		QVector<float> _filtered;
+		QVector<float> _rate;
+		QVector<Gap> _gaps;
+		bool _estimates;
+};
+
+#endif // RUNRECORDING_H
@@ -0,0 +1,167 @@
+#include <QtCore/qmath.h>
+#include <algorithm>
+#include <limits.h>
+#include "sampleindex.h"
+
+static bool sample_before(const QPointF &sample, double time)
+{
+	return sample.x() < time;
+}
+
+static bool time_before(double time, const QPointF &sample)
+{
+	return time < sample.x();
+}
+
+SampleIndex::SampleIndex()
+{
+	clear();
+}
+
+void SampleIndex::clear()
+{
+	_tiles.clear();
+	_size = 0;
+	_end = 0;
+	_minimum = 0;
+	_maximum = 0;
+}
+
+void SampleIndex::append(float time, float value)
+{
+	int tile = qMax(0, (int)(time / TILE_SECONDS));
+	QPointF sample(time, value);
+
+	while (_tiles.size() <= tile) {
+		Tile empty;
+		empty.minimum = empty.maximum = -1;
+		_tiles.append(empty);
+	}
+
+	// Samples normally arrive in order; anything else is slotted into place
+	Tile &t = _tiles[tile];
+	int index = t.samples.size();
+	if (index && time < t.samples.last().x()) {
+		index = std::upper_bound(t.samples.constBegin(), t.samples.constEnd(), (double)time, time_before) - t.samples.constBegin();
+		t.samples.insert(index, sample);
+		if (t.minimum >= index)
+			t.minimum++;
+		if (t.maximum >= index)
+			t.maximum++;
+	} else {
+		t.samples.append(sample);
+	}
+
+	if (t.minimum < 0 || value < t.samples[t.minimum].y())
+		t.minimum = index;
+	if (t.maximum < 0 || value > t.samples[t.maximum].y())
+		t.maximum = index;
+
+	_minimum = _size ? qMin(_minimum, value) : value;
+	_maximum = _size ? qMax(_maximum, value) : value;
+	_end = qMax(_end, time);
+	_size++;
+}
+
+int SampleIndex::size() const
+{
+	return _size;
+}
+
+bool SampleIndex::isEmpty() const
+{
+	return _size == 0;
+}
+
+float SampleIndex::getEnd() const
+{
+	return _end;
+}
+
+float SampleIndex::getMinimum() const
+{
+	return _minimum;
+}
+
+float SampleIndex::getMaximum() const
+{
+	return _maximum;
+}
+
+// Returns the samples between start and end, plus the nearest sample on
+// either side so that a line through them runs off the edges of the window.
+// Tiles entirely inside the window that hold more samples than they have
+// pixels (resolution is seconds per pixel) are reduced to their extremes.
+QVector<QPointF> SampleIndex::query(double start, double end, double resolution) const
+{
+	QVector<QPointF> result;
+	QPointF edge;
+
+	if (_tiles.isEmpty() || end < start)
+		return result;
+
+	int first = qBound(0, (int)qFloor(start / TILE_SECONDS), _tiles.size() - 1);
+	int last = qBound(0, (int)qFloor(end / TILE_SECONDS), _tiles.size() - 1);
+	int pixels = resolution > 0 ? qMax(1, (int)(TILE_SECONDS / resolution)) : INT_MAX / 2;
+
+	const QVector<QPointF> &head = _tiles[first].samples;
+	int from = std::lower_bound(head.constBegin(), head.constEnd(), start, sample_before) - head.constBegin();
+	if (previousSample(first, from, &edge))
+		result.append(edge);
+
+	for (int tile = first; tile <= last; tile++) {
+		const Tile &t = _tiles[tile];
+		if (t.samples.isEmpty())
+			continue;
+
+		bool inside = t.samples.first().x() >= start && t.samples.last().x() <= end;
+		if (inside && t.samples.size() > 2 * pixels + 2) {
+			int a = qMin(t.minimum, t.maximum);
+			int b = qMax(t.minimum, t.maximum);
+			result.append(t.samples.first());
+			if (a != 0)
+				result.append(t.samples[a]);
+			if (b != a && b != t.samples.size() - 1)
+				result.append(t.samples[b]);
+			result.append(t.samples.last());
+			continue;
+		}
+
+		QVector<QPointF>::const_iterator begin = std::lower_bound(t.samples.constBegin(), t.samples.constEnd(), start, sample_before);
+		QVector<QPointF>::const_iterator stop = std::upper_bound(begin, t.samples.constEnd(), end, time_before);
+		for (; begin != stop; begin++)
+			result.append(*begin);
+	}
+
+	const QVector<QPointF> &tail = _tiles[last].samples;
+	int to = std::upper_bound(tail.constBegin(), tail.constEnd(), end, time_before) - tail.constBegin();
+	if (nextSample(last, to, &edge))
+		result.append(edge);
+
+	return result;
+}
+
+bool SampleIndex::previousSample(int tile, int index, QPointF *sample) const
+{
+	for (; tile >= 0; tile--) {
+		if (index > 0) {
+			*sample = _tiles[tile].samples[index - 1];
+			return true;
+		}
+		if (tile > 0)
+			index = _tiles[tile - 1].samples.size();
+	}
+	return false;
+}
+
+bool SampleIndex::nextSample(int tile, int index, QPointF *sample) const
+{
+	for (; tile < _tiles.size(); tile++) {
+		if (index < _tiles[tile].samples.size()) {
+			*sample = _tiles[tile].samples[index];
+			return true;
+		}
+		index = 0;
+	}
+	return false;
+}
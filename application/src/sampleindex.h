@@ -0,0 +1,43 @@
+#ifndef SAMPLEINDEX_H
+#define SAMPLEINDEX_H
+
+#include <QPointF>
+#include <QVector>
+
+// Samples (seconds, value) bucketed into fixed-length time tiles, so that the
+// samples inside a window are found without scanning the whole trace. Tiles
+// also keep their extremes, which stand in for the tile's samples when it is
+// narrower than a couple of pixels.
+class SampleIndex
+{
+	public:
+		static const int TILE_SECONDS = 60;
+
+		SampleIndex();
+		void clear();
+		void append(float time, float value);
+		int size() const;
+		bool isEmpty() const;
+		float getEnd() const;
+		float getMinimum() const;
+		float getMaximum() const;
+		QVector<QPointF> query(double start, double end, double resolution) const;
+
+	private:
+		struct Tile {
+			QVector<QPointF> samples;
+			int minimum;
+			int maximum;
+		};
+
+		bool previousSample(int tile, int index, QPointF *sample) const;
+		bool nextSample(int tile, int index, QPointF *sample) const;
+
+		QVector<Tile> _tiles;
+		int _size;
+		float _end;
+		float _minimum;
+		float _maximum;
+};
+
+#endif // SAMPLEINDEX_H
@@ -0,0 +1,174 @@
+#include <QtGlobal>
+#include "stateestimator.h"
+
+// Measurement noise of the linearized probe, C^2
+#define MEASUREMENT_VARIANCE  0.25
+// Process noise densities per second, for temperature, rate and heater input
+#define TEMPERATURE_NOISE     0.01
+#define RATE_NOISE            0.02
+#define HEATER_NOISE          0.001
+// How quickly the rate settles to what the model predicts, in seconds
+#define RATE_RESPONSE         5.0
+#define INITIAL_RATE_VARIANCE 1.0
+#define MAX_STEP              10.0
+
+enum {
+	TEMPERATURE,
+	RATE,
+	HEATER
+};
+
+StateEstimator::StateEstimator()
+{
+	clearModel();
+	reset();
+}
+
+void StateEstimator::setModel(double gain, double timeConstant, double deadTime, double ambient)
+{
+	_modelled = timeConstant > 0;
+	_gain = gain;
+	_timeConstant = timeConstant;
+	_deadTime = deadTime;
+	_ambient = ambient;
+}
+
+void StateEstimator::clearModel()
+{
+	_modelled = false;
+	_gain = 0;
+	_timeConstant = 0;
+	_deadTime = 0;
+	_ambient = 0;
+}
+
+void StateEstimator::reset()
+{
+	for (int i = 0; i < STATES; i++) {
+		_x[i] = 0;
+		for (int j = 0; j < STATES; j++)
+			_p[i][j] = 0;
+	}
+	_initialized = false;
+}
+
+void StateEstimator::update(double temperature, double heater, double dt)
+{
+	if (!_initialized) {
+		reset();
+		_x[TEMPERATURE] = temperature;
+		_x[HEATER] = heater;
+		_p[TEMPERATURE][TEMPERATURE] = MEASUREMENT_VARIANCE;
+		_p[RATE][RATE] = INITIAL_RATE_VARIANCE;
+		_p[HEATER][HEATER] = 1;
+		_initialized = true;
+		return;
+	}
+
+	// A long gap (a stall or reconnect) is not worth extrapolating over
+	if (dt > MAX_STEP) {
+		_initialized = false;
+		update(temperature, heater, dt);
+		return;
+	}
+
+	if (dt > 0)
+		predict(heater, dt);
+	correct(temperature);
+}
+
+// x = F x + c, P = F P F' + Q
+void StateEstimator::predict(double heater, double dt)
+{
+	double f[STATES][STATES] = {
+		{ 1, dt, 0 },
+		{ 0, 1, 0 },
+		{ 0, 0, 1 }
+	};
+	double c[STATES] = { 0, 0, 0 };
+
+	// The heater input follows the command with the dead time as lag
+	double beta = qMin(1.0, dt / qMax(_deadTime, dt));
+	f[HEATER][HEATER] = 1 - beta;
+	c[HEATER] = beta * heater;
+
+	// The rate relaxes towards the model's (ambient + gain * u - T) / tau
+	if (_modelled) {
+		double alpha = qMin(1.0, dt / RATE_RESPONSE);
+		f[RATE][TEMPERATURE] = -alpha / _timeConstant;
+		f[RATE][RATE] = 1 - alpha;
+		f[RATE][HEATER] = alpha * _gain / _timeConstant;
+		c[RATE] = alpha * _ambient / _timeConstant;
+	}
+
+	double x[STATES];
+	for (int i = 0; i < STATES; i++) {
+		x[i] = c[i];
+		for (int j = 0; j < STATES; j++)
+			x[i] += f[i][j] * _x[j];
+	}
+
+	double fp[STATES][STATES];
+	for (int i = 0; i < STATES; i++) {
+		for (int j = 0; j < STATES; j++) {
+			fp[i][j] = 0;
+			for (int k = 0; k < STATES; k++)
+				fp[i][j] += f[i][k] * _p[k][j];
+		}
+	}
+	for (int i = 0; i < STATES; i++) {
+		for (int j = 0; j < STATES; j++) {
+			_p[i][j] = 0;
+			for (int k = 0; k < STATES; k++)
+				_p[i][j] += fp[i][k] * f[j][k];
+		}
+		_x[i] = x[i];
+	}
+
+	_p[TEMPERATURE][TEMPERATURE] += TEMPERATURE_NOISE * dt;
+	_p[RATE][RATE] += RATE_NOISE * dt;
+	_p[HEATER][HEATER] += HEATER_NOISE * dt;
+}
+
+// Only the temperature is measured, so the gain is a column of P over a scalar
+void StateEstimator::correct(double temperature)
+{
+	double innovation = temperature - _x[TEMPERATURE];
+	double s = _p[TEMPERATURE][TEMPERATURE] + MEASUREMENT_VARIANCE;
+	double k[STATES];
+
+	for (int i = 0; i < STATES; i++) {
+		k[i] = _p[i][TEMPERATURE] / s;
+		_x[i] += k[i] * innovation;
+	}
+
+	double row[STATES];
+	for (int j = 0; j < STATES; j++)
+		row[j] = _p[TEMPERATURE][j];
+	for (int i = 0; i < STATES; i++) {
+		for (int j = 0; j < STATES; j++)
+			_p[i][j] -= k[i] * row[j];
+	}
+
+	_x[HEATER] = qBound(0.0, _x[HEATER], 1.0);
+}
+
+bool StateEstimator::isInitialized()
+{
+	return _initialized;
+}
+
+double StateEstimator::getTemperature()
+{
+	return _x[TEMPERATURE];
+}
+
+double StateEstimator::getRate()
+{
+	return _x[RATE];
+}
+
+double StateEstimator::getHeaterInput()
+{
+	return _x[HEATER];
+}
@@ -0,0 +1,38 @@
+#ifndef STATEESTIMATOR_H
+#define STATEESTIMATOR_H
+
+// Kalman filter over the probe temperature (C), its rate of change (C/s) and
+// the effective heater input (0-1, the commanded power lagged by the
+// elements' dead time). With a thermal model the heater input and the oven's
+// losses drive the rate; without one the rate is a random walk. Every update
+// is a fixed amount of 3x3 arithmetic.
+class StateEstimator
+{
+	public:
+		static const int STATES = 3;
+
+		StateEstimator();
+		void setModel(double gain, double timeConstant, double deadTime, double ambient);
+		void clearModel();
+		void reset();
+		void update(double temperature, double heater, double dt);
+		bool isInitialized();
+		double getTemperature();
+		double getRate();
+		double getHeaterInput();
+
+	private:
+		void predict(double heater, double dt);
+		void correct(double temperature);
+
+		double _x[STATES];
+		double _p[STATES][STATES];
+		bool _initialized;
+		bool _modelled;
+		double _gain;
+		double _timeConstant;
+		double _deadTime;
+		double _ambient;
+};
+
+#endif // STATEESTIMATOR_H
@@ -0,0 +1,23 @@
+#ifndef TEMPERATURE_H
+#define TEMPERATURE_H
+
+#include <QtGlobal>
+#include "pcboven_protocol.h"
+
+// Temperatures are Q2 fixed point (quarter degrees C), as read from the
+// thermocouple, from the firmware through the driver to the profile targets
+// and the graph. They are only turned into degrees for display, recordings
+// and the thermal model's floating point simulation.
+typedef int Temperature;
+
+inline Temperature celsiusToTemperature(double celsius)
+{
+	return qRound(celsius * PCBOVEN_TEMP_ONE);
+}
+
+inline float temperatureToCelsius(Temperature temperature)
+{
+	return temperature / (float)PCBOVEN_TEMP_ONE;
+}
+
+#endif // TEMPERATURE_H
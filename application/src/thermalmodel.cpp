@@ -0,0 +1,213 @@
+#include <QSettings>
+#include <QtCore/qmath.h>
+#include "thermalmodel.h"
+
+static double det3(const double m[3][3])
+{
+	return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+	       m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+	       m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+ThermalModel ThermalModel::fit(RunRecording run)
+{
+	QVector<float> times = run.getTimes();
+	QVector<float> probe = run.getProbe();
+	QVector<float> top = run.getTopPower();
+	QVector<float> bottom = run.getBottomPower();
+	int count = times.size();
+	ThermalModel best;
+
+	if (count < MIN_FIT_SAMPLES)
+		return best;
+
+	QVector<float> power(count);
+	for (int i = 0; i < count; i++)
+		power[i] = (top[i] + bottom[i]) / 2;
+
+	// For every candidate dead time, regress the measured heating rate on
+	// temperature, delayed heater power and a constant:
+	//     dT/dt = a*T + b*u(t - delay) + c
+	// and keep the delay with the smallest residual.
+	for (int delay = 0; delay <= MAX_DEAD_TIME; delay++) {
+		double normal[3][3] = { { 0 } };
+		double moments[3] = { 0 };
+		double squares = 0;
+		int samples = 0;
+		int lag = 0;
+
+		for (int i = 1; i < count - 1; i++) {
+			double dt = times[i + 1] - times[i - 1];
+			float past = times[i] - delay;
+			if (dt <= 0 || past < times[0])
+				continue;
+			while (lag + 1 < count && times[lag + 1] <= past)
+				lag++;
+
+			double x[3] = { probe[i], power[lag], 1 };
+			double y = (probe[i + 1] - probe[i - 1]) / dt;
+			for (int j = 0; j < 3; j++) {
+				for (int k = 0; k < 3; k++)
+					normal[j][k] += x[j] * x[k];
+				moments[j] += x[j] * y;
+			}
+			squares += y * y;
+			samples++;
+		}
+
+		double det = det3(normal);
+		if (samples < MIN_FIT_SAMPLES || qAbs(det) < 1e-9)
+			continue;
+
+		// Cramer's rule
+		double beta[3];
+		for (int j = 0; j < 3; j++) {
+			double m[3][3];
+			for (int r = 0; r < 3; r++) {
+				for (int k = 0; k < 3; k++)
+					m[r][k] = (k == j) ? moments[r] : normal[r][k];
+			}
+			beta[j] = det3(m) / det;
+		}
+
+		double a = beta[0], b = beta[1], c = beta[2];
+		if (a >= 0 || b <= 0)
+			continue;
+
+		double residual = squares - (beta[0] * moments[0] + beta[1] * moments[1] + beta[2] * moments[2]);
+		double error = qSqrt(qMax(residual, 0.0) / samples);
+		if (!best.isValid() || error < best._fitError) {
+			best = ThermalModel(-b / a, -1 / a, delay, -c / a);
+			best._fitError = error;
+		}
+	}
+
+	return best;
+}
+
+ThermalModel ThermalModel::load()
+{
+	QSettings settings;
+	settings.beginGroup("ThermalModel");
+	ThermalModel model(settings.value("gain", 0).toDouble(),
+	                   settings.value("timeConstant", 0).toDouble(),
+	                   settings.value("deadTime", 0).toDouble(),
+	                   settings.value("ambient", 0).toDouble());
+	model._fitError = settings.value("fitError", 0).toDouble();
+	settings.endGroup();
+	return model;
+}
+
+ThermalModel::ThermalModel()
+{
+	_gain = 0;
+	_timeConstant = 0;
+	_deadTime = 0;
+	_ambient = 0;
+	_fitError = 0;
+}
+
+ThermalModel::ThermalModel(double gain, double timeConstant, double deadTime, double ambient)
+{
+	_gain = gain;
+	_timeConstant = timeConstant;
+	_deadTime = deadTime;
+	_ambient = ambient;
+	_fitError = 0;
+}
+
+void ThermalModel::save()
+{
+	QSettings settings;
+	settings.beginGroup("ThermalModel");
+	settings.setValue("gain", _gain);
+	settings.setValue("timeConstant", _timeConstant);
+	settings.setValue("deadTime", _deadTime);
+	settings.setValue("ambient", _ambient);
+	settings.setValue("fitError", _fitError);
+	settings.endGroup();
+}
+
+bool ThermalModel::isValid()
+{
+	return _gain > 0 && _timeConstant > 0;
+}
+
+double ThermalModel::getGain()
+{
+	return _gain;
+}
+
+double ThermalModel::getTimeConstant()
+{
+	return _timeConstant;
+}
+
+double ThermalModel::getDeadTime()
+{
+	return _deadTime;
+}
+
+double ThermalModel::getAmbient()
+{
+	return _ambient;
+}
+
+double ThermalModel::getFitError()
+{
+	return _fitError;
+}
+
+QMap<QTime, Temperature> ThermalModel::shape(ReflowProfile profile, int granularity_ms)
+{
+	QMap<QTime, Temperature> targets;
+	int steps = profile.getDuration() * 1000 / granularity_ms + 1;
+	double step = granularity_ms / 1000.0;
+	int lead = qRound(_deadTime / step);
+	float ceiling = temperatureToCelsius(profile.getPeakTemperature());
+
+	QVector<float> times(steps);
+	QVector<float> preview(steps);
+	QVector<float> reference(steps);
+	QVector<float> setpoints(steps);
+	QVector<float> temperatures(steps);
+	for (int i = 0; i < steps; i++) {
+		times[i] = i * step;
+		preview[i] = times[i] + _deadTime;
+	}
+	profile.evaluate(times.constData(), reference.data(), steps);
+	profile.evaluate(preview.constData(), setpoints.data(), steps);
+
+	// Start from the profile previewed by the dead time, then refine it against
+	// the simulated closed loop so the predicted probe curve lands on the
+	// profile. Setpoints never exceed the profile's own peak.
+	if (isValid()) {
+		for (int iteration = 0; iteration < SHAPING_ITERATIONS; iteration++) {
+			simulate(setpoints, &temperatures, step, reference[0]);
+			for (int i = 0; i < steps; i++) {
+				int j = qMin(i + lead, steps - 1);
+				setpoints[i] = qBound(0.0f, setpoints[i] + 0.5f * (reference[j] - temperatures[j]), ceiling);
+			}
+		}
+	}
+
+	for (int i = 0; i < steps; i++)
+		targets.insert(QTime(0, 0).addMSecs(i * granularity_ms), celsiusToTemperature(setpoints[i]));
+	return targets;
+}
+
+void ThermalModel::simulate(const QVector<float> &setpoints, QVector<float> *temperatures, double step, float initial)
+{
+	int delay = qRound(_deadTime / step);
+	int steps = setpoints.size();
+	QVector<float> power(steps);
+	double temperature = initial;
+
+	// The firmware controller is approximated as a high-gain relay
+	for (int i = 0; i < steps; i++) {
+		power[i] = (temperature < setpoints[i]) ? 1 : 0;
+		double u = (i >= delay) ? power[i - delay] : 0;
+		temperature += step / _timeConstant * (_ambient + _gain * u - temperature);
+		(*temperatures)[i] = temperature;
+	}
+}
@@ -0,0 +1,42 @@
+#ifndef THERMALMODEL_H
+#define THERMALMODEL_H
+
+#include <QMap>
+#include <QTime>
+#include "reflowprofile.h"
+#include "runrecording.h"
+
+// First-order-plus-dead-time model of the oven, from heater power (0-1) to
+// probe temperature: timeConstant * dT/dt = ambient + gain * u(t - deadTime) - T
+class ThermalModel
+{
+	public:
+		static const int MIN_FIT_SAMPLES = 30;
+		static const int MAX_DEAD_TIME = 60;
+		static const int SHAPING_ITERATIONS = 12;
+
+		static ThermalModel fit(RunRecording run);
+		static ThermalModel load();
+
+		ThermalModel();
+		ThermalModel(double gain, double timeConstant, double deadTime, double ambient);
+		void save();
+		bool isValid();
+		double getGain();
+		double getTimeConstant();
+		double getDeadTime();
+		double getAmbient();
+		double getFitError();
+		QMap<QTime, Temperature> shape(ReflowProfile profile, int granularity_ms);
+
+	private:
+		void simulate(const QVector<float> &setpoints, QVector<float> *temperatures, double step, float initial);
+
+		double _gain;
+		double _timeConstant;
+		double _deadTime;
+		double _ambient;
+		double _fitError;
+};
+
+#endif // THERMALMODEL_H
@@ -0,0 +1,396 @@
+#include <QtEndian>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "usbtransport.h"
+
+UsbTransport::UsbTransport(QObject *parent) : OvenTransport(parent)
+{
+	_context = NULL;
+	_handle = NULL;
+	_eventThread = NULL;
+	_hotplugRegistered = false;
+	memset(_readTransfers, 0, sizeof(_readTransfers));
+	memset(&_oven, 0, sizeof(_oven));
+	memset(&_gains, 0, sizeof(_gains));
+	_oven.balance = PCBOVEN_BALANCE_EVEN;
+	_sampleSequence = 0;
+
+	_reconnectTimer = new QTimer(this);
+	_reconnectTimer->setInterval(RECONNECT_PERIOD_MS);
+	connect(_reconnectTimer, &QTimer::timeout, this, &UsbTransport::connectDevice);
+}
+
+UsbTransport::~UsbTransport()
+{
+	close();
+}
+
+bool UsbTransport::open()
+{
+	int ret = libusb_init(&_context);
+	if (ret) {
+		_context = NULL;
+		errno = toErrno(ret);
+		return false;
+	}
+
+	_eventThread = new UsbEventThread(_context);
+	_eventThread->start();
+
+	if (libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG) &&
+	    libusb_hotplug_register_callback(_context, LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED, LIBUSB_HOTPLUG_NO_FLAGS,
+	                                     PCBOVEN_USB_ID_VENDOR, PCBOVEN_USB_ID_PRODUCT, LIBUSB_HOTPLUG_MATCH_ANY,
+	                                     &UsbTransport::deviceArrived, this, &_hotplug) == LIBUSB_SUCCESS)
+		_hotplugRegistered = true;
+
+	// Without hotplug, look for the oven periodically until it is plugged in
+	connectDevice();
+	if (!_handle && !_hotplugRegistered)
+		_reconnectTimer->start();
+	return true;
+}
+
+void UsbTransport::close()
+{
+	_reconnectTimer->stop();
+	if (_handle)
+		releaseDevice();
+	if (_hotplugRegistered) {
+		libusb_hotplug_deregister_callback(_context, _hotplug);
+		_hotplugRegistered = false;
+	}
+
+	if (_eventThread) {
+		_eventThread->requestInterruption();
+		_eventThread->wait();
+		delete _eventThread;
+		_eventThread = NULL;
+	}
+	if (_context) {
+		libusb_exit(_context);
+		_context = NULL;
+	}
+}
+
+void UsbTransport::connectDevice()
+{
+	libusb_device_handle *handle;
+	int ret;
+
+	// A queued hotplug arrival may come after close()
+	if (_handle || !_context)
+		return;
+
+	handle = libusb_open_device_with_vid_pid(_context, PCBOVEN_USB_ID_VENDOR, PCBOVEN_USB_ID_PRODUCT);
+	if (!handle)
+		return;
+
+	// Takes the interface from the kernel module if it is loaded
+	libusb_set_auto_detach_kernel_driver(handle, 1);
+	ret = libusb_claim_interface(handle, INTERFACE);
+	if (ret) {
+		// Something else owns it; retrying every second won't change that
+		libusb_close(handle);
+		_reconnectTimer->stop();
+		emit errorOccurred(toErrno(ret));
+		return;
+	}
+
+	// A freshly connected oven starts with the filaments off
+	_mutex.lock();
+	_handle = handle;
+	_oven.enable_filaments = false;
+	_oven.manual_duty = false;
+	_oven.manual_cooling = false;
+	_oven.trip_reason = PCBOVEN_TRIP_NONE;
+	_sampleSequence = 0;
+	_mutex.unlock();
+
+	_lost.store(0);
+	for (int i = 0; i < IN_TRANSFERS; i++) {
+		_readTransfers[i] = libusb_alloc_transfer(0);
+		libusb_fill_interrupt_transfer(_readTransfers[i], _handle, IN_ENDPOINT,
+		                               (unsigned char *)malloc(IN_BUFFER), IN_BUFFER,
+		                               &UsbTransport::readCompleted, this, 0);
+		if (libusb_submit_transfer(_readTransfers[i]) == 0)
+			_activeTransfers.ref();
+	}
+
+	_reconnectTimer->stop();
+	emit connected();
+}
+
+// Cancels the queued transfers and waits for the event thread to finish
+// them off before the handle goes
+void UsbTransport::releaseDevice()
+{
+	libusb_device_handle *handle;
+
+	_mutex.lock();
+	handle = _handle;
+	_handle = NULL;
+	_mutex.unlock();
+	if (!handle)
+		return;
+
+	// Completions stop resubmitting from here on
+	_lost.store(1);
+	for (int i = 0; i < IN_TRANSFERS; i++)
+		libusb_cancel_transfer(_readTransfers[i]);
+	while (_activeTransfers.load() > 0)
+		QThread::msleep(1);
+
+	for (int i = 0; i < IN_TRANSFERS; i++) {
+		free(_readTransfers[i]->buffer);
+		libusb_free_transfer(_readTransfers[i]);
+		_readTransfers[i] = NULL;
+	}
+
+	libusb_release_interface(handle, INTERFACE);
+	libusb_close(handle);
+
+	emit disconnected();
+}
+
+// Only after losing the oven, never from close()
+void UsbTransport::reconnectDevice()
+{
+	// Queued by the event thread, possibly just before close()
+	if (!_context)
+		return;
+
+	releaseDevice();
+
+	// The oven may already be back if it only blipped
+	if (_hotplugRegistered)
+		connectDevice();
+	else
+		_reconnectTimer->start();
+}
+
+// Called on the event thread, like deviceLost()
+int UsbTransport::deviceArrived(libusb_context *context, libusb_device *device, libusb_hotplug_event event, void *data)
+{
+	(void)context;
+	(void)device;
+	(void)event;
+	QMetaObject::invokeMethod((UsbTransport *)data, "connectDevice", Qt::QueuedConnection);
+	return 0;
+}
+
+// Called on the event thread; the handle is released from the main thread
+void UsbTransport::deviceLost()
+{
+	if (_lost.testAndSetOrdered(0, 1))
+		QMetaObject::invokeMethod(this, "reconnectDevice", Qt::QueuedConnection);
+}
+
+int UsbTransport::execute(unsigned long code, QByteArray data, bool byReference)
+{
+	QMutexLocker locker(&_mutex);
+	int frame;
+	int ret;
+	(void)byReference;
+
+	if (!_handle)
+		return ENODEV;
+
+	ret = applyCommand(&_oven, &_gains, code, data, &frame);
+	if (ret)
+		return ret;
+	return write(frame);
+}
+
+bool UsbTransport::getGains(struct oven_gains *gains)
+{
+	QMutexLocker locker(&_mutex);
+	*gains = _gains;
+	return _handle != NULL;
+}
+
+// Submits a frame built from the current settings; the mutex must be held
+int UsbTransport::write(int command)
+{
+	struct oven_settings_frame settings;
+	struct oven_gains_frame gains;
+	struct oven_heartbeat_frame heartbeat;
+	const void *frame;
+	int size;
+
+	if (!_handle)
+		return ENODEV;
+
+	switch (command) {
+	case PCBOVEN_CMD_GAINS:
+		gains.command = PCBOVEN_CMD_GAINS;
+		gains.gain_p = qToLittleEndian(_gains.proportional);
+		gains.gain_i = qToLittleEndian(_gains.integral);
+		gains.gain_d = qToLittleEndian(_gains.derivative);
+		frame = &gains;
+		size = sizeof(gains);
+		break;
+	case PCBOVEN_CMD_HEARTBEAT:
+		heartbeat.command = PCBOVEN_CMD_HEARTBEAT;
+		frame = &heartbeat;
+		size = sizeof(heartbeat);
+		break;
+	case PCBOVEN_CMD_SETTINGS:
+	default:
+		settings.command = PCBOVEN_CMD_SETTINGS;
+		settings.target = qToLittleEndian(_oven.target_temp);
+		settings.flags = (_oven.enable_filaments ? PCBOVEN_SETTINGS_ENABLE : 0) |
+		                 (_oven.manual_duty ? PCBOVEN_SETTINGS_MANUAL : 0) |
+		                 (_oven.manual_cooling ? PCBOVEN_SETTINGS_COOLING : 0);
+		settings.top_duty = _oven.manual_top_duty;
+		settings.bottom_duty = _oven.manual_bottom_duty;
+		settings.balance = _oven.balance;
+		settings.timeout = PCBOVEN_DEFAULT_TIMEOUT;
+		settings.cooling = _oven.manual_cooling_duty;
+		frame = &settings;
+		size = sizeof(settings);
+		break;
+	}
+
+	unsigned char *buffer = (unsigned char *)malloc(size);
+	struct libusb_transfer *transfer = libusb_alloc_transfer(0);
+	if (!buffer || !transfer) {
+		free(buffer);
+		libusb_free_transfer(transfer);
+		return ENOMEM;
+	}
+
+	memcpy(buffer, frame, size);
+	libusb_fill_bulk_transfer(transfer, _handle, OUT_ENDPOINT, buffer, size, &UsbTransport::writeCompleted, this, 0);
+	transfer->flags = LIBUSB_TRANSFER_FREE_BUFFER | LIBUSB_TRANSFER_FREE_TRANSFER;
+
+	int ret = libusb_submit_transfer(transfer);
+	if (ret) {
+		libusb_free_transfer(transfer);
+		return toErrno(ret);
+	}
+	_activeTransfers.ref();
+	return 0;
+}
+
+void UsbTransport::readCompleted(struct libusb_transfer *transfer)
+{
+	UsbTransport *self = (UsbTransport *)transfer->user_data;
+
+	switch (transfer->status) {
+	case LIBUSB_TRANSFER_COMPLETED:
+		if (transfer->actual_length >= (int)PCBOVEN_FRAME_MIN)
+			self->processFrame((const struct oven_usb_frame *)transfer->buffer, transfer->actual_length);
+		break;
+	case LIBUSB_TRANSFER_CANCELLED:
+		self->_activeTransfers.deref();
+		return;
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		self->_activeTransfers.deref();
+		self->deviceLost();
+		return;
+	default:
+		break;
+	}
+
+	if (self->_lost.load() || libusb_submit_transfer(transfer)) {
+		self->_activeTransfers.deref();
+		self->deviceLost();
+	}
+}
+
+void UsbTransport::writeCompleted(struct libusb_transfer *transfer)
+{
+	UsbTransport *self = (UsbTransport *)transfer->user_data;
+
+	if (transfer->status == LIBUSB_TRANSFER_NO_DEVICE)
+		emit self->errorOccurred(ENODEV);
+	else if (transfer->status != LIBUSB_TRANSFER_COMPLETED && transfer->status != LIBUSB_TRANSFER_CANCELLED)
+		emit self->errorOccurred(EIO);
+	self->_activeTransfers.deref();
+}
+
+// Called on the event thread with each reading, like the kernel driver's
+// interrupt completion
+void UsbTransport::processFrame(const struct oven_usb_frame *frame, int length)
+{
+	struct oven_state state;
+	int16_t probes[PCBOVEN_SAMPLES_MAX];
+	QVector<oven_sample> samples;
+	int count;
+
+	_mutex.lock();
+	_oven.probe_temp = qFromLittleEndian(frame->probe);
+	_oven.internal_temp = qFromLittleEndian(frame->internal);
+	_oven.fault_short_vcc = frame->short_vcc;
+	_oven.fault_short_gnd = frame->short_gnd;
+	_oven.fault_open_circuit = frame->open_circuit;
+	_oven.filament_top_on = frame->top_on;
+	_oven.filament_bottom_on = frame->bottom_on;
+	_oven.top_duty = frame->top_duty;
+	_oven.bottom_duty = frame->bottom_duty;
+	_oven.cooling_duty = frame->cooling;
+	_oven.failsafe = frame->failsafe <= PCBOVEN_FAILSAFE_SENSOR ? frame->failsafe : PCBOVEN_FAILSAFE_SENSOR;
+	_oven.applied_target_temp = qFromLittleEndian(frame->target);
+	_oven.applied_enable = frame->flags & PCBOVEN_SETTINGS_ENABLE;
+	_gains.proportional = qFromLittleEndian(frame->gain_p);
+	_gains.integral = qFromLittleEndian(frame->gain_i);
+	_gains.derivative = qFromLittleEndian(frame->gain_d);
+
+	count = pcboven_unpack_samples(&frame->samples, length - PCBOVEN_SAMPLES_OFFSET, probes);
+	if (count >= 0)
+		_sampleSequence = pcboven_extend_sequence(_sampleSequence, qFromLittleEndian(frame->samples.sequence));
+	for (int i = 0; i < count; i++) {
+		struct oven_sample sample;
+		sample.time = (_sampleSequence + i) * (1000 / PCBOVEN_SAMPLE_RATE);
+		sample.probe_temp = probes[i];
+		samples.append(sample);
+	}
+
+	// Cut the heaters from here rather than waiting for the application,
+	// resending until a reading shows them off
+	checkWatchdog(&_oven, CEILING);
+	if (_oven.trip_reason != PCBOVEN_TRIP_NONE && !_oven.enable_filaments && _oven.applied_enable)
+		write(PCBOVEN_CMD_SETTINGS);
+	state = _oven;
+	_mutex.unlock();
+
+	if (!samples.isEmpty())
+		emit samplesReceived(samples);
+	emit stateReceived(state, QTime::currentTime());
+}
+
+int UsbTransport::toErrno(int error)
+{
+	switch (error) {
+	case LIBUSB_ERROR_ACCESS:
+		return EACCES;
+	case LIBUSB_ERROR_NO_DEVICE:
+		return ENODEV;
+	case LIBUSB_ERROR_NOT_FOUND:
+		return ENOENT;
+	case LIBUSB_ERROR_BUSY:
+		return EBUSY;
+	case LIBUSB_ERROR_TIMEOUT:
+		return ETIMEDOUT;
+	case LIBUSB_ERROR_NO_MEM:
+		return ENOMEM;
+	case LIBUSB_ERROR_NOT_SUPPORTED:
+		return ENOTSUP;
+	default:
+		return EIO;
+	}
+}
+
+UsbEventThread::UsbEventThread(libusb_context *context) : QThread()
+{
+	_context = context;
+}
+
+void UsbEventThread::run()
+{
+	struct timeval timeout = { 0, EVENT_TIMEOUT_MS * 1000 };
+
+	while (!isInterruptionRequested())
+		libusb_handle_events_timeout_completed(_context, &timeout, NULL);
+}
@@ -0,0 +1,85 @@
+#ifndef USBTRANSPORT_H
+#define USBTRANSPORT_H
+
+#include <libusb.h>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QThread>
+#include <QTimer>
+#include "oventransport.h"
+
+class UsbEventThread;
+
+// Talks to the oven from userspace through libusb, so no kernel module is
+// needed. IN_TRANSFERS interrupt transfers are kept queued so a reading is
+// never missed while another is processed, and OUT frames are submitted
+// without waiting for earlier ones; all of them complete on an event thread.
+// The watchdog the kernel driver runs on each reading is run here instead.
+// Where libusb supports hotplug the oven is opened as soon as it enumerates,
+// otherwise it is looked for every RECONNECT_PERIOD_MS.
+class UsbTransport : public OvenTransport
+{
+	Q_OBJECT
+
+	public:
+		explicit UsbTransport(QObject *parent = 0);
+		virtual ~UsbTransport();
+
+		static const int INTERFACE = 0;
+		static const int IN_ENDPOINT = 0x81;
+		static const int OUT_ENDPOINT = 0x02;
+		static const int IN_TRANSFERS = 4;
+		static const int IN_BUFFER = 64;
+		static const int CEILING = 300;
+		static const int RECONNECT_PERIOD_MS = 250;
+
+		virtual bool open();
+		virtual void close();
+		virtual int execute(unsigned long code, QByteArray data, bool byReference);
+		virtual bool getGains(struct oven_gains *gains);
+
+	private slots:
+		void connectDevice();
+		void releaseDevice();
+		void reconnectDevice();
+
+	private:
+		static void LIBUSB_CALL readCompleted(struct libusb_transfer *transfer);
+		static void LIBUSB_CALL writeCompleted(struct libusb_transfer *transfer);
+		static int LIBUSB_CALL deviceArrived(libusb_context *context, libusb_device *device, libusb_hotplug_event event, void *data);
+		static int toErrno(int error);
+		void processFrame(const struct oven_usb_frame *frame, int length);
+		int write(int command);
+		void deviceLost();
+
+		libusb_context *_context;
+		libusb_device_handle *_handle;
+		libusb_hotplug_callback_handle _hotplug;
+		bool _hotplugRegistered;
+		struct libusb_transfer *_readTransfers[IN_TRANSFERS];
+		QAtomicInt _activeTransfers;
+		QAtomicInt _lost;
+		UsbEventThread *_eventThread;
+		QTimer *_reconnectTimer;
+		QMutex _mutex;
+		struct oven_state _oven;
+		struct oven_gains _gains;
+		quint32 _sampleSequence;
+};
+
+// Runs libusb's event handling, and with it the transfer callbacks
+class UsbEventThread : public QThread
+{
+	public:
+		explicit UsbEventThread(libusb_context *context);
+
+		static const int EVENT_TIMEOUT_MS = 100;
+
+	protected:
+		virtual void run();
+
+	private:
+		libusb_context *_context;
+};
+
+#endif // USBTRANSPORT_H
@@ -0,0 +1,177 @@
+#ifndef __PCBOVEN_PROTOCOL_H__
+#define __PCBOVEN_PROTOCOL_H__
+
+/*
+ * USB frame layouts shared by the firmware, the kernel driver and userspace.
+ * All multi-byte fields are little endian.
+ */
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+#endif
+
+#define PCBOVEN_CMD_SETTINGS       0x01
+#define PCBOVEN_CMD_GAINS          0x02
+#define PCBOVEN_CMD_HEARTBEAT      0x03
+
+#define PCBOVEN_SETTINGS_ENABLE    (1 << 0)
+#define PCBOVEN_SETTINGS_MANUAL    (1 << 1)
+#define PCBOVEN_SETTINGS_COOLING   (1 << 2)  /* fixed cooling duty */
+
+/*
+ * In automatic mode the controller output is split between the elements by
+ * the balance: the top element's share out of 256, so 128 heats both evenly.
+ */
+#define PCBOVEN_BALANCE_EVEN       128
+
+/*
+ * The cooling output (a fan or a door actuator) is time-proportioned like the
+ * elements. In automatic mode it runs while the filaments are enabled and the
+ * probe is falling behind the target, harder the further behind it is; with
+ * PCBOVEN_SETTINGS_COOLING it runs at the settings' fixed duty whether the
+ * filaments are enabled or not.
+ */
+
+/*
+ * The firmware switches both elements off by itself if the host goes quiet
+ * for the settings' timeout (seconds, 0 disables) or the thermocouple keeps
+ * faulting. The failsafe is reported in every IN frame until the host
+ * enables the filaments again.
+ */
+#define PCBOVEN_DEFAULT_TIMEOUT    5
+#define PCBOVEN_FAILSAFE_NONE      0
+#define PCBOVEN_FAILSAFE_TIMEOUT   1
+#define PCBOVEN_FAILSAFE_SENSOR    2
+
+/* Controller gains are Q8.8 fixed point, in duty counts (0-255) per degree C */
+#define PCBOVEN_GAIN_SHIFT         8
+
+/*
+ * Temperatures are Q2 fixed point (quarter degrees C), the thermocouple's
+ * resolution, everywhere from the firmware to the host application.
+ */
+#define PCBOVEN_TEMP_SHIFT         2
+#define PCBOVEN_TEMP_ONE           (1 << PCBOVEN_TEMP_SHIFT)
+
+/*
+ * The thermocouple is sampled at PCBOVEN_SAMPLE_RATE, faster than the once a
+ * second readings, and the samples taken since the last reading ride along
+ * in its IN frame. The block is cut short after its last sample, and is delta
+ * encoded (int8 steps from the first sample) unless a step does not fit, in
+ * which case the samples after the first are raw int16s. The sequence counts
+ * samples since the firmware started and wraps at 16 bits.
+ */
+#define PCBOVEN_SAMPLE_RATE        10
+#define PCBOVEN_SAMPLES_MAX        16
+#define PCBOVEN_SAMPLES_RAW        0
+#define PCBOVEN_SAMPLES_DELTA      1
+
+struct __attribute__ ((__packed__)) oven_sample_block {
+	uint16_t sequence;  /* of the first sample */
+	uint8_t count;
+	uint8_t encoding;
+	int16_t first;
+	uint8_t data[2 * (PCBOVEN_SAMPLES_MAX - 1)];
+};
+
+/*
+ * Sent on the interrupt IN endpoint once per reading. The probe is the
+ * filtered, linearized temperature and the internal temperature is the
+ * thermocouple converter's cold junction, both Q2. The target and settings
+ * flags echo what the firmware is applying, so the host can tell when a
+ * command has taken effect. The cooling duty is the one being applied.
+ */
+struct __attribute__ ((__packed__)) oven_usb_frame {
+	int16_t probe;
+	int16_t internal;
+	uint8_t short_vcc;
+	uint8_t short_gnd;
+	uint8_t open_circuit;
+	uint8_t top_on;
+	uint8_t bottom_on;
+	uint8_t top_duty;
+	uint8_t bottom_duty;
+	uint16_t gain_p;
+	uint16_t gain_i;
+	uint16_t gain_d;
+	uint8_t failsafe;
+	int16_t target;
+	uint8_t flags;
+	uint8_t cooling;
+	struct oven_sample_block samples;
+};
+
+/* Where an IN frame's sample block starts, and its shortest length */
+#define PCBOVEN_SAMPLES_OFFSET     (sizeof(struct oven_usb_frame) - sizeof(struct oven_sample_block))
+#define PCBOVEN_FRAME_MIN          (sizeof(struct oven_usb_frame) - sizeof(((struct oven_sample_block *)0)->data))
+
+/*
+ * Unpacks a sample block of length bytes into Q2 probe temperatures, and
+ * returns how many there were or -1 if the block is short or malformed.
+ */
+static inline int pcboven_unpack_samples(const struct oven_sample_block *block, unsigned int length, int16_t *probes)
+{
+	const uint8_t *first = (const uint8_t *)&block->first;
+	unsigned int header = sizeof(*block) - sizeof(block->data);
+	int count = block->count;
+	int i;
+
+	if (length < header || count > PCBOVEN_SAMPLES_MAX)
+		return -1;
+	if (count == 0)
+		return 0;
+
+	length -= header;
+	if (block->encoding == PCBOVEN_SAMPLES_DELTA && length < (unsigned int)count - 1)
+		return -1;
+	if (block->encoding == PCBOVEN_SAMPLES_RAW && length < 2 * ((unsigned int)count - 1))
+		return -1;
+	if (block->encoding != PCBOVEN_SAMPLES_DELTA && block->encoding != PCBOVEN_SAMPLES_RAW)
+		return -1;
+
+	probes[0] = (int16_t)(first[0] | first[1] << 8);
+	for (i = 1; i < count; i++) {
+		if (block->encoding == PCBOVEN_SAMPLES_DELTA)
+			probes[i] = probes[i - 1] + (int8_t)block->data[i - 1];
+		else
+			probes[i] = (int16_t)(block->data[2 * (i - 1)] | block->data[2 * (i - 1) + 1] << 8);
+	}
+	return count;
+}
+
+/*
+ * Extends a block's 16 bit sequence against the last one seen, so samples
+ * keep counting up across the wrap
+ */
+static inline uint32_t pcboven_extend_sequence(uint32_t last, uint16_t sequence)
+{
+	return last + (uint16_t)(sequence - (uint16_t)last);
+}
+
+/* Sent on the bulk OUT endpoint, identified by their first byte */
+struct __attribute__ ((__packed__)) oven_settings_frame {
+	uint8_t command;
+	int16_t target;
+	uint8_t flags;
+	uint8_t top_duty;
+	uint8_t bottom_duty;
+	uint8_t balance;
+	uint8_t timeout;
+	uint8_t cooling;
+};
+
+struct __attribute__ ((__packed__)) oven_gains_frame {
+	uint8_t command;
+	uint16_t gain_p;
+	uint16_t gain_i;
+	uint16_t gain_d;
+};
+
+/* Any command resets the failsafe timeout; this one does nothing else */
+struct __attribute__ ((__packed__)) oven_heartbeat_frame {
+	uint8_t command;
+};
+
+#endif
@@ -4,18 +4,29 @@
 #include <linux/fs.h>
 #include <linux/errno.h>
 #include <linux/slab.h>
+#include <linux/jiffies.h>
+#include <linux/kfifo.h>
+#include <linux/mutex.h>
 #include "pcboven_usb.h"
+#include "pcboven_protocol.h"
 
-#define IN_BUF_LEN  9
-#define OUT_BUF_LEN 3
+#define IN_BUF_LEN  sizeof(struct oven_usb_frame)
 #define IN_INTERVAL 1
 #define IN_EP       0x01
 #define OUT_EP      0x02
 
+/* Watchdog defaults, both adjustable through sysfs */
+#define DEFAULT_CEILING           300   /* whole degrees C */
+#define MAX_CEILING               1800  /* the top of the thermocouple's range */
+#define DEFAULT_HEARTBEAT_TIMEOUT 5000  /* ms, 0 disables */
+
 #define to_misc_device(d) container_of(d, struct miscdevice, this_device)
 
 void intr_callback(struct urb *urb);
-int write_settings(struct usb_device *usbdev, int16_t temp, bool filaments);
+int write_frame(struct usb_device *usbdev, const void *frame, size_t len, gfp_t flags);
+int write_settings(struct usb_device *usbdev, struct oven_state *oven, gfp_t flags);
+int write_gains(struct usb_device *usbdev, struct oven_gains *gains);
+int write_heartbeat(struct usb_device *usbdev);
 int usb_probe(struct usb_interface *intf, const struct usb_device_id *id_table);
 void usb_disconnect(struct usb_interface *intf);
 void urb_complete(struct urb *urb);
@@ -24,25 +35,27 @@ int oven_fopen(struct inode *inode, struct file *file);
 int oven_fclose(struct inode *inode, struct file *file);
 int oven_fasync(int fd, struct file *file, int mode);
 
-struct __attribute__ ((__packed__)) oven_usb_frame {
-	int16_t probe;
-	int16_t internal;
-	uint8_t short_vcc;
-	uint8_t short_gnd;
-	uint8_t open_circuit;
-	uint8_t top_on;
-	uint8_t bottom_on;
-};
-
 struct driver_context {
 	struct oven_state oven;
+	struct oven_gains gains;
 	struct usb_device *usb_device;
 	struct fasync_struct *async_queue;
 	uint8_t transfer_buffer[IN_BUF_LEN];
+	unsigned long last_command;
+	int ceiling;
+	unsigned int heartbeat_timeout;
+	DECLARE_KFIFO(samples, struct oven_sample, PCBOVEN_SAMPLE_QUEUE);
+	uint32_t sample_sequence;
 };
 
+int check_watchdog(struct driver_context *context);
+void queue_samples(struct driver_context *context, struct oven_usb_frame *reading, unsigned int length);
+
 static struct driver_context *static_context = NULL;
 
+/* The interrupt completion is the only writer; this serializes the readers */
+static DEFINE_MUTEX(samples_mutex);
+
 static struct file_operations oven_fops = {
 	.owner             = THIS_MODULE,
 	.llseek            = NULL,
@@ -94,11 +107,33 @@ static struct usb_driver oven_usb_driver = {
 
 static struct usb_device DUMMY_USB_DEVICE;
 
+static const char *trip_reasons[] = {
+	[PCBOVEN_TRIP_NONE]    = "none",
+	[PCBOVEN_TRIP_FAULT]   = "fault",
+	[PCBOVEN_TRIP_CEILING] = "ceiling",
+	[PCBOVEN_TRIP_TIMEOUT] = "timeout",
+	[PCBOVEN_TRIP_DEVICE]  = "device"
+};
+
+static const char *failsafes[] = {
+	[PCBOVEN_FAILSAFE_NONE]    = "none",
+	[PCBOVEN_FAILSAFE_TIMEOUT] = "timeout",
+	[PCBOVEN_FAILSAFE_SENSOR]  = "sensor"
+};
+
+/* Q2 temperatures are shown in degrees C with two decimals */
+static ssize_t temp_show(char *buf, int16_t temp)
+{
+	int value = abs(temp);
+	int fraction = (value & (PCBOVEN_TEMP_ONE - 1)) * 100 >> PCBOVEN_TEMP_SHIFT;
+	return scnprintf(buf, PAGE_SIZE, "%s%d.%02d", temp < 0 ? "-" : "", value >> PCBOVEN_TEMP_SHIFT, fraction);
+}
+
 ssize_t probe_temp_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
 	struct usb_interface *intf = to_usb_interface(dev);
 	struct driver_context *context = usb_get_intfdata(intf);
-	return scnprintf(buf, PAGE_SIZE, "%d", context->oven.probe_temp);
+	return temp_show(buf, context->oven.probe_temp);
 }
 
 DEVICE_ATTR(probe_temp, S_IRUSR, probe_temp_show, NULL);
@@ -107,7 +142,7 @@ ssize_t internal_temp_show(struct device *dev, struct device_attribute *attr, ch
 {
 	struct usb_interface *intf = to_usb_interface(dev);
 	struct driver_context *context = usb_get_intfdata(intf);
-	return scnprintf(buf, PAGE_SIZE, "%d", context->oven.internal_temp);
+	return temp_show(buf, context->oven.internal_temp);
 }
 
 DEVICE_ATTR(internal_temp, S_IRUSR, internal_temp_show, NULL);
@@ -157,11 +192,38 @@ ssize_t filament_bottom_on_show(struct device *dev, struct device_attribute *att
 
 DEVICE_ATTR(filament_bottom_on, S_IRUSR, filament_bottom_on_show, NULL);
 
+ssize_t filament_top_duty_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct usb_interface *intf = to_usb_interface(dev);
+	struct driver_context *context = usb_get_intfdata(intf);
+	return scnprintf(buf, PAGE_SIZE, "%d", context->oven.top_duty);
+}
+
+DEVICE_ATTR(filament_top_duty, S_IRUSR, filament_top_duty_show, NULL);
+
+ssize_t filament_bottom_duty_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct usb_interface *intf = to_usb_interface(dev);
+	struct driver_context *context = usb_get_intfdata(intf);
+	return scnprintf(buf, PAGE_SIZE, "%d", context->oven.bottom_duty);
+}
+
+DEVICE_ATTR(filament_bottom_duty, S_IRUSR, filament_bottom_duty_show, NULL);
+
+ssize_t cooling_duty_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct usb_interface *intf = to_usb_interface(dev);
+	struct driver_context *context = usb_get_intfdata(intf);
+	return scnprintf(buf, PAGE_SIZE, "%d", context->oven.cooling_duty);
+}
+
+DEVICE_ATTR(cooling_duty, S_IRUSR, cooling_duty_show, NULL);
+
 ssize_t target_temp_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
 	struct usb_interface *intf = to_usb_interface(dev);
 	struct driver_context *context = usb_get_intfdata(intf);
-	return scnprintf(buf, PAGE_SIZE, "%d", context->oven.target_temp);
+	return temp_show(buf, context->oven.target_temp);
 }
 
 ssize_t target_temp_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
@@ -174,13 +236,84 @@ ssize_t target_temp_store(struct device *dev, struct device_attribute *attr, con
 	if (sscanf(buf, "%d", &val) != 1)
 		return -EINVAL;
 
-	context->oven.target_temp = val;
+	// Whole degrees, like the ceiling
+	context->oven.target_temp = val << PCBOVEN_TEMP_SHIFT;
+	context->last_command = jiffies;
 
-	return write_settings(usbdev, context->oven.target_temp, context->oven.enable_filaments) ?: strlen(buf);
+	return write_settings(usbdev, &context->oven, GFP_KERNEL) ?: strlen(buf);
 }
 
 DEVICE_ATTR(target_temp, S_IRUSR | S_IWUSR, target_temp_show, target_temp_store);
 
+ssize_t trip_reason_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct usb_interface *intf = to_usb_interface(dev);
+	struct driver_context *context = usb_get_intfdata(intf);
+	return scnprintf(buf, PAGE_SIZE, "%s", trip_reasons[context->oven.trip_reason]);
+}
+
+DEVICE_ATTR(trip_reason, S_IRUSR, trip_reason_show, NULL);
+
+ssize_t failsafe_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct usb_interface *intf = to_usb_interface(dev);
+	struct driver_context *context = usb_get_intfdata(intf);
+	return scnprintf(buf, PAGE_SIZE, "%s", failsafes[context->oven.failsafe]);
+}
+
+DEVICE_ATTR(failsafe, S_IRUSR, failsafe_show, NULL);
+
+ssize_t ceiling_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct usb_interface *intf = to_usb_interface(dev);
+	struct driver_context *context = usb_get_intfdata(intf);
+	return scnprintf(buf, PAGE_SIZE, "%d", context->ceiling);
+}
+
+ssize_t ceiling_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct usb_interface *intf = to_usb_interface(dev);
+	struct driver_context *context = usb_get_intfdata(intf);
+	int val;
+
+	if (sscanf(buf, "%d", &val) != 1)
+		return -EINVAL;
+
+	// Outside the sensor's range the cut-off would trip at once or never
+	if (val <= 0 || val > MAX_CEILING)
+		return -EINVAL;
+
+	context->ceiling = val;
+
+	return count;
+}
+
+DEVICE_ATTR(ceiling, S_IRUSR | S_IWUSR, ceiling_show, ceiling_store);
+
+ssize_t heartbeat_timeout_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct usb_interface *intf = to_usb_interface(dev);
+	struct driver_context *context = usb_get_intfdata(intf);
+	return scnprintf(buf, PAGE_SIZE, "%u", context->heartbeat_timeout);
+}
+
+ssize_t heartbeat_timeout_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct usb_interface *intf = to_usb_interface(dev);
+	struct driver_context *context = usb_get_intfdata(intf);
+	unsigned int val;
+
+	if (sscanf(buf, "%u", &val) != 1)
+		return -EINVAL;
+
+	context->heartbeat_timeout = val;
+	context->last_command = jiffies;
+
+	return count;
+}
+
+DEVICE_ATTR(heartbeat_timeout, S_IRUSR | S_IWUSR, heartbeat_timeout_show, heartbeat_timeout_store);
+
 ssize_t enable_dummy_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
 	return scnprintf(buf, PAGE_SIZE, "%d", (static_context->usb_device == &DUMMY_USB_DEVICE));
@@ -215,6 +348,10 @@ int __init init_module()
 	static_context = kzalloc(sizeof(struct driver_context), GFP_KERNEL);
 	if (static_context == NULL)
 		return -ENOMEM;
+	static_context->oven.balance = PCBOVEN_BALANCE_EVEN;
+	static_context->ceiling = DEFAULT_CEILING;
+	static_context->heartbeat_timeout = DEFAULT_HEARTBEAT_TIMEOUT;
+	INIT_KFIFO(static_context->samples);
 
 	retval = usb_register(&oven_usb_driver);
 	if (retval) {
@@ -281,12 +418,39 @@ int usb_probe(struct usb_interface *intf, const struct usb_device_id *id_table)
 	if (ret = device_create_file(&intf->dev, &dev_attr_filament_bottom_on), ret)
 		printk(KERN_ERR "device_create_file(): %d\n", ret);
 
+	if (ret = device_create_file(&intf->dev, &dev_attr_filament_top_duty), ret)
+		printk(KERN_ERR "device_create_file(): %d\n", ret);
+
+	if (ret = device_create_file(&intf->dev, &dev_attr_filament_bottom_duty), ret)
+		printk(KERN_ERR "device_create_file(): %d\n", ret);
+
+	if (ret = device_create_file(&intf->dev, &dev_attr_cooling_duty), ret)
+		printk(KERN_ERR "device_create_file(): %d\n", ret);
+
 	if (ret = device_create_file(&intf->dev, &dev_attr_target_temp), ret)
 		printk(KERN_ERR "device_create_file(): %d\n", ret);
 
+	if (ret = device_create_file(&intf->dev, &dev_attr_trip_reason), ret)
+		printk(KERN_ERR "device_create_file(): %d\n", ret);
+
+	if (ret = device_create_file(&intf->dev, &dev_attr_failsafe), ret)
+		printk(KERN_ERR "device_create_file(): %d\n", ret);
+
+	if (ret = device_create_file(&intf->dev, &dev_attr_ceiling), ret)
+		printk(KERN_ERR "device_create_file(): %d\n", ret);
+
+	if (ret = device_create_file(&intf->dev, &dev_attr_heartbeat_timeout), ret)
+		printk(KERN_ERR "device_create_file(): %d\n", ret);
+
 	usb_set_intfdata(intf, static_context);
 	static_context->usb_device = interface_to_usbdev(intf);
 
+	// The firmware counts its samples from zero again
+	mutex_lock(&samples_mutex);
+	kfifo_reset(&static_context->samples);
+	static_context->sample_sequence = 0;
+	mutex_unlock(&samples_mutex);
+
 	usb_request = usb_alloc_urb(0, GFP_KERNEL);
 
 	usb_fill_int_urb(usb_request,
@@ -321,7 +485,14 @@ void usb_disconnect(struct usb_interface *intf)
 	device_remove_file(&intf->dev, &dev_attr_fault_open_circuit);
 	device_remove_file(&intf->dev, &dev_attr_filament_top_on);
 	device_remove_file(&intf->dev, &dev_attr_filament_bottom_on);
+	device_remove_file(&intf->dev, &dev_attr_filament_top_duty);
+	device_remove_file(&intf->dev, &dev_attr_filament_bottom_duty);
+	device_remove_file(&intf->dev, &dev_attr_cooling_duty);
 	device_remove_file(&intf->dev, &dev_attr_target_temp);
+	device_remove_file(&intf->dev, &dev_attr_trip_reason);
+	device_remove_file(&intf->dev, &dev_attr_failsafe);
+	device_remove_file(&intf->dev, &dev_attr_ceiling);
+	device_remove_file(&intf->dev, &dev_attr_heartbeat_timeout);
 
 	context->usb_device = NULL;
 
@@ -338,20 +509,43 @@ void intr_callback(struct urb *urb)
 	struct oven_state *oven = &context->oven;
 
 	if (urb->status == 0) {
-		if (urb->actual_length >= sizeof(struct oven_usb_frame)) {
+		if (urb->actual_length >= PCBOVEN_FRAME_MIN) {
 			struct oven_usb_frame *reading = urb->transfer_buffer;
 
-			// Convert probe temp from 14 bit value to 16 bit
-			oven->probe_temp = (reading->probe << 2) >> 4;
-
-			// Convert internal temp from 12 bit value to 16 bit
-			oven->internal_temp = (reading->internal << 4) >> 8;
+			oven->probe_temp = (int16_t)le16_to_cpu(reading->probe);
+			oven->internal_temp = (int16_t)le16_to_cpu(reading->internal);
 
 			oven->fault_short_vcc    = !!reading->short_vcc;
 			oven->fault_short_gnd    = !!reading->short_gnd;
 			oven->fault_open_circuit = !!reading->open_circuit;
 			oven->filament_top_on    = !!reading->top_on;
 			oven->filament_bottom_on = !!reading->bottom_on;
+			oven->top_duty           = reading->top_duty;
+			oven->bottom_duty        = reading->bottom_duty;
+			oven->cooling_duty       = reading->cooling;
+
+			context->gains.proportional = le16_to_cpu(reading->gain_p);
+			context->gains.integral     = le16_to_cpu(reading->gain_i);
+			context->gains.derivative   = le16_to_cpu(reading->gain_d);
+
+			// Unknown failsafe codes from newer firmware read as a sensor fault
+			oven->failsafe = reading->failsafe <= PCBOVEN_FAILSAFE_SENSOR ?
+			                 reading->failsafe : PCBOVEN_FAILSAFE_SENSOR;
+
+			oven->applied_target_temp = (int16_t)le16_to_cpu(reading->target);
+			oven->applied_enable      = !!(reading->flags & PCBOVEN_SETTINGS_ENABLE);
+
+			queue_samples(context, reading, urb->actual_length);
+
+			// Cut the heaters from here rather than waiting for userspace
+			if (check_watchdog(context)) {
+				oven->enable_filaments = false;
+				oven->manual_duty = false;
+			}
+
+			// Until a reading shows them off, since the frame can be lost
+			if (oven->trip_reason != PCBOVEN_TRIP_NONE && !oven->enable_filaments && oven->applied_enable)
+				write_settings(context->usb_device, oven, GFP_ATOMIC);
 
 			if (context->async_queue)
 				kill_fasync(&context->async_queue, SIGIO, POLL_IN);
@@ -360,29 +554,79 @@ void intr_callback(struct urb *urb)
 		printk(KERN_ERR "Urb failed with: %d\n", urb->status);
 	}
 
-	result = usb_submit_urb(urb, GFP_KERNEL);
+	result = usb_submit_urb(urb, GFP_ATOMIC);
 	if (result)
 		printk(KERN_ERR "Error reregistering urb (%d)\n", result);
 }
 
-int write_settings(struct usb_device *usbdev, int16_t temp, bool filaments)
+/*
+ * Queues the samples that came with a reading, timed by the firmware's
+ * sample sequence
+ */
+void queue_samples(struct driver_context *context, struct oven_usb_frame *reading, unsigned int length)
+{
+	int16_t probes[PCBOVEN_SAMPLES_MAX];
+	struct oven_sample sample;
+	int count, i;
+
+	count = pcboven_unpack_samples(&reading->samples, length - PCBOVEN_SAMPLES_OFFSET, probes);
+	if (count < 0) {
+		printk(KERN_ERR "Malformed samples in a reading\n");
+		return;
+	}
+
+	context->sample_sequence = pcboven_extend_sequence(context->sample_sequence, le16_to_cpu(reading->samples.sequence));
+	for (i = 0; i < count; i++) {
+		sample.time = (context->sample_sequence + i) * (1000 / PCBOVEN_SAMPLE_RATE);
+		sample.probe_temp = probes[i];
+		kfifo_in(&context->samples, &sample, 1);
+	}
+}
+
+/*
+ * Called from the interrupt completion with the latest reading. Returns
+ * whether the filaments must be switched off, latching the reason.
+ */
+int check_watchdog(struct driver_context *context)
+{
+	struct oven_state *oven = &context->oven;
+	int reason = PCBOVEN_TRIP_NONE;
+
+	if (!oven->enable_filaments)
+		return 0;
+
+	if (oven->failsafe != PCBOVEN_FAILSAFE_NONE)
+		reason = PCBOVEN_TRIP_DEVICE;
+	else if (oven->fault_short_vcc || oven->fault_short_gnd || oven->fault_open_circuit)
+		reason = PCBOVEN_TRIP_FAULT;
+	else if (oven->probe_temp > context->ceiling << PCBOVEN_TEMP_SHIFT)
+		reason = PCBOVEN_TRIP_CEILING;
+	else if (context->heartbeat_timeout &&
+	         time_after(jiffies, context->last_command + msecs_to_jiffies(context->heartbeat_timeout)))
+		reason = PCBOVEN_TRIP_TIMEOUT;
+
+	if (reason == PCBOVEN_TRIP_NONE)
+		return 0;
+
+	printk(KERN_WARNING "PCBoven: filaments off (%s)\n", trip_reasons[reason]);
+	oven->trip_reason = reason;
+	return 1;
+}
+
+int write_frame(struct usb_device *usbdev, const void *frame, size_t len, gfp_t flags)
 {
 	struct urb *request = NULL;
 	uint8_t *out_buf;
 	int result;
 
-	out_buf = kmalloc(sizeof(char) * OUT_BUF_LEN, GFP_KERNEL);
+	out_buf = kmemdup(frame, len, flags);
 	if (out_buf == NULL) {
 		printk(KERN_ERR "Error allocating buffer\n");
 		result = -ENOMEM;
 		goto error;
 	}
 
-	out_buf[0] = (temp >> 0) & 0xFF;
-	out_buf[1] = (temp >> 8) & 0xFF;
-	out_buf[2] = filaments ? 1 : 0;
-
-	request = usb_alloc_urb(0, GFP_KERNEL);
+	request = usb_alloc_urb(0, flags);
 	if (request == NULL) {
 		printk(KERN_ERR "Error allocating urb\n");
 		result = -ENOMEM;
@@ -393,11 +637,11 @@ int write_settings(struct usb_device *usbdev, int16_t temp, bool filaments)
 	                  usbdev,
 	                  usb_sndbulkpipe(usbdev, OUT_EP),
 	                  out_buf,
-	                  OUT_BUF_LEN,
+	                  len,
 	                  &urb_complete,
 	                  out_buf);
 
-	result = usb_submit_urb(request, GFP_KERNEL);
+	result = usb_submit_urb(request, flags);
 	if (result) {
 		printk(KERN_ERR "Error writing urb (%d)\n", result);
 		goto error;
@@ -409,14 +653,54 @@ error:
 	if (out_buf)
 		kfree(out_buf);
 	if (request)
-		kfree(request);
+		usb_free_urb(request);
 
 	return result;
 }
 
+int write_settings(struct usb_device *usbdev, struct oven_state *oven, gfp_t flags)
+{
+	struct oven_settings_frame frame = {
+		.command = PCBOVEN_CMD_SETTINGS,
+		.target  = cpu_to_le16(oven->target_temp),
+		.flags   = (oven->enable_filaments ? PCBOVEN_SETTINGS_ENABLE : 0) |
+		           (oven->manual_duty ? PCBOVEN_SETTINGS_MANUAL : 0) |
+		           (oven->manual_cooling ? PCBOVEN_SETTINGS_COOLING : 0),
+		.top_duty    = oven->manual_top_duty,
+		.bottom_duty = oven->manual_bottom_duty,
+		.balance     = oven->balance,
+		.timeout     = min(DIV_ROUND_UP(static_context->heartbeat_timeout, 1000), 255U),
+		.cooling     = oven->manual_cooling_duty
+	};
+
+	return write_frame(usbdev, &frame, sizeof(frame), flags);
+}
+
+int write_gains(struct usb_device *usbdev, struct oven_gains *gains)
+{
+	struct oven_gains_frame frame = {
+		.command = PCBOVEN_CMD_GAINS,
+		.gain_p  = cpu_to_le16(gains->proportional),
+		.gain_i  = cpu_to_le16(gains->integral),
+		.gain_d  = cpu_to_le16(gains->derivative)
+	};
+
+	return write_frame(usbdev, &frame, sizeof(frame), GFP_KERNEL);
+}
+
+int write_heartbeat(struct usb_device *usbdev)
+{
+	struct oven_heartbeat_frame frame = {
+		.command = PCBOVEN_CMD_HEARTBEAT
+	};
+
+	return write_frame(usbdev, &frame, sizeof(frame), GFP_KERNEL);
+}
+
 void urb_complete(struct urb *urb)
 {
-	printk(KERN_ERR "Urb status: %d\n", urb->status);
+	if (urb->status)
+		printk(KERN_ERR "Urb status: %d\n", urb->status);
 	kfree(urb->transfer_buffer);
 	usb_free_urb(urb);
 }
@@ -441,27 +725,99 @@ long oven_ioctl(struct file *file, unsigned int code, unsigned long data)
 		return -ENODEV;
 
 	switch (code) {
+	case PCBOVEN_HEARTBEAT:
+		context->last_command = jiffies;
+		if (context->usb_device == &DUMMY_USB_DEVICE)
+			return 0;
+		return write_heartbeat(context->usb_device);
 	case PCBOVEN_SET_TEMPERATURE:
-		context->oven.target_temp = data << 2;
+		context->oven.target_temp = data;
+		context->last_command = jiffies;
 		break;
 	case PCBOVEN_ENABLE_FILAMENTS:
 		context->oven.enable_filaments = true;
+		context->oven.trip_reason = PCBOVEN_TRIP_NONE;
+		context->last_command = jiffies;
 		break;
 	case PCBOVEN_DISABLE_FILAMENTS:
 		context->oven.enable_filaments = false;
 		break;
+	case PCBOVEN_SET_DUTY:
+		if ((int)data == PCBOVEN_DUTY_AUTOMATIC) {
+			context->oven.manual_duty = false;
+		} else if ((int)data >= 0 && (int)data <= 255) {
+			context->oven.manual_duty = true;
+			context->oven.manual_top_duty = data;
+			context->oven.manual_bottom_duty = data;
+		} else {
+			return -EINVAL;
+		}
+		break;
+	case PCBOVEN_SET_ELEMENT_DUTY: {
+		struct oven_duty duty;
+		if (copy_from_user(&duty, (struct oven_duty *)data, sizeof(duty)))
+			return -EFAULT;
+		if (duty.top < 0 || duty.top > 255 || duty.bottom < 0 || duty.bottom > 255)
+			return -EINVAL;
+		context->oven.manual_duty = true;
+		context->oven.manual_top_duty = duty.top;
+		context->oven.manual_bottom_duty = duty.bottom;
+		break;
+	}
+	case PCBOVEN_SET_BALANCE:
+		if ((int)data < 0 || (int)data > 255)
+			return -EINVAL;
+		context->oven.balance = data;
+		break;
+	case PCBOVEN_SET_COOLING:
+		if ((int)data == PCBOVEN_COOLING_AUTOMATIC) {
+			context->oven.manual_cooling = false;
+		} else if ((int)data >= 0 && (int)data <= 255) {
+			context->oven.manual_cooling = true;
+			context->oven.manual_cooling_duty = data;
+		} else {
+			return -EINVAL;
+		}
+		break;
 	case PCBOVEN_GET_STATE:
 		if (copy_to_user((struct oven_state *)data, &context->oven, sizeof(context->oven)))
 			return -EFAULT;
 		return 0;
+	case PCBOVEN_GET_SAMPLES: {
+		struct oven_samples *samples = (struct oven_samples *)data;
+		unsigned int copied;
+		int ret;
+
+		mutex_lock(&samples_mutex);
+		// The fifo holds no more than samples does, so this empties it
+		ret = kfifo_to_user(&context->samples, samples->samples, sizeof(samples->samples), &copied);
+		mutex_unlock(&samples_mutex);
+		if (ret)
+			return ret;
+		return put_user(copied / sizeof(struct oven_sample), &samples->count);
+	}
+	case PCBOVEN_GET_GAINS:
+		if (copy_to_user((struct oven_gains *)data, &context->gains, sizeof(context->gains)))
+			return -EFAULT;
+		return 0;
+	case PCBOVEN_SET_GAINS:
+		if (copy_from_user(&context->gains, (struct oven_gains *)data, sizeof(context->gains)))
+			return -EFAULT;
+		if (context->usb_device == &DUMMY_USB_DEVICE)
+			return 0;
+		return write_gains(context->usb_device, &context->gains);
 	default:
 		return -ENOTTY;
 	}
 
-	if (context->usb_device == &DUMMY_USB_DEVICE)
+	// The dummy device applies settings as soon as they are set
+	if (context->usb_device == &DUMMY_USB_DEVICE) {
+		context->oven.applied_target_temp = context->oven.target_temp;
+		context->oven.applied_enable = context->oven.enable_filaments;
 		return 0;
+	}
 
-	return write_settings(context->usb_device, context->oven.target_temp, context->oven.enable_filaments);
+	return write_settings(context->usb_device, &context->oven, GFP_KERNEL);
 }
 
 int oven_fopen(struct inode *inode, struct file *file)
@@ -2,6 +2,7 @@
 #define __PCBOVEN_USB_H__
 
 #include <linux/ioctl.h>
+#include "pcboven_protocol.h"
 
 #define PCBOVEN_USB_ID_VENDOR      0x03EB
 #define PCBOVEN_USB_ID_PRODUCT     0x3140
@@ -14,7 +15,34 @@
 #define PCBOVEN_SET_TEMPERATURE    _IOW(PCBOVEN_IOCTL_MAGIC, 'T', int)
 #define PCBOVEN_ENABLE_FILAMENTS   _IO(PCBOVEN_IOCTL_MAGIC, 'E')
 #define PCBOVEN_DISABLE_FILAMENTS  _IO(PCBOVEN_IOCTL_MAGIC, 'D')
+#define PCBOVEN_SET_DUTY           _IOW(PCBOVEN_IOCTL_MAGIC, 'P', int)
+#define PCBOVEN_SET_GAINS          _IOW(PCBOVEN_IOCTL_MAGIC, 'G', struct oven_gains)
+#define PCBOVEN_GET_GAINS          _IOR(PCBOVEN_IOCTL_MAGIC, 'g', struct oven_gains)
+#define PCBOVEN_SET_ELEMENT_DUTY   _IOW(PCBOVEN_IOCTL_MAGIC, 'p', struct oven_duty)
+#define PCBOVEN_SET_BALANCE        _IOW(PCBOVEN_IOCTL_MAGIC, 'B', int)
+#define PCBOVEN_HEARTBEAT          _IO(PCBOVEN_IOCTL_MAGIC, 'H')
+#define PCBOVEN_SET_COOLING        _IOW(PCBOVEN_IOCTL_MAGIC, 'F', int)
+#define PCBOVEN_GET_SAMPLES        _IOR(PCBOVEN_IOCTL_MAGIC, 'Q', struct oven_samples)
 
+/* PCBOVEN_SET_TEMPERATURE takes a Q2 temperature, see PCBOVEN_TEMP_SHIFT */
+
+/* PCBOVEN_SET_DUTY takes a fixed duty (0-255) or PCBOVEN_DUTY_AUTOMATIC */
+#define PCBOVEN_DUTY_AUTOMATIC     -1
+
+/* PCBOVEN_SET_COOLING takes a fixed duty (0-255) or PCBOVEN_COOLING_AUTOMATIC */
+#define PCBOVEN_COOLING_AUTOMATIC  -1
+
+/*
+ * Why the driver's watchdog last switched the filaments off. The trip is
+ * latched until the filaments are enabled again.
+ */
+#define PCBOVEN_TRIP_NONE          0
+#define PCBOVEN_TRIP_FAULT         1  /* thermocouple fault reported */
+#define PCBOVEN_TRIP_CEILING       2  /* probe above the temperature ceiling */
+#define PCBOVEN_TRIP_TIMEOUT       3  /* no setpoint or heartbeat in time */
+#define PCBOVEN_TRIP_DEVICE        4  /* the firmware's failsafe, see failsafe */
+
+/* Temperatures are Q2 (quarter degrees C) */
 struct oven_state {
 	int16_t probe_temp;
 	int16_t internal_temp;
@@ -25,6 +53,50 @@ struct oven_state {
 	bool fault_open_circuit;
 	bool filament_top_on;
 	bool filament_bottom_on;
+	bool manual_duty;
+	uint8_t manual_top_duty;      /* as requested with PCBOVEN_SET_*DUTY */
+	uint8_t manual_bottom_duty;
+	uint8_t top_duty;             /* as reported by the firmware */
+	uint8_t bottom_duty;
+	uint8_t balance;
+	uint8_t trip_reason;
+	uint8_t failsafe;
+	int16_t applied_target_temp;  /* as echoed by the firmware */
+	bool applied_enable;
+	bool manual_cooling;
+	uint8_t manual_cooling_duty;  /* as requested with PCBOVEN_SET_COOLING */
+	uint8_t cooling_duty;         /* as reported by the firmware */
+};
+
+/* Fixed duty (0-255) for each element, used with PCBOVEN_SET_ELEMENT_DUTY */
+struct oven_duty {
+	int top;
+	int bottom;
+};
+
+/*
+ * The thermocouple samples that came with the readings, oldest first. The
+ * time is the firmware's, in ms since the oven connected. One
+ * PCBOVEN_GET_SAMPLES call drains the whole queue; samples arriving while it
+ * is full are dropped.
+ */
+#define PCBOVEN_SAMPLE_QUEUE       64
+
+struct oven_sample {
+	uint32_t time;
+	int16_t probe_temp;
+};
+
+struct oven_samples {
+	uint32_t count;
+	struct oven_sample samples[PCBOVEN_SAMPLE_QUEUE];
+};
+
+/* Q8.8 fixed point, in duty counts (0-255) per degree C */
+struct oven_gains {
+	uint16_t proportional;
+	uint16_t integral;
+	uint16_t derivative;
 };
 
 #endif
@@ -0,0 +1,354 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal.h"
+#include "oven.h"
+#include "sim.h"
+
+#define AMBIENT         25.0  // C, also the cold junction
+#define HEATER_GAIN     260.0 // C above ambient with both elements on
+#define TIME_CONSTANT   150.0 // s
+#define HEATER_OUTPUTS  0x03  // the filament pins, see oven.c
+#define COOLER_OUTPUT   0x80  // the cooler pin
+#define COOLER_GAIN     3.0   // extra heat loss with the cooler on, in multiples of the oven's own
+#define HOLD_SECONDS    600
+#define HOLD_TICKS      (HOLD_SECONDS * TICK_RATE)
+#define SETTLED_TICKS   (HOLD_TICKS * 2 / 3) // the end of the hold is at the target
+#define COOL_RATE       3     // C/s, the target's fall after the hold
+#define COOL_END        50.0  // C, where it stops
+#define COOL_SECONDS    400
+#define RUN_SECONDS     (HOLD_SECONDS + COOL_SECONDS)
+#define RUN_TICKS       (RUN_SECONDS * TICK_RATE)
+#define COMMAND_ODDS    8     // fuzzing sends a packet on one tick in this many
+#define FAULT_ODDS      50    // and a faulty conversion one sample in this many
+#define JUMP_ODDS       5000  // and moves the probe elsewhere one tick in this many
+
+static void usage(const char *name);
+static int regression(unsigned long cycles, double max_overshoot, double max_error, double max_cooldown, int passive);
+static int fuzz(unsigned long cycles, unsigned long seed);
+static void step_model(double *temperature);
+static uint32_t conversion(double temperature);
+static void send_settings(int16_t target, uint8_t flags, uint8_t timeout, uint8_t cooling);
+static const char *check(const struct oven *oven);
+static uint32_t next_random();
+static double seconds();
+
+static uint32_t g_random = 1;
+
+int main(int argc, char *argv[])
+{
+	unsigned long cycles = 10000000;
+	unsigned long seed = 1;
+	double max_overshoot = 10.0;
+	double max_error = 5.0;
+	double max_cooldown = 120.0;
+	int fuzzing = 0;
+	int passive = 0;
+	int option;
+
+	while ((option = getopt(argc, argv, "c:fs:o:e:d:ph")) != -1) {
+		switch (option) {
+		case 'c':
+			cycles = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			fuzzing = 1;
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			max_overshoot = atof(optarg);
+			break;
+		case 'e':
+			max_error = atof(optarg);
+			break;
+		case 'd':
+			max_cooldown = atof(optarg);
+			break;
+		case 'p':
+			passive = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return 2;
+		}
+	}
+
+	g_random = seed ? seed : 1;
+	if (fuzzing)
+		return fuzz(cycles, seed);
+	return regression(cycles, max_overshoot, max_error, max_cooldown, passive);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+	        "Usage: %s [-c cycles] [-o max-overshoot] [-e max-error] [-d max-cooldown] [-p]\n"
+	        "       %s -f [-c cycles] [-s seed]\n"
+	        "Runs the firmware's control loop against a simulated oven, one cycle per\n"
+	        "%d Hz timer tick. Without -f, back to back runs hold varying targets for\n"
+	        "%d s and then ramp down to %.0f C at %d C/s; they fail if the overshoot or\n"
+	        "the settled error (C) or the time taken to cool (s) exceed the limits.\n"
+	        "With -p the cooler is held off, for comparison. With -f, random commands,\n"
+	        "thermocouple faults and jumps are fed in and the outputs and samples are\n"
+	        "checked after every cycle.\n",
+	        name, name, TICK_RATE, HOLD_SECONDS, COOL_END, COOL_RATE);
+}
+
+static int regression(unsigned long cycles, double max_overshoot, double max_error, double max_cooldown, int passive)
+{
+	struct oven oven;
+	struct oven_usb_frame frame;
+	double temperature = AMBIENT;
+	double overshoot = 0, worst_overshoot = 0;
+	double error = 0, worst_error = 0;
+	double cooldown = 0, worst_cooldown = 0;
+	double target = 0, setpoint = 0;
+	uint8_t flags = PCBOVEN_SETTINGS_ENABLE | (passive ? PCBOVEN_SETTINGS_COOLING : 0);
+	unsigned long runs = 0;
+	unsigned long tick;
+	double start = seconds();
+	double elapsed;
+
+	for (tick = 0; tick < cycles; tick++) {
+		unsigned long run_tick = tick % RUN_TICKS;
+
+		if (run_tick == 0) {
+			hal_init();
+			oven_init(&oven);
+			temperature = AMBIENT;
+			target = 150 + (runs * 37) % 100;
+			overshoot = error = 0;
+			cooldown = -1;
+		}
+
+		// Like the application, a setpoint every second keeps the failsafe
+		// quiet; during the cooldown it follows the profile's fall
+		if (run_tick % TICK_RATE == 0) {
+			setpoint = target;
+			if (run_tick >= HOLD_TICKS)
+				setpoint = fmax(COOL_END, target - (double)COOL_RATE * (run_tick - HOLD_TICKS) / TICK_RATE);
+			send_settings(setpoint * PCBOVEN_TEMP_ONE, flags, PCBOVEN_DEFAULT_TIMEOUT, 0);
+		}
+
+		oven_tick(&oven);
+		if (oven.take_sample)
+			g_board.thermocouple = conversion(temperature);
+		oven_poll(&oven);
+		sim_receive_reading(&frame);
+		step_model(&temperature);
+
+		if (run_tick < HOLD_TICKS) {
+			if (temperature - target > overshoot)
+				overshoot = temperature - target;
+			if (run_tick >= SETTLED_TICKS && fabs(temperature - target) > error)
+				error = fabs(temperature - target);
+		} else if (cooldown < 0 && temperature <= COOL_END + max_error) {
+			cooldown = (double)(run_tick - HOLD_TICKS) / TICK_RATE;
+		}
+
+		if (run_tick == RUN_TICKS - 1) {
+			runs++;
+			if (overshoot > worst_overshoot)
+				worst_overshoot = overshoot;
+			if (error > worst_error)
+				worst_error = error;
+			// A run that never cooled counts as the whole cooldown phase
+			if (cooldown < 0)
+				cooldown = COOL_SECONDS;
+			if (cooldown > worst_cooldown)
+				worst_cooldown = cooldown;
+		}
+	}
+
+	elapsed = seconds() - start;
+	printf("%lu cycles (%lu runs) in %.2f s, %.0f cycles/s\n", cycles, runs, elapsed, cycles / elapsed);
+	printf("worst overshoot %.2f C, worst settled error %.2f C, slowest cooldown %.0f s%s\n",
+	       worst_overshoot, worst_error, worst_cooldown, passive ? " (cooler off)" : "");
+
+	if (!runs) {
+		fprintf(stderr, "No complete runs; at least %d cycles are needed\n", RUN_TICKS);
+		return 1;
+	}
+	if (worst_overshoot > max_overshoot || worst_error > max_error || (!passive && worst_cooldown > max_cooldown)) {
+		fprintf(stderr, "Outside the limits (%.2f C overshoot, %.2f C error, %.0f s cooldown)\n",
+		        max_overshoot, max_error, max_cooldown);
+		return 1;
+	}
+	return 0;
+}
+
+static int fuzz(unsigned long cycles, unsigned long seed)
+{
+	struct oven oven;
+	struct oven_usb_frame frame;
+	uint8_t packet[SIM_ENDPOINT_SIZE];
+	uint8_t length;
+	int16_t probes[PCBOVEN_SAMPLES_MAX];
+	uint16_t sequence = 0;
+	double temperature = AMBIENT;
+	unsigned long commands = 0, readings = 0, failsafes = 0, raw = 0;
+	unsigned long tick;
+	const char *failure;
+	double start = seconds();
+	double elapsed;
+
+	hal_init();
+	oven_init(&oven);
+
+	for (tick = 0; tick < cycles; tick++) {
+		if (next_random() % COMMAND_ODDS == 0) {
+			// Mostly well-formed commands of random length and contents
+			length = next_random() % 16;
+			for (uint8_t i = 0; i < length; i++)
+				packet[i] = next_random();
+			if (length && next_random() % 4)
+				packet[0] = PCBOVEN_CMD_SETTINGS + next_random() % 3;
+			if (sim_send_command(packet, length))
+				commands++;
+		}
+
+		// Jumps too steep to delta encode the samples across
+		if (next_random() % JUMP_ODDS == 0)
+			temperature = next_random() % 1000;
+
+		oven_tick(&oven);
+		if (oven.take_sample) {
+			g_board.thermocouple = conversion(temperature);
+			if (next_random() % FAULT_ODDS == 0)
+				g_board.thermocouple = sim_thermocouple_word(0, 0, 1 + next_random() % 7);
+		}
+		oven_poll(&oven);
+		step_model(&temperature);
+
+		if (g_board.reading_ready) {
+			length = sim_receive_reading(&frame);
+			if (!length) {
+				failure = "a reading is not an oven_usb_frame";
+			} else {
+				readings++;
+				if (frame.failsafe != PCBOVEN_FAILSAFE_NONE)
+					failsafes++;
+				if (frame.samples.encoding == PCBOVEN_SAMPLES_RAW)
+					raw++;
+				if (frame.failsafe != PCBOVEN_FAILSAFE_NONE && (frame.flags & PCBOVEN_SETTINGS_ENABLE))
+					failure = "a reading reports a failsafe with the filaments enabled";
+				else if (pcboven_unpack_samples(&frame.samples, length - PCBOVEN_SAMPLES_OFFSET, probes) != SAMPLES_PER_READ)
+					failure = "a reading does not carry its samples";
+				else if (frame.samples.sequence != sequence)
+					failure = "a reading's samples do not follow on from the last";
+				else if (probes[SAMPLES_PER_READ - 1] != frame.probe)
+					failure = "a reading's last sample is not its probe temperature";
+				else
+					failure = check(&oven);
+				sequence = frame.samples.sequence + SAMPLES_PER_READ;
+			}
+		} else {
+			failure = check(&oven);
+		}
+
+		if (!failure && g_board.command_overruns)
+			failure = "a command was read past the end of its packet";
+
+		if (failure) {
+			fprintf(stderr, "Cycle %lu of seed %lu: %s\n", tick, seed, failure);
+			return 1;
+		}
+	}
+
+	elapsed = seconds() - start;
+	printf("%lu cycles in %.2f s, %.0f cycles/s\n", cycles, elapsed, cycles / elapsed);
+	printf("%lu commands, %lu readings, %lu in failsafe, %lu with raw samples\n",
+	       commands, readings, failsafes, raw);
+	return 0;
+}
+
+// One tick of a first order oven heated by whichever elements are on, and
+// losing heat faster while the cooler runs
+static void step_model(double *temperature)
+{
+	uint8_t on = g_board.outputs & HEATER_OUTPUTS;
+	double heat = HEATER_GAIN * ((on & 1) + (on >> 1)) / 2.0;
+	double loss = (g_board.outputs & COOLER_OUTPUT) ? COOLER_GAIN * (*temperature - AMBIENT) : 0;
+
+	*temperature += (AMBIENT + heat - *temperature - loss) / (TIME_CONSTANT * TICK_RATE);
+}
+
+/*
+ * What the MAX31855 reports for the oven's temperature: its linear reading,
+ * found by bisection as the one the firmware's type K correction turns back
+ * into the temperature, give or take a count of noise.
+ */
+static uint32_t conversion(double temperature)
+{
+	int16_t internal = AMBIENT * 16;
+	int16_t target = lround(temperature * PCBOVEN_TEMP_ONE);
+	int16_t low = -20 * PCBOVEN_TEMP_ONE, high = 1350 * PCBOVEN_TEMP_ONE;
+
+	while (low < high) {
+		int16_t middle = (low + high) / 2;
+		if (thermocouple_linearize(middle, internal) < target)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return sim_thermocouple_word(low + (int16_t)(next_random() % 3) - 1, internal, 0);
+}
+
+// Assumes a little endian host, like the packed frames themselves
+static void send_settings(int16_t target, uint8_t flags, uint8_t timeout, uint8_t cooling)
+{
+	struct oven_settings_frame frame = {
+		.command = PCBOVEN_CMD_SETTINGS,
+		.target = target,
+		.flags = flags,
+		.balance = PCBOVEN_BALANCE_EVEN,
+		.timeout = timeout,
+		.cooling = cooling
+	};
+	sim_send_command(&frame, sizeof(frame));
+}
+
+// What must hold after every pass of the main loop, whatever the host sent
+static const char *check(const struct oven *oven)
+{
+	if (!(oven->settings & PCBOVEN_SETTINGS_ENABLE) && (oven->top_duty || oven->bottom_duty))
+		return "a duty is set with the filaments disabled";
+	if (oven->failsafe != PCBOVEN_FAILSAFE_NONE && (oven->settings & PCBOVEN_SETTINGS_ENABLE))
+		return "the filaments are enabled in failsafe";
+	if (oven->top_filament.on != !!(g_board.outputs & (1U << oven->top_filament.pin)) ||
+	    oven->bottom_filament.on != !!(g_board.outputs & (1U << oven->bottom_filament.pin)))
+		return "a filament pin disagrees with the filament state";
+	if ((oven->top_filament.on && !oven->top_duty) || (oven->bottom_filament.on && !oven->bottom_duty))
+		return "a filament is on without a duty";
+	if (oven->cooler.on != !!(g_board.outputs & (1U << oven->cooler.pin)))
+		return "the cooler pin disagrees with the cooler state";
+	if (oven->cooler.on && !oven->cooling_duty)
+		return "the cooler is on without a duty";
+	if (oven->cooling_duty && !(oven->settings & (PCBOVEN_SETTINGS_ENABLE | PCBOVEN_SETTINGS_COOLING)))
+		return "the cooler runs by itself with the filaments disabled";
+	return NULL;
+}
+
+// xorshift32, so a seed reproduces a fuzzing run exactly
+static uint32_t next_random()
+{
+	g_random ^= g_random << 13;
+	g_random ^= g_random >> 17;
+	g_random ^= g_random << 5;
+	return g_random;
+}
+
+static double seconds()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
@@ -0,0 +1,38 @@
+#ifndef __SIM_H__
+#define __SIM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pcboven_protocol.h"
+
+#define SIM_ENDPOINT_SIZE 64
+
+/*
+ * The simulated board behind hal.h. The harness sets the thermocouple's next
+ * conversion, queues OUT packets and collects IN frames; the firmware's
+ * output pins and fault indicator are recorded as they are driven.
+ */
+struct sim_board {
+	uint32_t thermocouple;
+	uint8_t outputs;
+	uint32_t fault_indications;
+
+	uint8_t command[SIM_ENDPOINT_SIZE];
+	uint8_t command_length;
+	uint8_t command_position;
+	bool command_pending;
+	uint32_t command_overruns; // fields read past the end of a packet
+
+	uint8_t reading[SIM_ENDPOINT_SIZE];
+	uint8_t reading_length;
+	bool reading_ready;
+};
+
+extern struct sim_board g_board;
+
+void sim_board_reset();
+bool sim_send_command(const void *packet, uint8_t length);
+uint8_t sim_receive_reading(struct oven_usb_frame *frame);
+uint32_t sim_thermocouple_word(int16_t probe, int16_t internal, uint8_t faults);
+
+#endif // __SIM_H__
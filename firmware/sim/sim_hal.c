@@ -0,0 +1,130 @@
+#include <string.h>
+#include "hal.h"
+#include "sim.h"
+
+#define PROBE_TEMP_OFFSET    18
+#define FAULT_BIT            (1UL << 16)
+#define INTERNAL_TEMP_OFFSET 4
+
+struct sim_board g_board;
+
+void sim_board_reset()
+{
+	memset(&g_board, 0, sizeof(g_board));
+}
+
+// Queues an OUT packet, unless the firmware has not taken the last one yet
+bool sim_send_command(const void *packet, uint8_t length)
+{
+	if (g_board.command_pending || length > SIM_ENDPOINT_SIZE)
+		return false;
+
+	memcpy(g_board.command, packet, length);
+	g_board.command_length = length;
+	g_board.command_position = 0;
+	g_board.command_pending = true;
+	return true;
+}
+
+// Returns the frame's length, which ends with its last sample, or 0
+uint8_t sim_receive_reading(struct oven_usb_frame *frame)
+{
+	if (!g_board.reading_ready)
+		return 0;
+
+	g_board.reading_ready = false;
+	if (g_board.reading_length < PCBOVEN_FRAME_MIN || g_board.reading_length > sizeof(*frame))
+		return 0;
+	memset(frame, 0, sizeof(*frame));
+	memcpy(frame, g_board.reading, g_board.reading_length);
+	return g_board.reading_length;
+}
+
+// A MAX31855 conversion: Q2 probe, Q4 cold junction and the low fault bits
+uint32_t sim_thermocouple_word(int16_t probe, int16_t internal, uint8_t faults)
+{
+	uint32_t data = 0;
+
+	data |= ((uint32_t)probe & 0x3FFF) << PROBE_TEMP_OFFSET;
+	data |= ((uint32_t)internal & 0x0FFF) << INTERNAL_TEMP_OFFSET;
+	if (faults)
+		data |= FAULT_BIT | (faults & 0x07);
+	return data;
+}
+
+void hal_init()
+{
+	sim_board_reset();
+}
+
+uint32_t hal_thermocouple_read()
+{
+	return g_board.thermocouple;
+}
+
+void hal_output(uint8_t pin, bool on)
+{
+	if (on)
+		g_board.outputs |= (1U << pin);
+	else
+		g_board.outputs &= ~(1U << pin);
+}
+
+void hal_fault_indicator()
+{
+	g_board.fault_indications++;
+}
+
+bool hal_command_received()
+{
+	return g_board.command_pending;
+}
+
+uint8_t hal_command_length()
+{
+	return g_board.command_length - g_board.command_position;
+}
+
+// The AVR's FIFO hands out stale bytes past the end of a short packet; here
+// they read as zeros and are counted, so the fuzzer can catch them
+uint8_t hal_command_read_8()
+{
+	if (g_board.command_position >= g_board.command_length) {
+		g_board.command_overruns++;
+		return 0;
+	}
+	return g_board.command[g_board.command_position++];
+}
+
+uint16_t hal_command_read_16()
+{
+	uint16_t low = hal_command_read_8();
+	return low | ((uint16_t)hal_command_read_8() << 8);
+}
+
+void hal_command_done()
+{
+	g_board.command_pending = false;
+}
+
+void hal_reading_begin()
+{
+	g_board.reading_length = 0;
+}
+
+void hal_reading_write_8(uint8_t value)
+{
+	if (g_board.reading_length < SIM_ENDPOINT_SIZE)
+		g_board.reading[g_board.reading_length++] = value;
+}
+
+void hal_reading_write_16(uint16_t value)
+{
+	hal_reading_write_8(value & 0xFF);
+	hal_reading_write_8(value >> 8);
+}
+
+void hal_reading_done()
+{
+	g_board.reading_ready = true;
+}
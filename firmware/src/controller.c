@@ -0,0 +1,81 @@
+#include "controller.h"
+#include "hal.h"
+
+#define DUTY_MAX          255
+#define TERM_SHIFT        10 // Q8.8 gains times Q2 temperatures
+#define DEFAULT_GAIN_P    (16 << 8)
+#define DEFAULT_GAIN_I    13
+#define DEFAULT_GAIN_D    0
+#define ERASED_EEPROM     0xFFFF
+
+static uint16_t EEMEM ee_gain_p = ERASED_EEPROM;
+static uint16_t EEMEM ee_gain_i = ERASED_EEPROM;
+static uint16_t EEMEM ee_gain_d = ERASED_EEPROM;
+
+void controller_init(struct controller *controller)
+{
+	controller->gain_p = eeprom_read_word(&ee_gain_p);
+	controller->gain_i = eeprom_read_word(&ee_gain_i);
+	controller->gain_d = eeprom_read_word(&ee_gain_d);
+
+	if (controller->gain_p == ERASED_EEPROM) {
+		controller->gain_p = DEFAULT_GAIN_P;
+		controller->gain_i = DEFAULT_GAIN_I;
+		controller->gain_d = DEFAULT_GAIN_D;
+	}
+
+	controller_reset(controller);
+}
+
+void controller_reset(struct controller *controller)
+{
+	controller->integral = 0;
+	controller->last_input = 0;
+	controller->primed = 0;
+}
+
+void controller_set_gains(struct controller *controller, uint16_t p, uint16_t i, uint16_t d)
+{
+	controller->gain_p = p;
+	controller->gain_i = i;
+	controller->gain_d = d;
+	controller_reset(controller);
+
+	eeprom_update_word(&ee_gain_p, p);
+	eeprom_update_word(&ee_gain_i, i);
+	eeprom_update_word(&ee_gain_d, d);
+}
+
+/*
+ * Runs once per reading (CONTROLLER_RATE Hz) on quarter degree temperatures
+ * and returns the heater duty. The derivative acts on the measurement so that
+ * setpoint steps do not kick, and the integral is clamped to the output range.
+ */
+uint8_t controller_update(struct controller *controller, int16_t input, int16_t target)
+{
+	int32_t error = (int32_t)target - input;
+	int32_t output;
+
+	if (!controller->primed) {
+		controller->last_input = input;
+		controller->primed = 1;
+	}
+
+	controller->integral += (int32_t)controller->gain_i * error / CONTROLLER_RATE;
+	if (controller->integral < 0)
+		controller->integral = 0;
+	else if (controller->integral > ((int32_t)DUTY_MAX << TERM_SHIFT))
+		controller->integral = (int32_t)DUTY_MAX << TERM_SHIFT;
+
+	output  = (int32_t)controller->gain_p * error;
+	output += controller->integral;
+	output -= (int32_t)controller->gain_d * (input - controller->last_input) * CONTROLLER_RATE;
+	controller->last_input = input;
+
+	output >>= TERM_SHIFT;
+	if (output < 0)
+		return 0;
+	if (output > DUTY_MAX)
+		return DUTY_MAX;
+	return output;
+}
@@ -0,0 +1,22 @@
+#ifndef __CONTROLLER_H__
+#define __CONTROLLER_H__
+
+#include <stdint.h>
+
+#define CONTROLLER_RATE 1 // updates per second
+
+struct controller {
+	uint16_t gain_p;
+	uint16_t gain_i;
+	uint16_t gain_d;
+	int32_t integral;
+	int16_t last_input;
+	uint8_t primed;
+};
+
+void controller_init(struct controller *controller);
+void controller_reset(struct controller *controller);
+void controller_set_gains(struct controller *controller, uint16_t p, uint16_t i, uint16_t d);
+uint8_t controller_update(struct controller *controller, int16_t input, int16_t target);
+
+#endif // __CONTROLLER_H__
@@ -1,14 +1,15 @@
 #include "filament.h"
+#include "hal.h"
 
 void filament_turn_on(struct filament *filament)
 {
 	filament->on = true;
-	*filament->port |= (1U << filament->pin);
+	hal_output(filament->pin, true);
 }
 
 void filament_turn_off(struct filament *filament)
 {
 	filament->on = false;
-	*filament->port &= ~(1U << filament->pin);
+	hal_output(filament->pin, false);
 }
 
@@ -5,7 +5,6 @@
 #include <stdint.h>
 
 struct filament {
-	volatile uint8_t *port;
 	uint8_t pin;
 	bool on;
 };
@@ -0,0 +1,47 @@
+#ifndef __HAL_H__
+#define __HAL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Everything the oven logic needs from the board. hal_avr.c implements it on
+ * the ATmega32u4 with LUFA; the simulator in firmware/sim implements it on the
+ * host, so oven.c, controller.c, thermocouple.c and max31855.c build for both.
+ */
+
+#ifdef __AVR__
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#else
+#define EEMEM
+#define PROGMEM
+#define eeprom_read_word(address)          (*(address))
+#define eeprom_update_word(address, value) (*(address) = (value))
+#define pgm_read_word(address)             (*(address))
+#endif
+
+void hal_init();
+
+/* The MAX31855's 32 bit conversion result */
+uint32_t hal_thermocouple_read();
+
+/* Output pins on the oven's port (the filament relays) */
+void hal_output(uint8_t pin, bool on);
+void hal_fault_indicator();
+
+/* Bulk OUT endpoint: a command is read a field at a time, then released;
+ * hal_command_length() is the number of bytes not read yet */
+bool hal_command_received();
+uint8_t hal_command_length();
+uint8_t hal_command_read_8();
+uint16_t hal_command_read_16();
+void hal_command_done();
+
+/* Interrupt IN endpoint: a reading is written a field at a time, then sent */
+void hal_reading_begin();
+void hal_reading_write_8(uint8_t value);
+void hal_reading_write_16(uint16_t value);
+void hal_reading_done();
+
+#endif // __HAL_H__
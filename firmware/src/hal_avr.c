@@ -0,0 +1,101 @@
+#include <avr/io.h>
+#include <util/delay.h>
+#include <LUFA/Drivers/Board/LEDs.h>
+#include "descriptors.h"
+#include "hal.h"
+
+#define OUTPUT_PORT PORTF
+#define CS_PORT     PORTF
+#define CS_PIN      (1 << 5)
+#define CLK_PORT    PORTF
+#define CLK_PIN     (1 << 4)
+#define DATA_PORT   PINF
+#define DATA_PIN    (1 << 6)
+
+void hal_init()
+{
+	// Everything on port F but the MAX31855's data line is an output
+	DDRF = ~DATA_PIN;
+	PORTF = 0x00;
+	LEDs_Init();
+}
+
+uint32_t hal_thermocouple_read()
+{
+	uint32_t data = 0;
+
+	CLK_PORT &= ~CLK_PIN;
+	CS_PORT  &= ~CS_PIN;
+
+	// The MAX31855 clocks at up to 5 MHz, so a microsecond per edge is ample
+	for (char count = 32; count > 0; count--) {
+		_delay_us(1);
+		CLK_PORT |= CLK_PIN;
+		_delay_us(1);
+		data = (data << 1) | !!(DATA_PORT & DATA_PIN);
+		_delay_us(1);
+		CLK_PORT &= ~CLK_PIN;
+	}
+
+	CS_PORT |= CS_PIN;
+	return data;
+}
+
+void hal_output(uint8_t pin, bool on)
+{
+	if (on)
+		OUTPUT_PORT |= (1U << pin);
+	else
+		OUTPUT_PORT &= ~(1U << pin);
+}
+
+void hal_fault_indicator()
+{
+	LEDs_ToggleLEDs(LEDS_ALL_LEDS);
+}
+
+bool hal_command_received()
+{
+	Endpoint_SelectEndpoint(OUT_EPNUM);
+	return Endpoint_IsOUTReceived();
+}
+
+uint8_t hal_command_length()
+{
+	return Endpoint_BytesInEndpoint();
+}
+
+uint8_t hal_command_read_8()
+{
+	return Endpoint_Read_8();
+}
+
+uint16_t hal_command_read_16()
+{
+	return Endpoint_Read_16_LE();
+}
+
+void hal_command_done()
+{
+	Endpoint_ClearOUT();
+}
+
+void hal_reading_begin()
+{
+	Endpoint_SelectEndpoint(IN_EPNUM);
+}
+
+void hal_reading_write_8(uint8_t value)
+{
+	Endpoint_Write_8(value);
+}
+
+void hal_reading_write_16(uint16_t value)
+{
+	Endpoint_Write_16_LE(value);
+}
+
+void hal_reading_done()
+{
+	Endpoint_ClearIN();
+}
@@ -1,15 +1,6 @@
-#include <avr/io.h>
-#include <util/delay.h>
-#include <errno.h>
+#include "hal.h"
 #include "max31855.h"
 
-#define CS_PORT    PORTF
-#define CS_PIN     (1 << 5)
-#define CLK_PORT   PORTF
-#define CLK_PIN    (1 << 4)
-#define DATA_PORT  PINF
-#define DATA_PIN   (1 << 6)
-
 #define PROBE_TEMP_MASK        0xFFFC0000
 #define PROBE_TEMP_OFFSET      18
 #define FAULT_MASK             0x00010000
@@ -23,18 +14,13 @@
 #define OPEN_CIRCUIT_MASK      0x00000001
 #define OPEN_CIRCUIT_OFFSET    0
 
-static inline uint32_t spi_read_long();
-
-void max31855_init()
+int max31855_read(struct max31855_result *result)
 {
-	DDRF = ~DATA_PIN;
-	PORTF = 0x00;
+	return max31855_decode(hal_thermocouple_read(), result);
 }
 
-int max31855_read(struct max31855_result *result)
+int max31855_decode(uint32_t data, struct max31855_result *result)
 {
-	uint32_t data = spi_read_long();
-
 	result->probe_temp    = (data & PROBE_TEMP_MASK)    >> PROBE_TEMP_OFFSET;
 	result->internal_temp = (data & INTERNAL_TEMP_MASK) >> INTERNAL_TEMP_OFFSET;
 	result->short_vcc     = (data & SHORT_VCC_MASK)     >> SHORT_VCC_OFFSET;
@@ -45,24 +31,3 @@ int max31855_read(struct max31855_result *result)
 		return MAX_31855_FAULT;
 	return 0;
 }
-
-static inline uint32_t spi_read_long()
-{
-	uint32_t data = 0;
-
-	CLK_PORT &= ~CLK_PIN;
-	CS_PORT  &= ~CS_PIN;
-
-	for (char count = 32; count > 0; count--) {
-		_delay_ms(1);
-		CLK_PORT |= CLK_PIN;
-		_delay_ms(1);
-		data = (data << 1) | !!(DATA_PORT & DATA_PIN);
-		_delay_ms(1);
-		CLK_PORT &= ~CLK_PIN;
-	}
-
-	CS_PORT |= CS_PIN;
-	return data;
-}
-
@@ -13,7 +13,7 @@ struct max31855_result {
 	uint8_t open_circuit;
 };
 
-void max31855_init();
 int max31855_read(struct max31855_result *result);
+int max31855_decode(uint32_t data, struct max31855_result *result);
 
 #endif // __MAX31855_H__
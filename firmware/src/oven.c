@@ -0,0 +1,293 @@
+#include "pcboven_protocol.h"
+#include "hal.h"
+#include "oven.h"
+
+#if SAMPLES_PER_READ > PCBOVEN_SAMPLES_MAX
+#error "A reading's samples do not fit in its frame"
+#endif
+
+#define FILAMENT_TOP_PIN     0
+#define FILAMENT_BOTTOM_PIN  1
+#define COOLER_PIN           7
+
+// Automatic cooling starts once the probe is this far above the target
+// (Q2), and adds this much duty per degree C beyond that
+#define COOLING_BAND         (2 * PCBOVEN_TEMP_ONE)
+#define COOLING_GAIN         64
+
+static void read_command(struct oven *oven);
+static void send_reading(struct oven *oven, int16_t probe);
+static void send_samples(struct oven *oven);
+static uint8_t split_duty(uint8_t duty, uint16_t share);
+static uint8_t cooling_duty(int16_t probe, int16_t target);
+static bool window_on(struct oven *oven, uint8_t duty);
+
+void oven_init(struct oven *oven)
+{
+	thermocouple_init(&oven->thermocouple);
+	controller_init(&oven->controller);
+
+	oven->top_filament.pin = FILAMENT_TOP_PIN;
+	oven->top_filament.on = false;
+	oven->bottom_filament.pin = FILAMENT_BOTTOM_PIN;
+	oven->bottom_filament.on = false;
+	oven->cooler.pin = COOLER_PIN;
+	oven->cooler.on = false;
+	oven->faults_seen.short_vcc = 0;
+	oven->faults_seen.short_gnd = 0;
+	oven->faults_seen.open_circuit = 0;
+
+	oven->take_sample = false;
+	oven->window_tick = 0;
+	oven->sample_ticks = 0;
+
+	oven->target_probe_temp = 0;
+	oven->settings = 0;
+	oven->manual_top_duty = 0;
+	oven->manual_bottom_duty = 0;
+	oven->balance = PCBOVEN_BALANCE_EVEN;
+	oven->timeout = PCBOVEN_DEFAULT_TIMEOUT;
+	oven->manual_cooling = 0;
+	oven->failsafe = PCBOVEN_FAILSAFE_NONE;
+	oven->command_age = 0;
+
+	oven->top_duty = 0;
+	oven->bottom_duty = 0;
+	oven->cooling_duty = 0;
+	oven->faults = 0;
+	oven->samples = 0;
+	oven->sample_fault = false;
+	oven->sample_sequence = 0;
+}
+
+void oven_tick(struct oven *oven)
+{
+	if (++oven->window_tick >= DUTY_WINDOW)
+		oven->window_tick = 0;
+
+	if (++oven->sample_ticks >= TICKS_PER_SAMPLE) {
+		oven->sample_ticks = 0;
+		oven->take_sample = true;
+	}
+}
+
+void oven_poll(struct oven *oven)
+{
+	struct max31855_result reading;
+	uint8_t duty;
+	int16_t probe;
+
+	if (hal_command_received()) {
+		read_command(oven);
+		hal_command_done();
+
+		if (!(oven->settings & PCBOVEN_SETTINGS_ENABLE)) {
+			oven->top_duty = oven->bottom_duty = 0;
+			controller_reset(&oven->controller);
+		} else if (oven->settings & PCBOVEN_SETTINGS_MANUAL) {
+			oven->top_duty = oven->manual_top_duty;
+			oven->bottom_duty = oven->manual_bottom_duty;
+		}
+
+		if (oven->settings & PCBOVEN_SETTINGS_COOLING)
+			oven->cooling_duty = oven->manual_cooling;
+		else if (!(oven->settings & PCBOVEN_SETTINGS_ENABLE))
+			oven->cooling_duty = 0;
+	}
+	if (oven->take_sample) {
+		oven->take_sample = false;
+
+		// Faulty samples are kept out of the filters; a reading is
+		// faulty if any of its samples was
+		if (max31855_read(&reading)) {
+			oven->sample_fault = true;
+			oven->faults_seen.short_vcc |= reading.short_vcc;
+			oven->faults_seen.short_gnd |= reading.short_gnd;
+			oven->faults_seen.open_circuit |= reading.open_circuit;
+		} else {
+			thermocouple_sample(&oven->thermocouple, &reading);
+		}
+		oven->probe_samples[oven->samples] = thermocouple_probe(&oven->thermocouple);
+		oven->sample_sequence++;
+		oven->samples++;
+	}
+	if (oven->samples >= SAMPLES_PER_READ) {
+		probe = thermocouple_probe(&oven->thermocouple);
+
+		if (oven->sample_fault) {
+			hal_fault_indicator();
+			if (oven->faults < FAULT_LIMIT)
+				oven->faults++;
+		} else {
+			oven->faults = 0;
+		}
+
+		// Only the host can clear a failsafe, by enabling the filaments again
+		if (oven->settings & PCBOVEN_SETTINGS_ENABLE) {
+			if (oven->faults >= FAULT_LIMIT)
+				oven->failsafe = PCBOVEN_FAILSAFE_SENSOR;
+			else if (oven->timeout && ++oven->command_age >= (uint16_t)oven->timeout * TEMP_READ_RATE)
+				oven->failsafe = PCBOVEN_FAILSAFE_TIMEOUT;
+			if (oven->failsafe != PCBOVEN_FAILSAFE_NONE)
+				oven->settings &= ~PCBOVEN_SETTINGS_ENABLE;
+		}
+
+		if (oven->faults) {
+			oven->top_duty = oven->bottom_duty = 0;
+			controller_reset(&oven->controller);
+		} else if (!(oven->settings & PCBOVEN_SETTINGS_ENABLE)) {
+			oven->top_duty = oven->bottom_duty = 0;
+		} else if (oven->settings & PCBOVEN_SETTINGS_MANUAL) {
+			oven->top_duty = oven->manual_top_duty;
+			oven->bottom_duty = oven->manual_bottom_duty;
+		} else {
+			duty = controller_update(&oven->controller, probe, oven->target_probe_temp);
+			oven->top_duty = split_duty(duty, oven->balance);
+			oven->bottom_duty = split_duty(duty, 256 - oven->balance);
+		}
+
+		// The cooler chases a falling target only while the controller
+		// is in charge of the elements
+		if (oven->settings & PCBOVEN_SETTINGS_COOLING)
+			oven->cooling_duty = oven->manual_cooling;
+		else if (oven->faults || (oven->settings & (PCBOVEN_SETTINGS_ENABLE | PCBOVEN_SETTINGS_MANUAL)) != PCBOVEN_SETTINGS_ENABLE)
+			oven->cooling_duty = 0;
+		else
+			oven->cooling_duty = cooling_duty(probe, oven->target_probe_temp);
+
+		send_reading(oven, probe);
+		oven->samples = 0;
+		oven->sample_fault = false;
+		oven->faults_seen.short_vcc = oven->faults_seen.short_gnd = oven->faults_seen.open_circuit = 0;
+	}
+
+	if (window_on(oven, oven->top_duty))
+		filament_turn_on(&oven->top_filament);
+	else
+		filament_turn_off(&oven->top_filament);
+
+	if (window_on(oven, oven->bottom_duty))
+		filament_turn_on(&oven->bottom_filament);
+	else
+		filament_turn_off(&oven->bottom_filament);
+
+	if (window_on(oven, oven->cooling_duty))
+		filament_turn_on(&oven->cooler);
+	else
+		filament_turn_off(&oven->cooler);
+}
+
+// Frames too short for their command are dropped whole rather than filled in
+// from stale endpoint bytes, and neither they nor unknown commands count
+// towards the failsafe timeout
+static void read_command(struct oven *oven)
+{
+	uint8_t length = hal_command_length();
+	uint16_t p, i, d;
+
+	if (!length)
+		return;
+
+	switch (hal_command_read_8()) {
+	case PCBOVEN_CMD_SETTINGS:
+		if (length < sizeof(struct oven_settings_frame))
+			return;
+		oven->target_probe_temp = hal_command_read_16();
+		oven->settings = hal_command_read_8();
+		oven->manual_top_duty = hal_command_read_8();
+		oven->manual_bottom_duty = hal_command_read_8();
+		oven->balance = hal_command_read_8();
+		oven->timeout = hal_command_read_8();
+		oven->manual_cooling = hal_command_read_8();
+		if (oven->settings & PCBOVEN_SETTINGS_ENABLE)
+			oven->failsafe = PCBOVEN_FAILSAFE_NONE;
+		break;
+	case PCBOVEN_CMD_GAINS:
+		if (length < sizeof(struct oven_gains_frame))
+			return;
+		p = hal_command_read_16();
+		i = hal_command_read_16();
+		d = hal_command_read_16();
+		controller_set_gains(&oven->controller, p, i, d);
+		break;
+	case PCBOVEN_CMD_HEARTBEAT:
+		break;
+	default:
+		return;
+	}
+
+	oven->command_age = 0;
+}
+
+// Fills in a struct oven_usb_frame on the IN endpoint
+static void send_reading(struct oven *oven, int16_t probe)
+{
+	hal_reading_begin();
+	hal_reading_write_16(probe);
+	hal_reading_write_16(thermocouple_internal(&oven->thermocouple) >> (THERMOCOUPLE_INTERNAL_SHIFT - PCBOVEN_TEMP_SHIFT));
+	hal_reading_write_8(oven->faults_seen.short_vcc);
+	hal_reading_write_8(oven->faults_seen.short_gnd);
+	hal_reading_write_8(oven->faults_seen.open_circuit);
+	hal_reading_write_8(oven->top_filament.on);
+	hal_reading_write_8(oven->bottom_filament.on);
+	hal_reading_write_8(oven->top_duty);
+	hal_reading_write_8(oven->bottom_duty);
+	hal_reading_write_16(oven->controller.gain_p);
+	hal_reading_write_16(oven->controller.gain_i);
+	hal_reading_write_16(oven->controller.gain_d);
+	hal_reading_write_8(oven->failsafe);
+	hal_reading_write_16(oven->target_probe_temp);
+	hal_reading_write_8(oven->settings);
+	hal_reading_write_8(oven->cooling_duty);
+	send_samples(oven);
+	hal_reading_done();
+}
+
+// The samples since the last reading, as a struct oven_sample_block cut
+// short after the last one
+static void send_samples(struct oven *oven)
+{
+	uint8_t encoding = PCBOVEN_SAMPLES_DELTA;
+	int16_t step;
+
+	for (uint8_t i = 1; i < oven->samples; i++) {
+		step = oven->probe_samples[i] - oven->probe_samples[i - 1];
+		if (step < INT8_MIN || step > INT8_MAX)
+			encoding = PCBOVEN_SAMPLES_RAW;
+	}
+
+	hal_reading_write_16(oven->sample_sequence - oven->samples);
+	hal_reading_write_8(oven->samples);
+	hal_reading_write_8(encoding);
+	hal_reading_write_16(oven->samples ? oven->probe_samples[0] : 0);
+	for (uint8_t i = 1; i < oven->samples; i++) {
+		if (encoding == PCBOVEN_SAMPLES_DELTA)
+			hal_reading_write_8(oven->probe_samples[i] - oven->probe_samples[i - 1]);
+		else
+			hal_reading_write_16(oven->probe_samples[i]);
+	}
+}
+
+static uint8_t split_duty(uint8_t duty, uint16_t share)
+{
+	// An element's share of the output, out of 256; an even split gives
+	// both elements the full controller output.
+	uint16_t split = ((uint16_t)duty * share) / PCBOVEN_BALANCE_EVEN;
+	return split > 255 ? 255 : split;
+}
+
+static uint8_t cooling_duty(int16_t probe, int16_t target)
+{
+	int32_t behind = (int32_t)probe - target - COOLING_BAND;
+
+	if (behind <= 0)
+		return 0;
+	behind = (behind * COOLING_GAIN) >> PCBOVEN_TEMP_SHIFT;
+	return behind > 255 ? 255 : behind;
+}
+
+// Time-proportions a duty over a window of whole ticks
+static bool window_on(struct oven *oven, uint8_t duty)
+{
+	return oven->window_tick < ((uint16_t)duty * DUTY_WINDOW + 127) / 255;
+}
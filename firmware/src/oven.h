@@ -0,0 +1,62 @@
+#ifndef __OVEN_H__
+#define __OVEN_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "controller.h"
+#include "filament.h"
+#include "max31855.h"
+#include "pcboven_protocol.h"
+#include "thermocouple.h"
+
+#define TICK_RATE      100
+#define SAMPLE_RATE    PCBOVEN_SAMPLE_RATE // the MAX31855's conversion rate
+#define TEMP_READ_RATE CONTROLLER_RATE
+#define TICKS_PER_SAMPLE (TICK_RATE / SAMPLE_RATE)
+#define SAMPLES_PER_READ (SAMPLE_RATE / TEMP_READ_RATE)
+#define DUTY_WINDOW    TICK_RATE // ticks per time-proportioning window
+#define FAULT_LIMIT    3         // consecutive faulty readings before the failsafe
+
+/*
+ * The oven's control loop, independent of the board: oven_tick() runs from
+ * the TICK_RATE timer and oven_poll() once per pass of the main loop, and all
+ * I/O goes through hal.h.
+ */
+struct oven {
+	struct thermocouple thermocouple;
+	struct controller controller;
+	struct filament top_filament;
+	struct filament bottom_filament;
+	struct filament cooler;
+	struct max31855_result faults_seen;
+
+	volatile bool take_sample;
+	volatile uint8_t window_tick;
+	uint8_t sample_ticks;
+
+	int16_t target_probe_temp;
+	uint8_t settings;
+	uint8_t manual_top_duty;
+	uint8_t manual_bottom_duty;
+	uint8_t balance;
+	uint8_t timeout;
+	uint8_t manual_cooling;
+	uint8_t failsafe;
+	uint16_t command_age; // readings since the last command
+
+	uint8_t top_duty;
+	uint8_t bottom_duty;
+	uint8_t cooling_duty;
+	uint8_t faults;
+	uint8_t samples;
+	bool sample_fault;
+
+	uint16_t sample_sequence; // samples taken since start up
+	int16_t probe_samples[PCBOVEN_SAMPLES_MAX]; // since the last reading
+};
+
+void oven_init(struct oven *oven);
+void oven_tick(struct oven *oven);
+void oven_poll(struct oven *oven);
+
+#endif // __OVEN_H__
@@ -0,0 +1,131 @@
+#include "hal.h"
+#include "thermocouple.h"
+
+#define TABLE_START  -20 // degrees C
+#define TABLE_STEP   10  // degrees C
+#define TABLE_SIZE   (sizeof(type_k_uv) / sizeof(type_k_uv[0]))
+#define MAX31855_UV  41276 // the MAX31855's linear slope, in nV per degree C
+
+/* NIST ITS-90 type K EMF in uV, from -20C to 500C in 10C steps */
+static const int16_t type_k_uv[] PROGMEM = {
+	 -778,  -392,     0,   397,   798,  1203,  1612,  2023,  2436,  2851,
+	 3267,  3682,  4096,  4509,  4920,  5328,  5735,  6138,  6540,  6941,
+	 7340,  7739,  8138,  8539,  8940,  9343,  9747, 10153, 10561, 10971,
+	11382, 11795, 12209, 12624, 13040, 13457, 13874, 14293, 14713, 15133,
+	15554, 15975, 16397, 16820, 17243, 17667, 18091, 18516, 18941, 19366,
+	19792, 20218, 20644
+};
+
+static int16_t median(const int16_t *samples, uint8_t count);
+static int32_t emf_uv(int16_t internal);
+static int16_t temperature_q2(int32_t uv);
+
+void thermocouple_init(struct thermocouple *thermocouple)
+{
+	thermocouple->next = 0;
+	thermocouple->count = 0;
+	thermocouple->probe = 0;
+	thermocouple->internal = 0;
+}
+
+void thermocouple_sample(struct thermocouple *thermocouple, const struct max31855_result *reading)
+{
+	int16_t probe, internal;
+
+	// Sign extend the 14 bit probe and 12 bit cold junction readings
+	thermocouple->probe_samples[thermocouple->next] = (int16_t)(reading->probe_temp << 2) >> 2;
+	thermocouple->internal_samples[thermocouple->next] = (int16_t)(reading->internal_temp << 4) >> 4;
+	if (++thermocouple->next == THERMOCOUPLE_MEDIAN)
+		thermocouple->next = 0;
+
+	if (thermocouple->count < THERMOCOUPLE_MEDIAN)
+		thermocouple->count++;
+	probe = median(thermocouple->probe_samples, thermocouple->count);
+	internal = median(thermocouple->internal_samples, thermocouple->count);
+
+	// The IIR state keeps THERMOCOUPLE_IIR extra fraction bits
+	if (thermocouple->count == 1) {
+		thermocouple->probe = (int32_t)probe << THERMOCOUPLE_IIR;
+		thermocouple->internal = (int32_t)internal << THERMOCOUPLE_IIR;
+	} else {
+		thermocouple->probe += probe - (thermocouple->probe >> THERMOCOUPLE_IIR);
+		thermocouple->internal += internal - (thermocouple->internal >> THERMOCOUPLE_IIR);
+	}
+}
+
+int16_t thermocouple_probe(const struct thermocouple *thermocouple)
+{
+	int16_t probe = (thermocouple->probe + (1 << (THERMOCOUPLE_IIR - 1))) >> THERMOCOUPLE_IIR;
+	return thermocouple_linearize(probe, thermocouple_internal(thermocouple));
+}
+
+int16_t thermocouple_internal(const struct thermocouple *thermocouple)
+{
+	return (thermocouple->internal + (1 << (THERMOCOUPLE_IIR - 1))) >> THERMOCOUPLE_IIR;
+}
+
+/*
+ * The MAX31855 turns the thermocouple EMF into a temperature difference with
+ * a single slope. Undo that to recover the EMF, add the cold junction's EMF
+ * from the NIST table and look the total up in the table again.
+ */
+int16_t thermocouple_linearize(int16_t probe, int16_t internal)
+{
+	// Q4 degrees C difference times nV/C gives uV after dividing by 16000
+	int32_t difference = (int32_t)probe * 4 - internal;
+	int32_t uv = (difference * MAX31855_UV + (difference < 0 ? -8000 : 8000)) / 16000;
+
+	return temperature_q2(uv + emf_uv(internal));
+}
+
+static int16_t median(const int16_t *samples, uint8_t count)
+{
+	int16_t a = samples[0], b = samples[1], c = samples[2];
+
+	if (count < THERMOCOUPLE_MEDIAN)
+		return samples[count - 1];
+
+	if ((a <= b && b <= c) || (c <= b && b <= a))
+		return b;
+	if ((b <= a && a <= c) || (c <= a && a <= b))
+		return a;
+	return c;
+}
+
+// EMF of a Q4 temperature, interpolated in the table
+static int32_t emf_uv(int16_t internal)
+{
+	int32_t offset = (int32_t)internal - TABLE_START * 16;
+	int16_t index = offset / (TABLE_STEP * 16);
+	int32_t from, to;
+
+	// Beyond the table the end segments are extended
+	if (offset < 0)
+		index = 0;
+	else if (index > (int16_t)TABLE_SIZE - 2)
+		index = TABLE_SIZE - 2;
+
+	from = (int16_t)pgm_read_word(&type_k_uv[index]);
+	to = (int16_t)pgm_read_word(&type_k_uv[index + 1]);
+	offset -= (int32_t)index * TABLE_STEP * 16;
+	return from + ((to - from) * offset) / (TABLE_STEP * 16);
+}
+
+// Q2 temperature of an EMF, by bisection and interpolation in the table
+static int16_t temperature_q2(int32_t uv)
+{
+	uint8_t low = 0, high = TABLE_SIZE - 1;
+	int32_t from, to;
+
+	while (high - low > 1) {
+		uint8_t middle = (low + high) / 2;
+		if (uv < (int16_t)pgm_read_word(&type_k_uv[middle]))
+			high = middle;
+		else
+			low = middle;
+	}
+
+	from = (int16_t)pgm_read_word(&type_k_uv[low]);
+	to = (int16_t)pgm_read_word(&type_k_uv[high]);
+	return (TABLE_START + TABLE_STEP * low) * 4 + ((uv - from) * TABLE_STEP * 4) / (to - from);
+}
@@ -0,0 +1,32 @@
+#ifndef __THERMOCOUPLE_H__
+#define __THERMOCOUPLE_H__
+
+#include <stdint.h>
+#include "max31855.h"
+
+#define THERMOCOUPLE_MEDIAN 3 // samples in the median filter
+#define THERMOCOUPLE_IIR    2 // IIR weight of a new sample, 1/2^n
+#define THERMOCOUPLE_INTERNAL_SHIFT 4 // cold junction fraction bits
+
+/*
+ * Conditions the raw MAX31855 samples: a median filter removes spikes, an IIR
+ * filter averages the oversampled readings, and the probe is then corrected
+ * against the NIST type-K table using the cold junction. Temperatures are
+ * Q2 (probe) and Q4 (cold junction) degrees C, as reported by the MAX31855.
+ */
+struct thermocouple {
+	int16_t probe_samples[THERMOCOUPLE_MEDIAN];
+	int16_t internal_samples[THERMOCOUPLE_MEDIAN];
+	int32_t probe;
+	int32_t internal;
+	uint8_t next;
+	uint8_t count;
+};
+
+void thermocouple_init(struct thermocouple *thermocouple);
+void thermocouple_sample(struct thermocouple *thermocouple, const struct max31855_result *reading);
+int16_t thermocouple_probe(const struct thermocouple *thermocouple);
+int16_t thermocouple_internal(const struct thermocouple *thermocouple);
+int16_t thermocouple_linearize(int16_t probe, int16_t internal);
+
+#endif // __THERMOCOUPLE_H__